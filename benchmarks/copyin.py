@@ -32,7 +32,6 @@
 from __future__ import print_function
 
 import sys
-import time
 
 import pymic
 import numpy as np
@@ -64,12 +63,14 @@ for ds, nrep in zip(data_sizes, repeats):
     arr = np.zeros(ds)
     offl_arr = stream.bind(arr)
     stream.sync()
-    ts = time.time()
+    # the events take the time on the side of the offload engine, hence the
+    # latency of synchronizing with the host is not part of the timing
+    start = stream.record()
     for i in xrange(nrep):
         offl_arr.update_device()
-        stream.sync()
-    te = time.time()
-    timings[ds] = (te - ts, nrep)
+    end = stream.record()
+    end.sync()
+    timings[ds] = (start.elapsed_ms(end) / 1000, nrep)
     
 try:
     csv = open(benchmark + ".csv", "w")
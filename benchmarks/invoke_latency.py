@@ -50,10 +50,36 @@ for i in xrange(nrepeat):
     stream.invoke(library.empty_kernel)
     stream.sync()
 te = time.time()
+timings.append((benchmark, (te - ts) / float(nrepeat)))
+
+# synchronous request on an idle stream (executed by the calling thread)
+# per-invoke host overhead of a kernel with arguments (no sync per invoke),
+# building the signature for every invoke vs. a prepared kernel
+offl_a = stream.zeros((64,))
+offl_b = stream.zeros((64,))
+for name, kernel in [("invoke_args", library.empty_kernel),
+                     ("invoke_prepared", library.empty_kernel.prepare(
+                         pymic.OffloadArray, pymic.OffloadArray,
+                         int, float))]:
+    ts = time.time()
+    for i in xrange(nrepeat):
+        stream.invoke(kernel, offl_a, offl_b, 64, 0.5)
+    te = time.time()
+    stream.sync()
+    timings.append((name, (te - ts) / float(nrepeat)))
+
+device_ptr = stream.allocate_device_memory(64)
+ts = time.time()
+for i in xrange(nrepeat):
+    stream.translate_device_pointer(device_ptr)
+te = time.time()
+timings.append(("translate_latency", (te - ts) / float(nrepeat)))
+stream.deallocate_device_memory(device_ptr)
 
 try:
     csv = open(benchmark + ".csv", "w")
     print >> csv, "benchmark;latency"
-    print >> csv, "{0};{1}".format(benchmark, (te - ts) / float(nrepeat))
+    for name, latency in timings:
+        print >> csv, "{0};{1}".format(name, latency)
 finally:
     csv.close()
@@ -40,4 +40,89 @@
 #define PYMIC_KERNEL __attribute__ ((visibility("default")))
 #endif
 
+/* Kernels with more than PYMIC_MAX_POSITIONAL_ARGS arguments receive a single
+ * argument block instead of one parameter per argument; PYMIC_ARG(args, i, T)
+ * yields the pointer that would have been passed as the i-th parameter.
+ * Only the first PYMIC_MAX_POSITIONAL_ARGS pointers of such a call can be
+ * scalar outputs: a scalar output after them is rejected (OffloadError)
+ * when the kernel is invoked or prepared.  Kernels invoked by pyMIC take
+ * their scalars as inputs, and their arrays are not affected. */
+#define PYMIC_MAX_POSITIONAL_ARGS 16
+
+typedef struct libxstream_argument pymic_args;
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int libxstream_get_data(const pymic_args *signature, size_t arg, const void **data);
+
+static inline void *pymic_arg(const pymic_args *args, size_t i) {
+    const void *data = NULL;
+    libxstream_get_data(args, i, &data);
+    return (void *)data;
+}
+
+#define PYMIC_ARG(ARGS, I, TYPE) ((TYPE *)pymic_arg(ARGS, I))
+
+/* Layout of the arguments: ARGS is the argument block of a packed kernel, or
+ * PYMIC_CONTEXT for the arguments of a kernel with positional parameters.
+ * The extents of an array are listed from the fastest-varying dimension on
+ * i.e., a C-ordered m x n array has the shape {n, m}, and the stride of a
+ * dimension is counted in elements. Arrays are always dense (C- or
+ * F-contiguous; pyMIC rejects other arrays), hence the stride is the product
+ * of the faster-varying extents. Arrays of an unknown type or with more
+ * than PYMIC_MAX_NDIMS dimensions are passed as bytes (PYMIC_DTYPE_BYTES). */
+#define PYMIC_MAX_NDIMS 4
+#define PYMIC_CONTEXT ((const pymic_args *)NULL)
+
+#define PYMIC_DTYPE_BYTES     -1
+#define PYMIC_DTYPE_INT64      0
+#define PYMIC_DTYPE_INT32      1
+#define PYMIC_DTYPE_FLOAT64    2
+#define PYMIC_DTYPE_COMPLEX128 3
+#define PYMIC_DTYPE_UINT64     4
+#define PYMIC_DTYPE_FLOAT32    5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int libxstream_get_dims(const pymic_args *signature, size_t arg, size_t *dims);
+int libxstream_get_shape(const pymic_args *signature, size_t arg, size_t shape[]);
+int libxstream_get_type(const pymic_args *signature, size_t arg, int *type);
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t pymic_ndim(const pymic_args *args, size_t i) {
+    size_t ndim = 0;
+    libxstream_get_dims(args, i, &ndim);
+    return ndim;
+}
+
+static inline size_t pymic_shape(const pymic_args *args, size_t i, size_t d) {
+    size_t shape[PYMIC_MAX_NDIMS] = { 0 };
+    libxstream_get_shape(args, i, shape);
+    return d < PYMIC_MAX_NDIMS ? shape[d] : 0;
+}
+
+static inline size_t pymic_stride(const pymic_args *args, size_t i, size_t d) {
+    size_t shape[PYMIC_MAX_NDIMS] = { 0 }, stride = 1, k;
+    libxstream_get_shape(args, i, shape);
+    for (k = 0; k < d && k < PYMIC_MAX_NDIMS; ++k) stride *= shape[k];
+    return stride;
+}
+
+static inline int pymic_dtype(const pymic_args *args, size_t i) {
+    /* element types of the argument (libxstream_type) mapped to PYMIC_DTYPE */
+    static const signed char map[] = { -1, -1, -1, 1, 0, -1, -1, -1, 4, 5, 2, -1, 3 };
+    int type = -1;
+    libxstream_get_type(args, i, &type);
+    return (0 <= type && type < (int)sizeof(map)) ? map[type] : PYMIC_DTYPE_BYTES;
+}
+
+#define PYMIC_NDIM(ARGS, I) pymic_ndim(ARGS, I)
+#define PYMIC_SHAPE(ARGS, I, D) pymic_shape(ARGS, I, D)
+#define PYMIC_STRIDE(ARGS, I, D) pymic_stride(ARGS, I, D)
+#define PYMIC_DTYPE(ARGS, I) pymic_dtype(ARGS, I)
+
 #endif
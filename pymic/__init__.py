@@ -35,6 +35,13 @@ from pymic.offload_array import OffloadArray
 
 from pymic.offload_stream import OffloadStream
 
+from pymic.offload_graph import OffloadGraph
+
+from pymic.offload_event import OffloadEvent
+
+from pymic.offload_kernel import OffloadKernel
+from pymic.offload_kernel import PreparedKernel
+
 from pymic.offload_device import OffloadDevice
 from pymic.offload_device import number_of_devices
 from pymic.offload_device import devices
@@ -52,17 +52,39 @@ if not _loaded:
         from pymic.pymic_libxstream import pymic_library_load
         from pymic.pymic_libxstream import pymic_library_unload
         from pymic.pymic_libxstream import pymic_library_find_kernel
+        from pymic.pymic_libxstream import pymic_stream_priority_range
+        from pymic.pymic_libxstream import pymic_stream_priority_default
         from pymic.pymic_libxstream import pymic_stream_create
         from pymic.pymic_libxstream import pymic_stream_destroy
         from pymic.pymic_libxstream import pymic_stream_sync
+        from pymic.pymic_libxstream import pymic_stream_wait_event
         from pymic.pymic_libxstream import pymic_stream_allocate
         from pymic.pymic_libxstream import pymic_stream_deallocate
+        from pymic.pymic_libxstream import pymic_memory_trim
+        from pymic.pymic_libxstream import pymic_memory_cache_info
+        from pymic.pymic_libxstream import pymic_memory_stats
+        from pymic.pymic_libxstream import pymic_memory_set_tag
         from pymic.pymic_libxstream \
             import pymic_stream_translate_device_pointer
         from pymic.pymic_libxstream import pymic_stream_memcpy_h2d
         from pymic.pymic_libxstream import pymic_stream_memcpy_d2h
         from pymic.pymic_libxstream import pymic_stream_memcpy_d2d
         from pymic.pymic_libxstream import pymic_stream_invoke_kernel
+        from pymic.pymic_libxstream import pymic_stream_invoke_prepared
+        from pymic.pymic_libxstream import pymic_kernel_prepare
+        from pymic.pymic_libxstream import pymic_kernel_destroy_prepared
+        from pymic.pymic_libxstream import pymic_stream_begin_capture
+        from pymic.pymic_libxstream import pymic_stream_end_capture
+        from pymic.pymic_libxstream import pymic_stream_add_callback
+        from pymic.pymic_libxstream import pymic_graph_destroy
+        from pymic.pymic_libxstream import pymic_graph_set_arg
+        from pymic.pymic_libxstream import pymic_graph_launch
+        from pymic.pymic_libxstream import pymic_event_create
+        from pymic.pymic_libxstream import pymic_event_destroy
+        from pymic.pymic_libxstream import pymic_event_record
+        from pymic.pymic_libxstream import pymic_event_query
+        from pymic.pymic_libxstream import pymic_event_sync
+        from pymic.pymic_libxstream import pymic_event_elapsed
         _loaded = True
         # debug(1, 'Successfully loaded LIBXSTREAM as offload engine')
     except ImportError as exc:
@@ -31,8 +31,11 @@ from __future__ import print_function
 
 import os
 import sys
+import traceback
 import numpy
 
+from pymic.offload_error import OffloadError
+
 
 class pymicConfig:
     """Object to hold the runtime configuration of pymic."""
@@ -60,6 +63,25 @@ class pymicConfig:
         # PYMIC_LIBRARY_PATH
         self._search_path = os.getenv("PYMIC_LIBRARY_PATH", "")
 
+        # PYMIC_TRACE_MEMORY
+        self._trace_memory = False
+        _trace_memory = os.getenv("PYMIC_TRACE_MEMORY", 0)
+        try:
+            self._trace_memory = int(_trace_memory) != 0
+        except:
+            pass
+
+        # PYMIC_RESIDENCY and PYMIC_RESIDENCY_LIMIT
+        self._residency = False
+        self._residency_limit = 0
+        _residency = os.getenv("PYMIC_RESIDENCY", 0)
+        _residency_limit = os.getenv("PYMIC_RESIDENCY_LIMIT", 0)
+        try:
+            self._residency = int(_residency) != 0
+            self._residency_limit = int(_residency_limit)
+        except:
+            pass
+
 
 _config = pymicConfig()
 
@@ -70,6 +92,16 @@ if _config._debug_level is not None:
           file=sys.stderr)
 
 
+def _call_site():
+    """Return the innermost frame outside of pymic as 'file:line'."""
+    here = os.path.dirname(os.path.abspath(__file__))
+    for frame in reversed(traceback.extract_stack()):
+        filename, lineno = frame[0], frame[1]
+        if os.path.dirname(os.path.abspath(filename)) != here:
+            return '{0}:{1}'.format(filename, lineno)
+    return None
+
+
 def _debug(level, format, *objs):
     if _config._debug_level is not None and _config._debug_level >= level:
         msg = "PYMIC: " + format.format(*objs)
@@ -128,9 +160,41 @@ def _map_data_types(dtype):
     return _data_type_map[dtype]
 
 
-class _DeviceAllocation:
+# maximum number of dimensions of an array argument (PYMIC_MAX_NDIMS)
+_max_ndims = 4
+
+
+def _array_layout(shape, order, dtype, nbytes, extents):
+    """Determine the number of dimensions and the data type of an array that
+       is passed to a kernel, and store its extents (fastest-varying first)
+       into extents.  An array of an unknown data type or with more than
+       _max_ndims dimensions is passed as bytes (data type -1)."""
+    ndim = len(shape)
+    if dtype not in _data_type_map or not 0 < ndim <= _max_ndims:
+        extents[0] = nbytes
+        return 1, -1
+    if order == 'C':
+        shape = shape[::-1]
+    extents[:ndim] = shape
+    return ndim, _data_type_map[dtype]
+
+
+class _DeviceAllocation(object):
     """Smart pointer to store the fake pointer and perform pointer
-       translation and offset computation."""
+       translation and offset computation.  The memory of an OffloadArray
+       may be evicted to host memory (_Residency), and it is uploaded again
+       when the fake pointer is used."""
+
+    # residency (see _Residency.track)
+    _residency = None
+    _nbytes = 0
+    _alignment = 64
+    _backing = None
+    _pinned = False
+    _ngraphs = 0
+    # other streams that enqueued operations on the allocation (by id)
+    _users = None
+
     def __init__(self, stream, device, device_ptr, sticky):
         """Initialize the fake pointer with the data coming from
            OffloadStream.allocate_device_memory."""
@@ -140,13 +204,44 @@ class _DeviceAllocation:
 
         self._stream = stream
         self._device = device
-        self._device_ptr = device_ptr
+        self._ptr = device_ptr
         self._sticky = sticky
 
+    @property
+    def _device_ptr(self):
+        if self._residency is not None:
+            self._residency.use(self)
+        return self._ptr
+
     def __str__(self):
         """Pretty print the value of this fake pointer."""
-        return '0x{0:x}'.format(self._device_ptr)
+        if self._ptr is None:
+            return 'evicted'
+        return '0x{0:x}'.format(self._ptr)
+
+    def _use(self, stream):
+        """Remember that the stream enqueued an operation on the memory."""
+        if stream is not self._stream:
+            if self._users is None:
+                self._users = {}
+            self._users[stream._stream_id] = stream
 
     def __del__(self):
         if not self._sticky:
-            self._stream.deallocate_device_memory(self)
+            # free in stream order rather than synchronizing all streams;
+            # the stream first waits for the other streams which used the
+            # memory, or all streams are synchronized if this fails or if
+            # the stream is capturing (nothing can be enqueued)
+            sync = self._stream._capturing
+            if self._users and not sync:
+                try:
+                    self._stream._join(self._users.values())
+                except OffloadError:
+                    sync = True
+            if not sync:
+                try:
+                    self._stream.deallocate_device_memory(self, sync=False)
+                    return
+                except OffloadError:
+                    pass
+            self._stream.deallocate_device_memory(self, sync=True)
@@ -0,0 +1,217 @@
+# Copyright (c) 2014-2016, Intel Corporation All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+# IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+# TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+# PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+from __future__ import print_function
+
+import collections
+import contextlib
+import weakref
+
+import numpy
+
+from pymic.offload_error import OffloadError
+
+from pymic._engine import pymic_stream_sync
+from pymic._engine import pymic_stream_allocate
+from pymic._engine import pymic_stream_deallocate
+from pymic._engine import pymic_stream_memcpy_h2d
+from pymic._engine import pymic_stream_memcpy_d2h
+
+from pymic._misc import _debug as debug
+
+
+class _Residency(object):
+    """Residency manager of the OffloadArrays of a device (opt-in).  The
+       manager tracks the last use of each buffer.  If the device runs out
+       of memory (or the resident buffers exceed the limit), the least
+       recently used buffers that are not pinned are evicted to host
+       memory, and a buffer is uploaded again when it is used next."""
+
+    def __init__(self, device_id, enabled=False, limit=0):
+        self._device_id = device_id
+        # least recently used buffer first (id -> weak reference)
+        self._lru = collections.OrderedDict()
+        # buffers used by the current operation cannot be evicted
+        self._held = {}
+        self._depth = 0
+        self._resident = 0
+        self._spilled = 0
+        self._evictions = 0
+        self._uploads = 0
+        self.configure(enabled, limit)
+
+    def configure(self, enabled, limit=0):
+        """Enable or disable eviction (an evicted buffer is still uploaded
+           when it is used); a limit greater than zero bounds the number of
+           bytes of the resident buffers."""
+        self._enabled = enabled
+        self._limit = max(limit, 0)
+
+    def info(self):
+        return {'enabled': self._enabled, 'limit': self._limit,
+                'resident': self._resident, 'spilled': self._spilled,
+                'evictions': self._evictions, 'uploads': self._uploads}
+
+    def allocate(self, stream_id, nbytes, alignment):
+        """Allocate device memory, and evict buffers as long as the device
+           is out of memory."""
+        while True:
+            try:
+                return pymic_stream_allocate(self._device_id, stream_id,
+                                             nbytes, alignment)
+            except OffloadError:
+                if not self._enabled or not self._evict(nbytes):
+                    raise
+
+    def track(self, allocation, nbytes, alignment=64):
+        """Track the buffer of an OffloadArray (as most recently used)."""
+        if not self._enabled:
+            return
+        allocation._residency = self
+        allocation._nbytes = nbytes
+        allocation._alignment = alignment
+        self._lru[id(allocation)] = weakref.ref(allocation)
+        self._resident += nbytes
+        with self.hold():
+            self._held[id(allocation)] = allocation
+            self._fit(0)
+
+    def untrack(self, allocation):
+        if self._lru.pop(id(allocation), None) is None:
+            return
+        self._held.pop(id(allocation), None)
+        if allocation._backing is None:
+            self._resident -= allocation._nbytes
+        else:
+            self._spilled -= allocation._nbytes
+        allocation._residency = None
+
+    def pin(self, allocation, pinned):
+        """A pinned buffer is never evicted (it is uploaded if necessary)."""
+        if allocation._residency is self:
+            self.use(allocation)
+            allocation._pinned = pinned
+
+    def refer(self, allocation, referred):
+        """A buffer which a graph refers to is never evicted since a
+           launch replays its pointer (counted per reference)."""
+        if allocation._residency is self:
+            if referred:
+                self.use(allocation)
+                allocation._ngraphs += 1
+            elif 0 < allocation._ngraphs:
+                allocation._ngraphs -= 1
+
+    def use(self, allocation):
+        """Mark the buffer as most recently used, and upload the buffer if
+           it was evicted."""
+        key = id(allocation)
+        if allocation._backing is not None:
+            self._upload(allocation)
+        self._lru[key] = self._lru.pop(key)
+        if self._depth:
+            self._held[key] = allocation
+
+    @contextlib.contextmanager
+    def hold(self):
+        """Keep the buffers used within the block resident e.g., all
+           arguments of a kernel."""
+        self._depth += 1
+        try:
+            yield
+        finally:
+            self._depth -= 1
+            if not self._depth:
+                self._held.clear()
+
+    def _buffers(self):
+        return [a for a in (r() for r in self._lru.values()) if a is not None]
+
+    def _fit(self, nbytes):
+        """Evict buffers until nbytes fit into the limit (if any)."""
+        excess = self._resident + nbytes - self._limit
+        if self._enabled and 0 < self._limit and 0 < excess:
+            self._evict(excess)
+
+    def _evict(self, nbytes):
+        """Evict the least recently used buffers that are neither pinned
+           nor held (at least nbytes).  Returns False if nothing is left
+           to evict."""
+        victims, size = [], 0
+        for allocation in self._buffers():
+            if size >= nbytes:
+                break
+            if (allocation._backing is None and not allocation._pinned and
+                    not allocation._ngraphs and
+                    id(allocation) not in self._held):
+                victims.append(allocation)
+                size += allocation._nbytes
+        if not victims:
+            return False
+        # pending work of any stream may still access the buffers
+        pymic_stream_sync(self._device_id, 0)
+        for allocation in victims:
+            allocation._backing = numpy.empty((allocation._nbytes,),
+                                              dtype=numpy.uint8)
+            pymic_stream_memcpy_d2h(self._device_id,
+                                    allocation._stream._stream_id,
+                                    allocation._ptr,
+                                    allocation._backing.ctypes.data,
+                                    allocation._nbytes, 0, 0)
+        pymic_stream_sync(self._device_id, 0)
+        for allocation in victims:
+            pymic_stream_deallocate(self._device_id,
+                                    allocation._stream._stream_id,
+                                    allocation._ptr, True)
+            debug(2, 'evicted {0} bytes on device {1} at 0x{2:x}',
+                  allocation._nbytes, self._device_id, allocation._ptr)
+            allocation._ptr = None
+        self._resident -= size
+        self._spilled += size
+        self._evictions += len(victims)
+        return True
+
+    def _upload(self, allocation):
+        nbytes = allocation._nbytes
+        stream_id = allocation._stream._stream_id
+        with self.hold():
+            self._fit(nbytes)
+            ptr = self.allocate(stream_id, nbytes, allocation._alignment)
+        pymic_stream_memcpy_h2d(self._device_id, stream_id,
+                                allocation._backing.ctypes.data, ptr,
+                                nbytes, 0, 0)
+        # the host copy must remain valid until the transfer completed
+        pymic_stream_sync(self._device_id, stream_id)
+        debug(2, 'uploaded {0} bytes on device {1} to 0x{2:x}',
+              nbytes, self._device_id, ptr)
+        allocation._ptr = ptr
+        allocation._backing = None
+        self._resident += nbytes
+        self._spilled -= nbytes
+        self._uploads += 1
@@ -41,6 +41,9 @@ from pymic._misc import _config as config
 _pymic_modules = [
     "offload_device",
     "offload_stream",
+    "offload_graph",
+    "offload_event",
+    "offload_kernel",
     "offload_array",
     "_tracing",
     "_misc"
@@ -118,6 +118,7 @@ class OffloadArray(object):
                     stream = self.stream
                 self.array = numpy.empty(self.shape, self.dtype, self.order)
                 self._device_ptr = stream.allocate_device_memory(self._nbytes)
+                device._residency.track(self._device_ptr, self._nbytes)
 
         self._library = _offload_libraries[device.device_id]
 
@@ -131,14 +132,16 @@ class OffloadArray(object):
         raise TypeError("An OffloadArray is not hashable.")
 
     @trace
-    def update_device(self):
+    def update_device(self, parallel=False):
         """Update the OffloadArray's buffer space on the associated
            device by copying the contents of the associated numpy.ndarray
            to the device.
 
            Parameters
            ----------
-           n/a
+           parallel : bool, optional, default False
+               Split a large array into chunks which are transferred
+               across internal streams of the device (in parallel).
 
            Returns
            -------
@@ -151,11 +154,11 @@ class OffloadArray(object):
         """
         host_ptr = self.array.ctypes.get_data()
         self.stream.transfer_host2device(host_ptr, self._device_ptr,
-                                         self._nbytes)
+                                         self._nbytes, parallel=parallel)
         return None
 
     @trace
-    def update_host(self):
+    def update_host(self, parallel=False):
         """Update the associated numpy.ndarray on the host with the contents
            by copying the OffloadArray's buffer space from the device to the
            host.
@@ -165,7 +168,9 @@ class OffloadArray(object):
 
            Parameters
            ----------
-           n/a
+           parallel : bool, optional, default False
+               Split a large array into chunks which are transferred
+               across internal streams of the device (in parallel).
 
            Returns
            -------
@@ -178,7 +183,7 @@ class OffloadArray(object):
         """
         host_ptr = self.array.ctypes.get_data()
         self.stream.transfer_device2host(self._device_ptr, host_ptr,
-                                         self._nbytes)
+                                         self._nbytes, parallel=parallel)
         return self
 
     def assign_stream(self, stream):
@@ -202,8 +207,52 @@ class OffloadArray(object):
             raise ValueError("Cannot assign a stream from different device "
                              "({0} != {1})".format(self.device,
                                                    stream.get_device()))
+        if self._device_ptr is not None:
+            # the memory is freed once the new stream is done with it
+            self._device_ptr._use(stream)
         self.stream = stream
 
+    def pin(self):
+        """Keep the buffer of this OffloadArray on the target device, i.e.,
+           the residency manager of the device never evicts the buffer
+           to host memory (an evicted buffer is uploaded right away).
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : OffloadArray
+               The object instance of this OffloadArray.
+
+           See Also
+           --------
+           unpin, OffloadDevice.enable_residency
+        """
+        self.device._residency.pin(self._device_ptr, True)
+        return self
+
+    def unpin(self):
+        """Allow the residency manager of the device to evict the buffer of
+           this OffloadArray to host memory again.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : OffloadArray
+               The object instance of this OffloadArray.
+
+           See Also
+           --------
+           pin, OffloadDevice.enable_residency
+        """
+        self.device._residency.pin(self._device_ptr, False)
+        return self
+
     def __add__(self, other):
         """Add an array or scalar to an array.
 
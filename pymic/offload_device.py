@@ -32,9 +32,15 @@ from __future__ import print_function
 import numpy
 
 from pymic._engine import pymic_get_ndevices
+from pymic._engine import pymic_memory_trim
+from pymic._engine import pymic_memory_cache_info
+from pymic._engine import pymic_memory_stats
+from pymic._engine import pymic_stream_priority_range
 
 from pymic._misc import _debug as debug
 from pymic._misc import _get_order as get_order
+from pymic._misc import _config as config
+from pymic._residency import _Residency as Residency
 from pymic._tracing import _trace as trace
 
 from pymic.offload_library import OffloadLibrary
@@ -66,6 +72,8 @@ def number_of_devices():
 class OffloadDevice:
     def __init__(self, device_id):
         self.device_id = device_id
+        self._residency = Residency(device_id, config._residency,
+                                    config._residency_limit)
         self.default_stream = OffloadStream(device=self)
 
     def __eq__(self, other):
@@ -112,25 +120,188 @@ class OffloadDevice:
         """
         return self.default_stream
 
-    def create_stream(self):
+    def create_stream(self, priority=None):
         """Create a new stream object for this device.  All streams on the same
-           device will execute enqueued requests concurrently.
+           device will execute enqueued requests concurrently.  If multiple
+           streams have pending requests, the requests of the stream with
+           the higher priority are executed first.  Requests of a stream
+           with a lower priority are delayed but never starved.
 
            Parameters
            ----------
-           n/a
+           priority : int, optional
+               Priority of the stream; a smaller value denotes a higher
+               priority.  The valid range is given by
+               stream_priority_range(), e.g., 0 (highest) to 7 (lowest).
+               By default (None), a stream is created with the middle of
+               the range such that other streams can be preferred as well
+               as deferred.  Values outside of the range are clamped.
 
            Returns
            -------
            out : offload_stream
-               The default stream object for this device.
+               A new stream object for this device.
+
+           See Also
+           --------
+           get_default_stream, stream_priority_range
+        """
+        return OffloadStream(self, priority=priority)
+
+    def stream_priority_range(self):
+        """Return the range of stream priorities as a tuple (least, greatest)
+           of inclusive bounds.  A stream with a smaller priority value is
+           served first.
+
+           Returns
+           -------
+           out : tuple
+               The lowest and the highest priority, e.g., (7, 0).
+
+           See Also
+           --------
+           create_stream
+        """
+        return pymic_stream_priority_range()
+
+    def memory_cache_info(self):
+        """Return the statistics of the memory cache of this device.  Device
+           memory that is deallocated remains cached, and serves subsequent
+           allocations of a similar size.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : dict
+               Number of allocations served by the cache ('hits') or by
+               the system ('misses'), and the number of bytes that are
+               cached but not allocated ('cached').
+
+           See Also
+           --------
+           trim_memory
+        """
+        hits, misses, cached = pymic_memory_cache_info(self._map_dev_id())
+        return {'hits': hits, 'misses': misses, 'cached': cached}
+
+    def trim_memory(self):
+        """Release the cached memory of this device to the system.  Cached
+           memory is otherwise only released if an allocation fails.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : int
+               Number of bytes that have been released.
+
+           See Also
+           --------
+           memory_cache_info
+        """
+        return pymic_memory_trim(self._map_dev_id())
+
+    def memory_stats(self):
+        """Return the statistics of the memory allocated on this device.
+           The statistics account for the requested sizes of the allocations
+           that are live, and optionally by tag (PYMIC_TRACE_MEMORY tags each
+           allocation with the call site that created it).
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : dict
+               Number of bytes allocated ('live') and the maximum so far
+               ('peak'), number of live allocations ('nlive') and of all
+               allocations ('nallocs'), bytes acquired from the system
+               ('acquired') in a number of regions ('nsegments') and the
+               bytes cached ('cached'), live allocations by size
+               ('histogram', bin i counts sizes up to 2**(i+6) bytes), and
+               the live bytes and allocations per tag ('tags').
+
+           See Also
+           --------
+           memory_cache_info, trim_memory
+        """
+        return pymic_memory_stats(self._map_dev_id())
+
+    def enable_residency(self, limit=0):
+        """Let the device memory be oversubscribed by OffloadArrays.  The
+           last use of each OffloadArray is tracked, and if the device runs
+           out of memory, the least recently used arrays that are not
+           pinned are evicted to host memory.  An evicted array is uploaded
+           again before it is used next (e.g., by a kernel).  Eviction and
+           upload synchronize all streams.  This is also enabled by setting
+           PYMIC_RESIDENCY (and PYMIC_RESIDENCY_LIMIT).
+
+           Only OffloadArrays that are created afterwards are tracked, and
+           the arrays used by a captured graph are pinned.
+
+           Parameters
+           ----------
+           limit : int, optional
+               Maximum number of bytes of the resident OffloadArrays
+               (0: the memory of the device is the limit).
+
+           Returns
+           -------
+           n/a
+
+           See Also
+           --------
+           disable_residency, residency_info, OffloadArray.pin
+        """
+        if limit < 0:
+            raise ValueError("Negative residency limit: {0}".format(limit))
+        self._residency.configure(True, limit)
+
+    def disable_residency(self):
+        """Stop evicting OffloadArrays.  An array that was evicted is
+           still uploaded to the device when it is used next.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           n/a
+
+           See Also
+           --------
+           enable_residency, residency_info
+        """
+        self._residency.configure(False)
+
+    def residency_info(self):
+        """Return the statistics of the residency manager of this device.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : dict
+               Whether the manager is enabled ('enabled') and its limit
+               ('limit'), the bytes of the tracked arrays that are resident
+               ('resident') or evicted to host memory ('spilled'), and
+               the number of evictions ('evictions') and uploads
+               ('uploads') so far.
 
            See Also
            --------
-           get_default_stream
+           enable_residency, memory_stats
         """
-        raise NotImplementedError('This function has been disabled.')
-        # return OffloadStream(self)
+        return self._residency.info()
 
     @trace
     def load_library(self, *libraries, **kwargs):
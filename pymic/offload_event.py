@@ -0,0 +1,166 @@
+# Copyright (c) 2014-2016, Intel Corporation All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+# IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+# TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+# PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+
+from __future__ import print_function
+
+from pymic.offload_error import OffloadError
+
+from pymic._engine import pymic_event_create
+from pymic._engine import pymic_event_destroy
+from pymic._engine import pymic_event_record
+from pymic._engine import pymic_event_query
+from pymic._engine import pymic_event_sync
+from pymic._engine import pymic_event_elapsed
+
+from pymic._misc import _debug as debug
+from pymic._tracing import _trace as trace
+
+
+class OffloadEvent:
+    """Marker in an OffloadStream that completes once all requests that
+       were enqueued into the stream before recording the event have
+       completed.  A timed event also takes the time of its completion on
+       the side of the offload engine, so that the time between two events
+       does not include the latency of synchronizing with the host.
+    """
+
+    def __init__(self, device, timed=True):
+        self._device = device
+        self._device_id = device.device_id
+        self._timed = timed
+        self._event_id = pymic_event_create(self._device_id, timed)
+        debug(1,
+              'created event 0x{0:x} for device {1} '
+              '(timed {2})'.format(self._event_id, self._device_id, timed))
+
+    def __del__(self):
+        debug(1,
+              'destroying event 0x{0:0x} for device {1}',
+              self._event_id, self._device_id)
+        if self._event_id is not None:
+            pymic_event_destroy(self._device_id, self._event_id)
+
+    def __repr__(self):
+        return "OffloadEvent({0}) for {1}".format(self._event_id,
+                                                  self._device.__repr__())
+
+    def __str__(self):
+        return "event({0}) for {1}".format(self._event_id, str(self._device))
+
+    @trace
+    def record(self, stream):
+        """Record the event into a stream, i.e., the event completes once
+           the requests enqueued into the stream so far have completed.
+           An event can be recorded again to start over.
+
+           Parameters
+           ----------
+           stream : OffloadStream
+              Stream to record the event into
+
+           See Also
+           --------
+           OffloadStream.record, query, sync
+
+           Returns
+           -------
+           None
+        """
+        if stream._device_id != self._device_id:
+            raise OffloadError('Cannot record an event into a stream '
+                               'of a different device')
+        debug(2, 'recording event 0x{0:x} into stream 0x{1:x} on device {2}',
+                 self._event_id, stream._stream_id, self._device_id)
+        pymic_event_record(self._device_id, self._event_id, stream._stream_id)
+        return None
+
+    @trace
+    def query(self):
+        """Check whether the event has completed (non-blocking).
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : bool
+              True if the event has completed
+        """
+        return pymic_event_query(self._device_id, self._event_id)
+
+    @trace
+    def sync(self):
+        """Wait for the event to complete, i.e., for the requests that were
+           enqueued before recording the event.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           n/a
+        """
+        debug(2, 'syncing event 0x{0:x} on device {1}',
+                 self._event_id, self._device_id)
+        pymic_event_sync(self._device_id, self._event_id)
+        return None
+
+    @trace
+    def elapsed_ms(self, other):
+        """Time in milliseconds from this event to another event.  Both
+           events have to be timed, and both must have completed (see sync).
+
+           Parameters
+           ----------
+           other : OffloadEvent
+              Event that was recorded after this event
+
+           See Also
+           --------
+           OffloadStream.record
+
+           Returns
+           -------
+           out : float
+              Elapsed time between the completion of both events
+
+           Examples
+           --------
+           >>> start = stream.record()
+           >>> stream.invoke(library.dgemm, A, B, C, n, m, k)
+           >>> end = stream.record()
+           >>> end.sync()
+           >>> print(start.elapsed_ms(end))
+        """
+        if not self._timed or not other._timed:
+            raise OffloadError('Cannot measure the time between events '
+                               'which are not timed')
+        return pymic_event_elapsed(self._device_id, self._event_id,
+                                   other._event_id)
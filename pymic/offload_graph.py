@@ -0,0 +1,210 @@
+# Copyright (c) 2014-2016, Intel Corporation All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+# IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+# TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+# PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+from __future__ import print_function
+
+from pymic.offload_error import OffloadError
+
+from pymic._engine import pymic_stream_begin_capture
+from pymic._engine import pymic_stream_end_capture
+from pymic._engine import pymic_graph_destroy
+from pymic._engine import pymic_graph_set_arg
+from pymic._engine import pymic_graph_launch
+
+from pymic._misc import _debug as debug
+from pymic._misc import _DeviceAllocation as DeviceAllocation
+from pymic._tracing import _trace as trace
+
+import pymic
+import numpy
+
+
+class OffloadGraph:
+    """Sequence of operations captured from an OffloadStream.  While the
+       capture is active, the operations enqueued into the stream are
+       recorded instead of being executed.  A launch replays the whole
+       sequence with a single request, which avoids the overhead of
+       enqueuing the operations one by one.  The graph keeps the arrays
+       it refers to alive.  A launch replays the operations as they were
+       when it was enqueued, i.e., launches may overlap, and patching or
+       destroying the graph does not affect the launches in flight.
+    """
+
+    def __init__(self, stream):
+        self._stream = stream
+        self._device_id = stream._device_id
+        self._graph_id = None
+        # the graph replays raw pointers: the allocations it refers to
+        # (captured, or patched per node and argument) are kept alive
+        self._captured = []
+        self._patched = {}
+
+    def __del__(self):
+        if self._graph_id is not None:
+            # launches in flight keep the operations alive, and the arrays
+            # are freed after them (see launch)
+            debug(1,
+                  'destroying graph 0x{0:0x} for device {1}',
+                  self._graph_id, self._device_id)
+            pymic_graph_destroy(self._device_id, self._graph_id)
+            self._graph_id = None
+        for value in self._captured + list(self._patched.values()):
+            self._refer(value, False)
+        self._captured = []
+        self._patched = {}
+
+    def __enter__(self):
+        if self._graph_id is not None:
+            raise OffloadError('Graph has already been captured')
+        debug(2, 'begin capturing stream 0x{0:x} on device {1}',
+                 self._stream._stream_id, self._device_id)
+        pymic_stream_begin_capture(self._device_id, self._stream._stream_id)
+        self._stream._graph = self
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self._stream._graph = None
+        self._graph_id = pymic_stream_end_capture(self._device_id,
+                                                  self._stream._stream_id)
+        debug(2, 'captured graph 0x{0:x} from stream 0x{1:x} on device {2}',
+                 self._graph_id, self._stream._stream_id, self._device_id)
+        return False
+
+    def _capture(self, allocation):
+        """The captured operation refers to the allocation."""
+        self._refer(allocation, True)
+        self._captured.append(allocation)
+
+    @staticmethod
+    def _refer(value, referred):
+        # a graph replays the pointer, never evict the allocation
+        if (isinstance(value, DeviceAllocation) and
+                value._residency is not None):
+            value._residency.refer(value, referred)
+
+    @trace
+    def launch(self, stream=None):
+        """Enqueue all captured operations with a single request.  The
+           operations execute asynchronously with stream semantics.
+
+           Parameters
+           ----------
+           stream : OffloadStream, optional, default None
+              Stream to launch the graph into; None designates the stream
+              the graph was captured from
+
+           See Also
+           --------
+           OffloadStream.capture, patch
+
+           Returns
+           -------
+           None
+
+           Examples
+           --------
+           >>> with stream.capture() as graph:
+           ...     stream.invoke(library.dgemm, A, B, C, n, m, k)
+           >>> for i in range(10):
+           ...     graph.launch()
+           >>> stream.sync()
+        """
+
+        if self._graph_id is None:
+            raise OffloadError('Cannot launch a graph before its capture '
+                               'has completed')
+        if stream is None:
+            stream = self._stream
+        if stream._device_id != self._device_id:
+            raise OffloadError('Cannot launch a graph on a different device')
+
+        debug(2, 'launching graph 0x{0:x} through stream 0x{1:x} '
+                 'on device {2}', self._graph_id, stream._stream_id,
+                 self._device_id)
+        pymic_graph_launch(self._device_id, self._graph_id, stream._stream_id)
+        # the arrays are not freed before the launch completed
+        for value in self._captured + list(self._patched.values()):
+            if isinstance(value, DeviceAllocation):
+                value._use(stream)
+        return None
+
+    @trace
+    def patch(self, node, arg, value):
+        """Replace an argument of a captured operation for the following
+           launches; the launches in flight are not affected.
+
+           Parameters
+           ----------
+           node : int
+              Index of the operation in the order of capture
+           arg : int
+              Index of the argument of the operation
+           value : OffloadArray, numpy.ndarray, or int
+              New argument: an array replaces the (device or host) pointer,
+              an int is taken as a raw pointer
+
+           See Also
+           --------
+           launch
+
+           Returns
+           -------
+           None
+
+           Examples
+           --------
+           >>> with stream.capture() as graph:
+           ...     stream.invoke(library.dscal, offl_a, n, alpha)
+           >>> graph.patch(0, 0, offl_b)
+           >>> graph.launch()
+        """
+
+        if self._graph_id is None:
+            raise OffloadError('Cannot patch a graph before its capture '
+                               'has completed')
+
+        if isinstance(value, pymic.OffloadArray):
+            value = value._device_ptr
+        if isinstance(value, DeviceAllocation):
+            pointer = value._device_ptr
+        elif isinstance(value, numpy.ndarray):
+            pointer = value.ctypes.data
+        else:
+            pointer = int(value)
+
+        debug(3, 'patching argument {0} of node {1} of graph 0x{2:x} '
+                 'on device {3}', arg, node, self._graph_id, self._device_id)
+        pymic_graph_set_arg(self._device_id, self._graph_id, node, arg,
+                            pointer)
+        # the graph refers to the new value; the previous value is freed
+        # after the launches that used it (see launch)
+        self._refer(value, True)
+        self._refer(self._patched.pop((node, arg), None), False)
+        self._patched[(node, arg)] = value
+        return None
@@ -0,0 +1,224 @@
+# Copyright (c) 2014-2016, Intel Corporation All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+# IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+# TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+# PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+
+from __future__ import print_function
+
+from pymic.offload_error import OffloadError
+
+from pymic._engine import pymic_kernel_prepare
+from pymic._engine import pymic_kernel_destroy_prepared
+from pymic._engine import pymic_stream_invoke_prepared
+
+from pymic._misc import _debug as debug
+from pymic._misc import _map_data_types as map_data_types
+from pymic._misc import _array_layout as array_layout
+from pymic._misc import _max_ndims as max_ndims
+
+import pymic
+import numpy
+
+
+# scalar types that can be passed to a kernel by value
+_scalar_types = [
+    numpy.dtype(numpy.int64),
+    numpy.dtype(numpy.int32),
+    numpy.dtype(numpy.float64),
+    numpy.dtype(numpy.complex128),
+    numpy.dtype(numpy.uint64)
+]
+
+
+class OffloadKernel(tuple):
+    """Kernel of an OffloadLibrary, i.e., the tuple (name, function
+       pointer, device, library) that is passed to OffloadStream.invoke.
+    """
+
+    def __new__(cls, name, funcptr, device, library):
+        return tuple.__new__(cls, (name, funcptr, device, library))
+
+    def prepare(self, *arg_spec):
+        """Prepare the invocation of the kernel for a fixed list of argument
+           kinds.  The signature of the call is built once; each invoke of
+           the prepared kernel only passes the device pointers of the arrays
+           and the values of the scalars.
+
+           Parameters
+           ----------
+           arg_spec : OffloadArray, None, scalar type, or scalar
+              Kind of each argument: an OffloadArray (or the class itself,
+              or None) designates an array argument, a scalar type (e.g.,
+              int, float, numpy.int32) or a scalar designates a scalar of
+              this type; the shape and data type of an OffloadArray are
+              passed to the kernel for every invoke (the class itself or
+              None is passed as bytes); an invoke with an OffloadArray of
+              another shape, dtype, or order raises ValueError
+
+           See Also
+           --------
+           OffloadStream.invoke
+
+           Returns
+           -------
+           out : PreparedKernel
+              Kernel to be invoked with arguments of the given kinds
+
+           Examples
+           --------
+           >>> dscal = library.dscal.prepare(pymic.OffloadArray, int, float)
+           >>> for a in arrays:
+           ...     stream.invoke(dscal, a, a.size, 2.0)
+        """
+
+        return PreparedKernel(self, arg_spec)
+
+
+def _frozen_layout(array):
+    """Layout of an OffloadArray that is passed to a prepared kernel."""
+    shape = array.shape
+    if not isinstance(shape, tuple):
+        shape = tuple(shape) if hasattr(shape, '__len__') else (shape,)
+    return (shape, numpy.dtype(array.dtype), array.order)
+
+
+class PreparedKernel:
+    """Invocation of a kernel with a frozen signature (OffloadKernel.prepare).
+       A prepared kernel is invoked through OffloadStream.invoke, but it must
+       not be invoked by multiple threads at the same time.
+    """
+
+    def __init__(self, kernel, arg_spec):
+        self._kernel = kernel
+        self._device = kernel[2]
+        self._device_id = kernel[2].device_id
+        self._plan_id = None
+        self._argc = len(arg_spec)
+
+        # the array of pointers persists; a scalar is passed by the address
+        # of its slot, and an array by the device pointer that is patched
+        # for every invoke
+        arg_dims = numpy.empty((self._argc,), dtype=numpy.int64)
+        arg_type = numpy.empty((self._argc,), dtype=numpy.int64)
+        arg_size = numpy.empty((self._argc,), dtype=numpy.int64)
+        arg_shape = numpy.zeros((self._argc, max_ndims), dtype=numpy.int64)
+        self._ptrs = numpy.zeros((self._argc,), dtype=numpy.int64)
+        self._arrays = []
+        self._layouts = {}
+        self._scalars = []
+        for i, s in enumerate(arg_spec):
+            if (s is None or s is pymic.OffloadArray or
+                    isinstance(s, pymic.OffloadArray)):
+                if isinstance(s, pymic.OffloadArray):
+                    # the layout of the given array is frozen
+                    arg_dims[i], arg_type[i] = array_layout(s.shape, s.order,
+                                                            s.dtype, s._nbytes,
+                                                            arg_shape[i])
+                    arg_size[i] = s._nbytes
+                    self._layouts[i] = _frozen_layout(s)
+                else:
+                    arg_dims[i], arg_type[i], arg_size[i] = 1, -1, 0
+                self._arrays.append(i)
+            elif isinstance(s, numpy.ndarray):
+                raise OffloadError("Cannot prepare a kernel with "
+                                   "copy-in/copy-out arguments, use "
+                                   "OffloadArrays instead")
+            else:
+                if isinstance(s, (type, numpy.dtype)):
+                    dtype = numpy.dtype(s)
+                else:
+                    dtype = numpy.asarray(s).dtype
+                if dtype not in _scalar_types:
+                    raise ValueError("Scalar argument {0} of type {1} is "
+                                     "not supported".format(i, dtype))
+                slot = numpy.zeros((), dtype=dtype)
+                arg_dims[i] = 0
+                arg_type[i] = map_data_types(dtype)
+                arg_size[i] = dtype.itemsize
+                self._ptrs[i] = slot.ctypes.data
+                self._scalars.append((i, slot))
+        self._ptrs_addr = self._ptrs.ctypes.data
+
+        self._plan_id = pymic_kernel_prepare(self._device_id, kernel[1],
+                                             self._argc, arg_dims, arg_type,
+                                             arg_size, arg_shape)
+        debug(1, "(device {0}) prepared kernel '{1}' (pointer 0x{2:x}) "
+                 "with {3} argument(s) ({4} arrays, {5} scalars)",
+                 self._device_id, kernel[0], kernel[1], self._argc,
+                 len(self._arrays), len(self._scalars))
+
+    def __del__(self):
+        if self._plan_id is not None:
+            debug(1,
+                  'destroying prepared kernel 0x{0:0x} for device {1}',
+                  self._plan_id, self._device_id)
+            pymic_kernel_destroy_prepared(self._device_id, self._plan_id)
+
+    def __repr__(self):
+        return "PreparedKernel('{0}', {1} args) for {2}".format(
+            self._kernel[0], self._argc, self._device.__repr__())
+
+    def __str__(self):
+        return "prepared kernel '{0}' for {1}".format(self._kernel[0],
+                                                      str(self._device))
+
+    def _invoke(self, stream, args):
+        """Patch the arguments and enqueue the kernel into the stream."""
+
+        if len(args) != self._argc:
+            raise ValueError("Prepared kernel '{0}' takes {1} arguments "
+                             "({2} given)".format(self._kernel[0],
+                                                  self._argc, len(args)))
+
+        ptrs = self._ptrs
+        with self._device._residency.hold():
+            for i in self._arrays:
+                a = args[i]
+                if a is None:
+                    ptrs[i] = 0
+                elif isinstance(a, pymic.OffloadArray):
+                    layout = self._layouts.get(i)
+                    if layout is not None and _frozen_layout(a) != layout:
+                        raise ValueError("Argument {0} of prepared kernel "
+                                         "'{1}' must have shape {2}, dtype "
+                                         "{3}, and order '{4}'".format(
+                                             i, self._kernel[0], *layout))
+                    stream._use(a._device_ptr)
+                    ptrs[i] = a._device_ptr._device_ptr  # fake pointer
+                else:
+                    raise OffloadError("Argument {0} of prepared kernel "
+                                       "'{1}' must be an OffloadArray or "
+                                       "None".format(i, self._kernel[0]))
+        for i, slot in self._scalars:
+            slot[()] = args[i]
+
+        debug(2, "(device {0}, stream 0x{1:x}) invoking prepared kernel "
+                 "'{2}' with {3} argument(s)", self._device_id,
+                 stream._stream_id, self._kernel[0], self._argc)
+        pymic_stream_invoke_prepared(self._device_id, stream._stream_id,
+                                     self._plan_id, self._argc,
+                                     self._ptrs_addr)
+        return None
@@ -42,6 +42,8 @@ from pymic._engine import pymic_library_load
 from pymic._engine import pymic_library_unload
 from pymic._engine import pymic_library_find_kernel
 
+from pymic.offload_kernel import OffloadKernel
+
 
 # retrieve the installation path of the module
 pymic_dir = os.path.dirname(os.path.abspath(__file__))
@@ -148,4 +150,4 @@ class OffloadLibrary:
                                                 self._handle, attr)
             self._cache[attr] = funcptr
 
-        return attr, funcptr, self._device, self
+        return OffloadKernel(attr, funcptr, self._device, self)
@@ -31,42 +31,136 @@ from __future__ import print_function
 
 from pymic.offload_error import OffloadError
 
+from pymic._engine import pymic_stream_priority_default
 from pymic._engine import pymic_stream_create
 from pymic._engine import pymic_stream_destroy
 from pymic._engine import pymic_stream_sync
-from pymic._engine import pymic_stream_allocate
+from pymic._engine import pymic_stream_wait_event
 from pymic._engine import pymic_stream_deallocate
+from pymic._engine import pymic_memory_set_tag
 from pymic._engine import pymic_stream_translate_device_pointer
 from pymic._engine import pymic_stream_memcpy_h2d
 from pymic._engine import pymic_stream_memcpy_d2h
 from pymic._engine import pymic_stream_memcpy_d2d
 from pymic._engine import pymic_stream_invoke_kernel
+from pymic._engine import pymic_stream_add_callback
+
+from pymic.offload_graph import OffloadGraph
+from pymic.offload_event import OffloadEvent
+from pymic.offload_kernel import PreparedKernel
 
 from pymic._misc import _debug as debug
 from pymic._misc import _get_order as get_order
 from pymic._misc import _DeviceAllocation as DeviceAllocation
 from pymic._misc import _map_data_types as map_data_types
+from pymic._misc import _array_layout as array_layout
+from pymic._misc import _max_ndims as max_ndims
+from pymic._misc import _call_site as call_site
+from pymic._misc import _config as config
 from pymic._tracing import _trace as trace
 
 import pymic
 import numpy
+import os
+import struct
+import threading
+import traceback
+
+
+class _CallbackThread:
+    """Calls the callbacks of all streams on a dedicated thread.  The
+       runtime thread which completes the work of a stream only writes a
+       token into a pipe (without taking the GIL); this thread blocks in
+       reading the pipe and holds the GIL only while calling the callback.
+    """
+
+    _instance = None
+    _instance_lock = threading.Lock()
+
+    @staticmethod
+    def get():
+        with _CallbackThread._instance_lock:
+            if _CallbackThread._instance is None:
+                _CallbackThread._instance = _CallbackThread()
+        return _CallbackThread._instance
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._callbacks = {}
+        self._token = 0
+        self._token_size = struct.calcsize('q')
+        self._read_fd, self._write_fd = os.pipe()
+        self._thread = threading.Thread(target=self._run,
+                                        name='pymic-callbacks')
+        self._thread.daemon = True
+        self._thread.start()
+
+    def register(self, callback, args):
+        with self._lock:
+            self._token += 1
+            self._callbacks[self._token] = (callback, args)
+            return self._token
+
+    def unregister(self, token):
+        with self._lock:
+            self._callbacks.pop(token, None)
+
+    def _run(self):
+        while True:
+            data = os.read(self._read_fd, self._token_size)
+            while len(data) < self._token_size:
+                data += os.read(self._read_fd, self._token_size - len(data))
+            token = struct.unpack('q', data)[0]
+            with self._lock:
+                callback, args = self._callbacks.pop(token)
+            try:
+                callback(*args)
+            except Exception:
+                traceback.print_exc()
 
 
 class OffloadStream:
     """
     """
 
-    def __init__(self, device=None):
+    def __init__(self, device=None, priority=None):
         # save a reference to the device
         assert device is not None
         self._device = device
         self._device_id = device.device_id
 
-        # construct the stream
-        self._stream_id = pymic_stream_create(self._device_id, 'stream')
+        # construct the stream (the middle of the range by default)
+        if priority is None:
+            priority = pymic_stream_priority_default()
+        self._priority = priority
+        self._stream_id = pymic_stream_create(self._device_id, 'stream',
+                                              priority)
+        self._graph = None  # graph being captured (if any)
         debug(1,
-              'created stream 0x{0:x} for device {1}'.format(self._stream_id,
-                                                             self._device_id))
+              'created stream 0x{0:x} for device {1} '
+              '(priority {2})'.format(self._stream_id, self._device_id,
+                                      priority))
+
+    @property
+    def _capturing(self):
+        return self._graph is not None
+
+    def _use(self, allocation):
+        """An operation of this stream uses the allocation; the graph being
+           captured (if any) refers to the allocation."""
+        allocation._use(self)
+        if self._graph is not None:
+            self._graph._capture(allocation)
+
+    def _join(self, streams):
+        """Operations enqueued into this stream afterwards wait for the
+           operations enqueued into the given streams so far."""
+        for stream in streams:
+            event = OffloadEvent(self._device, timed=False)
+            event.record(stream)
+            # the stream takes a copy of the event
+            pymic_stream_wait_event(self._device_id, self._stream_id,
+                                    event._event_id)
 
     def __del__(self):
         debug(1,
@@ -98,6 +192,114 @@ class OffloadStream:
         pymic_stream_sync(self._device_id, self._stream_id)
         return None
 
+    def capture(self):
+        """Capture the operations enqueued into this OffloadStream into an
+           OffloadGraph instead of executing them.  Outstanding requests are
+           completed before the capture begins.  Kernels invoked while
+           capturing may only take OffloadArrays and scalars as arguments.
+
+           Parameters
+           ----------
+           n/a
+
+           Returns
+           -------
+           out : OffloadGraph
+              Context manager; the graph can be launched once the capture
+              has ended
+
+           See Also
+           --------
+           OffloadGraph.launch
+
+           Examples
+           --------
+           >>> with stream.capture() as graph:
+           ...     offl_a.update_device()
+           ...     stream.invoke(library.dgemm, A, B, C, n, m, k)
+           ...     offl_c.update_host()
+           >>> graph.launch()
+           >>> stream.sync()
+        """
+        return OffloadGraph(self)
+
+    @trace
+    def add_callback(self, callback, *args):
+        """Call a Python function once all requests enqueued into this
+           OffloadStream so far have completed.  The callbacks are called in
+           stream order on a dedicated callback thread i.e., the invoking
+           thread is not blocked.  A callback must not sync the stream.
+
+           Parameters
+           ----------
+           callback : callable
+              Function to call
+           args : optional
+              Arguments passed to the callback
+
+           Returns
+           -------
+           None
+
+           See Also
+           --------
+           sync, record
+
+           Examples
+           --------
+           >>> stream.invoke(library.dgemm, A, B, C, n, m, k)
+           >>> offl_c.update_host()
+           >>> stream.add_callback(send_result, c)
+        """
+        if self._capturing:
+            raise OffloadError('Cannot add a callback while capturing')
+        dispatcher = _CallbackThread.get()
+        token = dispatcher.register(callback, args)
+        debug(2, 'adding callback {0} to stream 0x{1:x} on device {2}',
+                 callback, self._stream_id, self._device_id)
+        try:
+            pymic_stream_add_callback(self._device_id, self._stream_id,
+                                      dispatcher._write_fd, token)
+        except Exception:
+            # the callback is never called
+            dispatcher.unregister(token)
+            raise
+        return None
+
+    @trace
+    def record(self, timed=True):
+        """Record an event into this OffloadStream.  The event completes
+           once the requests enqueued so far have completed.
+
+           Parameters
+           ----------
+           timed : bool, optional, default True
+              Take the time at which the event completes (see
+              OffloadEvent.elapsed_ms)
+
+           Returns
+           -------
+           out : OffloadEvent
+              Event recorded into the stream
+
+           See Also
+           --------
+           OffloadEvent.record, OffloadEvent.elapsed_ms
+
+           Examples
+           --------
+           >>> start = stream.record()
+           >>> offl_a.update_device()
+           >>> end = stream.record()
+           >>> end.sync()
+           >>> print(start.elapsed_ms(end))
+        """
+        if self._capturing:
+            raise OffloadError('Cannot record an event while capturing')
+        event = OffloadEvent(self._device, timed)
+        event.record(self)
+        return event
+
     def __eq__(self, other):
         return (self._device == other.device and
                 self._stream_id == other.stream_id)
@@ -109,7 +311,8 @@ class OffloadStream:
     def __str__(self):
         return "stream({0}) for {1}".format(self._stream_id, str(self._device))
 
-    def allocate_device_memory(self, nbytes, alignment=64, sticky=False):
+    def allocate_device_memory(self, nbytes, alignment=64, sticky=False,
+                               tag=None):
         """Allocate device memory on device associated with the invoking
            stream object.  Though it is part of the stream interface,
            the operation is synchronous.
@@ -124,6 +327,9 @@ class OffloadStream:
               Number of bytes to allocate
            alignment : int
               Alignment of the data on the target device.
+           tag : str, optional
+              Account the memory for the tag (OffloadDevice.memory_stats);
+              the call site is used if PYMIC_TRACE_MEMORY is set.
 
            See Also
            --------
@@ -148,18 +354,27 @@ class OffloadStream:
             raise ValueError('Cannot allocate negative amount of '
                              'memory: {0}'.format(nbytes))
 
-        device_ptr = pymic_stream_allocate(device, self._stream_id,
-                                           nbytes, alignment)
+        # the residency manager evicts OffloadArrays if out of memory
+        device_ptr = self._device._residency.allocate(self._stream_id,
+                                                      nbytes, alignment)
+        if tag is None and config._trace_memory:
+            tag = call_site()
+        if tag is not None:
+            pymic_memory_set_tag(device, device_ptr, tag)
         device_ptr = DeviceAllocation(self, device, device_ptr, sticky)
         debug(2, 'allocated {0} bytes on device {1} at {2}'
                  ', alignment {3}',
                  nbytes, device, device_ptr, alignment)
         return device_ptr
 
-    def deallocate_device_memory(self, device_ptr):
+    def deallocate_device_memory(self, device_ptr, sync=True):
         """Deallocate device memory previously allocated through
            allocate_device_memory.  Though it is part of the stream
-           interface, the operation is synchronous.
+           interface, the operation is synchronous by default i.e., it
+           waits for all streams.  Otherwise, the memory is released once
+           the operations enqueued into this stream so far are completed,
+           and the call does not block.  Operations of other streams must
+           not use the memory anymore unless this stream waits for them.
 
            Caution: this is a low-level function, do not use it unless you
                     have a very specific reason to do so.  Better use the
@@ -169,6 +384,8 @@ class OffloadStream:
            ----------
            device_ptr : int
               Fake pointer of memory do deallocate
+           sync : bool, optional, default True
+              Wait for all streams, or release the memory in stream order
 
            See Also
            --------
@@ -194,15 +411,21 @@ class OffloadStream:
         # TODO: add more safety checks here (e.g., pointer from right device
         #       and stream)
 
+        if device_ptr._residency is not None:
+            device_ptr._residency.untrack(device_ptr)
+        if device_ptr._ptr is None:
+            # evicted to host memory, nothing to deallocate on the device
+            return None
         pymic_stream_deallocate(self._device_id, self._stream_id,
-                                device_ptr._device_ptr)
-        debug(2, 'deallocated pointer {0} on device {1}',
-                 device_ptr, device)
+                                device_ptr._ptr, sync)
+        debug(2, 'deallocated pointer {0} on device {1} (sync={2})',
+                 device_ptr, device, sync)
 
         return None
 
     def transfer_host2device(self, host_ptr, device_ptr,
-                             nbytes, offset_host=0, offset_device=0):
+                             nbytes, offset_host=0, offset_device=0,
+                             parallel=False):
         """Transfer data from a host memory location (identified by its
            raw pointer (i.e., a C pointer) to a memory region (identified
            by its fake pointer) on the target device.  The operation is
@@ -225,6 +448,9 @@ class OffloadStream:
            offset_device : int, optional, default 0
               Transfer offset (bytes) to be added to the address of the device
               memory.
+           parallel : bool, optional, default False
+              Split a large transfer into chunks across internal streams;
+              the transfer is still ordered with respect to this stream.
 
            See Also
            --------
@@ -277,14 +503,16 @@ class OffloadStream:
         debug(1, '(host -> device {0}) transferring {1} bytes '
                  '(host ptr 0x{2:x}, device ptr {3})',
                  self._device_id, nbytes, host_ptr, device_ptr)
+        self._use(device_ptr)
         device_ptr = device_ptr._device_ptr
         pymic_stream_memcpy_h2d(self._device_id, self._stream_id,
                                 host_ptr, device_ptr,
-                                nbytes, offset_host, offset_device)
+                                nbytes, offset_host, offset_device, parallel)
         return None
 
     def transfer_device2host(self, device_ptr, host_ptr,
-                             nbytes, offset_device=0, offset_host=0):
+                             nbytes, offset_device=0, offset_host=0,
+                             parallel=False):
         """Transfer data from a device memory location (identified by its
            fake pointer) to a host memory region identified by its raw pointer
            (i.e., a C pointer)on the target device. The operation is executed
@@ -307,6 +535,9 @@ class OffloadStream:
               memory.
            offset_host : int, optional, default 0
               Transfer offset (bytes) to be added to raw host pointer
+           parallel : bool, optional, default False
+              Split a large transfer into chunks across internal streams;
+              the transfer is still ordered with respect to this stream.
 
            See Also
            --------
@@ -359,10 +590,11 @@ class OffloadStream:
         debug(1, '(device {0} -> host) transferring {1} bytes '
                  '(device ptr {2}, host ptr 0x{3:x})',
                  self._device_id, nbytes, device_ptr, host_ptr)
+        self._use(device_ptr)
         device_ptr = device_ptr._device_ptr
         pymic_stream_memcpy_d2h(self._device_id, self._stream_id,
                                 device_ptr, host_ptr,
-                                nbytes, offset_device, offset_host)
+                                nbytes, offset_device, offset_host, parallel)
         return None
 
     def transfer_device2device(self, device_ptr_src, device_ptr_dst,
@@ -446,8 +678,11 @@ class OffloadStream:
         if nbytes <= 0:
             raise ValueError('Invalid byte count: {0}'.format(nbytes))
 
-        device_ptr_src = device_ptr_src._device_ptr
-        device_ptr_dst = device_ptr_dst._device_ptr
+        self._use(device_ptr_src)
+        self._use(device_ptr_dst)
+        with self._device._residency.hold():
+            device_ptr_src = device_ptr_src._device_ptr
+            device_ptr_dst = device_ptr_dst._device_ptr
         debug(1, '(device {0} -> device {0}) transferring {1} bytes '
                  '(source ptr {2}, destination ptr {3})',
                  self._device_id, nbytes, device_ptr_src, device_ptr_dst)
@@ -517,6 +752,10 @@ class OffloadStream:
            been loaded by calling the load_library of the target device
            before invoke.
 
+           A kernel that has been prepared for its argument kinds
+           (OffloadKernel.prepare) only takes OffloadArrays (or None) and
+           scalars, and each invoke only passes the pointers and values.
+
            The additional arguments of invoke can be either instances
            of OffloadArray, numpy.ndarray, or scalar data.  For numpy.ndarray
            or scalar arguments, invoke automatically performs copy-in and
@@ -527,9 +766,13 @@ class OffloadStream:
            All operations (copy in/copy out and invocation) are enqueued into
            the stream object and complete asynchronously.
 
+           The shape and data type of an array argument are passed along
+           with its device pointer; the kernel queries them with the
+           accessors of pymic_kernel.h (PYMIC_NDIM, PYMIC_SHAPE, etc.).
+
            Parameters
            ----------
-           kernel : kernel
+           kernel : kernel or PreparedKernel
               Kernel to be invoked
            args : OffloadArray, numpy.ndarray, or scalar type
               Arguments to be passed to the kernel function
@@ -554,11 +797,13 @@ class OffloadStream:
             if type(args[0]) == tuple:
                 args = args[0]
 
-        # throw an exception if the number of kernel arguments is more than
-        # 16 (that's a limitation of libxstream at the moment)
-        if len(args) > 16:
-            raise ValueError("Kernels with more than 16 arguments "
-                             "are not supported")
+        # a prepared kernel only patches the arguments of its frozen signature
+        if isinstance(kernel, PreparedKernel):
+            if kernel._device is not self._device:
+                raise OffloadError("Cannot invoke kernel, "
+                                   "library not loaded on device")
+            kernel._invoke(self, args)
+            return None
 
         # safety check: avoid invoking a kernel if it's library has been loaded
         # on a different device
@@ -566,70 +811,92 @@ class OffloadStream:
             raise OffloadError("Cannot invoke kernel, "
                                "library not loaded on device")
 
+        # reject the invoke before any buffer is allocated
+        if self._capturing and any(isinstance(a, numpy.ndarray)
+                                   for a in args):
+            raise OffloadError("Cannot capture a kernel with copy-in/copy-out "
+                               "arguments, use OffloadArrays instead")
+        for i, a in enumerate(args):
+            if (isinstance(a, numpy.ndarray) and
+                    not (a.flags.c_contiguous or a.flags.f_contiguous)):
+                raise ValueError("Argument {0} of kernel '{1}' is "
+                                 "not contiguous, use numpy."
+                                 "ascontiguousarray".format(i, kernel[0]))
+
         # determine the types of the arguments (scalar vs arrays);
         # we store the device pointers as 64-bit integers in an ndarray
         arg_dims = numpy.empty((len(args),), dtype=numpy.int64)
         arg_type = numpy.empty((len(args),), dtype=numpy.int64)
         arg_ptrs = numpy.empty((len(args),), dtype=numpy.int64)
         arg_size = numpy.empty((len(args),), dtype=numpy.int64)
+        arg_shape = numpy.zeros((len(args), max_ndims), dtype=numpy.int64)
         copy_in_out = []
         scalars = []
-        for i, a in enumerate(args):
-            if a is None:
-                # this is a None object, so we pass a nullptr to kernel
-                arg_dims[i] = 1
-                arg_type[i] = -1    # magic number to mark nullptrs
-                arg_ptrs[i] = 0     # nullptr
-                arg_size[i] = 0
-                debug(3,
-                      "(device {0}, stream 0x{1:x}) kernel '{2}' "
-                      "arg {3} is None (device pointer 'nullptr')"
-                      "".format(self._device_id, self._stream_id,
-                                kernel[0], i))
-            elif isinstance(a, pymic.OffloadArray):
-                # get the device pointer of the OffloadArray and
-                # pass it to the kernel
-                arg_dims[i] = 1
-                arg_type[i] = map_data_types(a.dtype)
-                arg_ptrs[i] = a._device_ptr._device_ptr  # fake pointer
-                arg_size[i] = a._nbytes
-                debug(3,
-                      "(device {0}, stream 0x{1:x}) kernel '{2}' "
-                      "arg {3} is offload array (device pointer "
-                      "{4})".format(self._device_id, self._stream_id,
-                                    kernel[0], i, a._device_ptr))
-            elif isinstance(a, numpy.ndarray):
-                # allocate device buffer on the target of the invoke
-                # and mark the numpy.ndarray for copyin/copyout semantics
-                host_ptr = a.ctypes.data  # raw C pointer to host data
-                nbytes = a.dtype.itemsize * a.size
-                dev_ptr = self.allocate_device_memory(nbytes)
-                copy_in_out.append((host_ptr, dev_ptr, nbytes, a))
-                arg_dims[i] = 1
-                arg_type[i] = map_data_types(a.dtype)
-                arg_ptrs[i] = dev_ptr._device_ptr    # fake pointer
-                arg_size[i] = nbytes
-                debug(3,
-                      "(device {0}, stream 0x{1:x}) kernel '{2}' "
-                      "arg {3} is copy-in/-out array (host pointer {4}, "
-                      "device pointer "
-                      "{5})".format(self._device_id, self._stream_id,
-                                    kernel[0], i, host_ptr, dev_ptr))
-            else:
-                # this is a hack, but let's wrap scalars as numpy arrays
-                cvtd = numpy.asarray(a)
-                host_ptr = cvtd.ctypes.data  # raw C pointer to host data
-                nbytes = cvtd.dtype.itemsize * cvtd.size
-                scalars.append(cvtd)
-                arg_dims[i] = 0
-                arg_type[i] = map_data_types(cvtd.dtype)
-                arg_ptrs[i] = host_ptr
-                arg_size[i] = nbytes
-                debug(3,
-                      "(device {0}, stream 0x{1:x}) kernel '{2}' "
-                      "arg {3} is scalar {4} (host pointer "
-                      "{5})".format(self._device_id, self._stream_id,
-                                    kernel[0], i, a, host_ptr))
+        # the arrays of the kernel remain resident while the arguments
+        # are collected (copy-in buffers may evict other arrays)
+        with self._device._residency.hold():
+            for i, a in enumerate(args):
+                if a is None:
+                    # this is a None object, so we pass a nullptr to kernel
+                    arg_dims[i] = 1
+                    arg_type[i] = -1    # magic number to mark nullptrs
+                    arg_ptrs[i] = 0     # nullptr
+                    arg_size[i] = 0
+                    debug(3,
+                          "(device {0}, stream 0x{1:x}) kernel '{2}' "
+                          "arg {3} is None (device pointer 'nullptr')"
+                          "".format(self._device_id, self._stream_id,
+                                    kernel[0], i))
+                elif isinstance(a, pymic.OffloadArray):
+                    # get the device pointer of the OffloadArray and
+                    # pass it to the kernel along with its layout
+                    arg_dims[i], arg_type[i] = array_layout(a.shape, a.order,
+                                                            a.dtype, a._nbytes,
+                                                            arg_shape[i])
+                    arg_ptrs[i] = a._device_ptr._device_ptr  # fake pointer
+                    arg_size[i] = a._nbytes
+                    self._use(a._device_ptr)
+                    debug(3,
+                          "(device {0}, stream 0x{1:x}) kernel '{2}' "
+                          "arg {3} is offload array (device pointer "
+                          "{4})".format(self._device_id, self._stream_id,
+                                        kernel[0], i, a._device_ptr))
+                elif isinstance(a, numpy.ndarray):
+                    # the buffer is copied as one block of memory, and the
+                    # kernel sees a dense layout (as for bind)
+                    order = 'C' if a.flags.c_contiguous else 'F'
+                    # allocate device buffer on the target of the invoke
+                    # and mark the numpy.ndarray for copyin/copyout semantics
+                    host_ptr = a.ctypes.data  # raw C pointer to host data
+                    nbytes = a.dtype.itemsize * a.size
+                    dev_ptr = self.allocate_device_memory(nbytes)
+                    copy_in_out.append((host_ptr, dev_ptr, nbytes, a))
+                    arg_dims[i], arg_type[i] = array_layout(a.shape, order,
+                                                            a.dtype, nbytes,
+                                                            arg_shape[i])
+                    arg_ptrs[i] = dev_ptr._device_ptr    # fake pointer
+                    arg_size[i] = nbytes
+                    debug(3,
+                          "(device {0}, stream 0x{1:x}) kernel '{2}' "
+                          "arg {3} is copy-in/-out array (host pointer {4}, "
+                          "device pointer "
+                          "{5})".format(self._device_id, self._stream_id,
+                                        kernel[0], i, host_ptr, dev_ptr))
+                else:
+                    # this is a hack, but let's wrap scalars as numpy arrays
+                    cvtd = numpy.asarray(a)
+                    host_ptr = cvtd.ctypes.data  # raw C pointer to host data
+                    nbytes = cvtd.dtype.itemsize * cvtd.size
+                    scalars.append(cvtd)
+                    arg_dims[i] = 0
+                    arg_type[i] = map_data_types(cvtd.dtype)
+                    arg_ptrs[i] = host_ptr
+                    arg_size[i] = nbytes
+                    debug(3,
+                          "(device {0}, stream 0x{1:x}) kernel '{2}' "
+                          "arg {3} is scalar {4} (host pointer "
+                          "{5})".format(self._device_id, self._stream_id,
+                                        kernel[0], i, a, host_ptr))
         debug(1, "(device {0}, stream 0x{1:x}) invoking kernel '{2}' "
                  "(pointer 0x{3:x}) with {4} "
                  "argument(s) ({5} copy-in/copy-out, {6} scalars)",
@@ -640,7 +907,7 @@ class OffloadStream:
             self.transfer_host2device(c[0], c[1], c[2])
         pymic_stream_invoke_kernel(self._device_id, self._stream_id, kernel[1],
                                    len(args), arg_dims, arg_type, arg_ptrs,
-                                   arg_size)
+                                   arg_size, arg_shape)
         # iterate over the copyout arguments, transfer them back
         for c in copy_in_out:
             self.transfer_device2host(c[1], c[0], c[2])
@@ -704,6 +971,7 @@ class OffloadStream:
 
         # allocate the buffer on the device (and update data)
         bound._device_ptr = self.allocate_device_memory(bound._nbytes)
+        self._device._residency.track(bound._device_ptr, bound._nbytes)
         if update_device:
             bound.update_device()
 
@@ -141,10 +141,11 @@ print('done with customizations')
 # define the source of LIBXSTREAM and the pyMIC offload engine
 libxstream_src = map(lambda x: 'src/libxstream/src/' + x,
                      ['libxstream.cpp', 'libxstream_alloc.cpp',
-                      'libxstream_argument.cpp', 'libxstream_context.cpp',
-                      'libxstream_event.cpp', 'libxstream_offload.cpp',
-                      'libxstream_stream.cpp', 'libxstream_workitem.cpp',
-                      'libxstream_workqueue.cpp'])
+                      'libxstream_argument.cpp', 'libxstream_cache.cpp',
+                      'libxstream_context.cpp',
+                      'libxstream_event.cpp', 'libxstream_graph.cpp',
+                      'libxstream_offload.cpp', 'libxstream_stream.cpp',
+                      'libxstream_workitem.cpp', 'libxstream_workqueue.cpp'])
 sources = ['src/pymic_libxstream.pyx', 'src/pymic_internal.cc',
            'src/pymicimpl_misc.cc']
 sources.extend(libxstream_src)
@@ -51,6 +51,10 @@ typedef int libxstream_bool;
 LIBXSTREAM_EXPORT_C typedef struct libxstream_stream libxstream_stream;
 /** Event type. */
 LIBXSTREAM_EXPORT_C typedef struct libxstream_event libxstream_event;
+/** Graph type (captured work of a stream). */
+LIBXSTREAM_EXPORT_C typedef struct libxstream_graph libxstream_graph;
+/** Plan type (function call with a frozen signature). */
+LIBXSTREAM_EXPORT_C typedef struct libxstream_plan libxstream_plan;
 /** Enumeration of elemental "scalar" types. */
 LIBXSTREAM_EXPORT_C typedef enum libxstream_type {
   /** special types: BOOL, BYTE, CHAR, VOID */
@@ -78,15 +82,55 @@ LIBXSTREAM_EXPORT_C typedef enum libxstream_type {
 LIBXSTREAM_EXPORT_C typedef enum libxstream_call_flags {
   LIBXSTREAM_CALL_WAIT    = 1 /* synchronous function call */,
   LIBXSTREAM_CALL_NATIVE  = 2 /* native host/MIC function */,
+  LIBXSTREAM_CALL_PACKED  = 4 /* function receives the signature (argument block) as its only argument */,
   /** terminates the list */
   LIBXSTREAM_CALL_INVALID,
   /** collection of any valid flags from above */
   LIBXSTREAM_CALL_DEFAULT = 0
 } libxstream_call_flags;
+/** Policy of waiting for pending work e.g., libxstream_stream_wait, libxstream_event_wait, or a synchronous call. */
+LIBXSTREAM_EXPORT_C typedef enum libxstream_wait_policy {
+  /** policy of the process (stream), or LIBXSTREAM_WAIT_POLICY (process) */
+  LIBXSTREAM_WAIT_DEFAULT,
+  /** yield until the work is completed (lowest latency, occupies a core) */
+  LIBXSTREAM_WAIT_SPIN,
+  /** yield for a short period (LIBXSTREAM_WAIT_NSPIN), and block afterwards */
+  LIBXSTREAM_WAIT_ADAPTIVE,
+  /** block until the completion of the work wakes up the thread */
+  LIBXSTREAM_WAIT_BLOCK
+} libxstream_wait_policy;
+/** Policy of allocating host memory (flags can be combined); see libxstream_mem_set_policy. */
+LIBXSTREAM_EXPORT_C typedef enum libxstream_mem_policy {
+  /** aligned heap allocation */
+  LIBXSTREAM_MEM_DEFAULT  = 0,
+  /** transparent huge pages (madvise) */
+  LIBXSTREAM_MEM_HUGEPAGE = 1,
+  /** explicit huge pages (MAP_HUGETLB) if reserved by the system, transparent huge pages otherwise */
+  LIBXSTREAM_MEM_HUGETLB  = 2,
+  /** touch the pages when allocating (page faults are not part of the first use, first-touch placement) */
+  LIBXSTREAM_MEM_PREFAULT = 4
+} libxstream_mem_policy;
+/** Statistics of the memory allocated on a device (libxstream_mem_stats). */
+LIBXSTREAM_EXPORT_C typedef struct libxstream_mem_statistics {
+  /** number of bytes allocated but not deallocated (live), and the maximum of the live bytes (high-water mark) */
+  size_t live, peak;
+  /** number of live allocations, and the number of allocations so far */
+  size_t nlive, nallocs;
+  /** number of bytes acquired from the system, and the portion which is cached (not allocated) */
+  size_t acquired, cached;
+  /** number of regions (segments) acquired from the system */
+  size_t nsegments;
+  /** number of distinct tags (libxstream_mem_tag_stats) */
+  size_t ntags;
+  /** number of live allocations by size: bin 0 up to 64 Byte, bin i up to 2^(i+6) Byte, the last bin is unbounded */
+  size_t histogram[LIBXSTREAM_MEM_NBINS];
+} libxstream_mem_statistics;
 /** Function argument type. */
 LIBXSTREAM_EXPORT_C typedef struct LIBXSTREAM_TARGET(mic) libxstream_argument libxstream_argument;
 /** Function type of an offloadable function. */
 typedef void (/*LIBXSTREAM_CDECL*/*libxstream_function)(LIBXSTREAM_VARIADIC);
+/** Host function which is called once the work of a stream enqueued prior to the callback is completed. */
+typedef void (/*LIBXSTREAM_CDECL*/*libxstream_callback)(libxstream_stream* stream, void* userdata);
 
 /** Query the number of available devices. */
 LIBXSTREAM_EXPORT_C int libxstream_get_ndevices(size_t* ndevices);
@@ -95,12 +139,39 @@ LIBXSTREAM_EXPORT_C int libxstream_get_active_device(int* device);
 /** Set the active device for this thread. */
 LIBXSTREAM_EXPORT_C int libxstream_set_active_device(int device);
 
+/** Query the policy of waiting (process-wide); initially LIBXSTREAM_WAIT_POLICY or LIBXSTREAM_WAIT environment variable (spin, adaptive, block). */
+LIBXSTREAM_EXPORT_C int libxstream_get_wait_policy(libxstream_wait_policy* policy);
+/** Set the policy of waiting (process-wide); LIBXSTREAM_WAIT_DEFAULT restores the initial policy. */
+LIBXSTREAM_EXPORT_C int libxstream_set_wait_policy(libxstream_wait_policy policy);
+
 /** Query the memory metrics of the device (valid to pass one NULL pointer). */
 LIBXSTREAM_EXPORT_C int libxstream_mem_info(int device, size_t* allocatable, size_t* physical);
 /** Allocate aligned memory (0: automatic alignment) on the device (-1: host, 0<: coprocessor). */
 LIBXSTREAM_EXPORT_C int libxstream_mem_allocate(int device, void** memory, size_t size, size_t alignment);
-/** Deallocate memory; shall match the device where the memory was allocated. */
+/** Query the device (-1: host) where the memory was allocated; any address inside of an allocation is valid. */
+LIBXSTREAM_EXPORT_C int libxstream_mem_device(const void* memory, int* device);
+/** Deallocate memory; shall match the device where the memory was allocated. The memory remains cached for subsequent allocations. */
 LIBXSTREAM_EXPORT_C int libxstream_mem_deallocate(int device, const void* memory);
+/** Deallocate memory once the work enqueued into the stream so far is completed; does not block (NULL-stream: libxstream_mem_deallocate). */
+LIBXSTREAM_EXPORT_C int libxstream_mem_deallocate_async(int device, const void* memory, libxstream_stream* stream);
+/** Release the cached memory of the device to the system (otherwise only released under memory pressure); size (optional) receives the number of bytes released. */
+LIBXSTREAM_EXPORT_C int libxstream_mem_trim(int device, size_t* size);
+/** Query the statistics of the memory cache of the device (valid to pass NULL pointers): allocations served by the cache (hits) or not (misses), and the number of bytes cached. */
+LIBXSTREAM_EXPORT_C int libxstream_mem_cache_info(int device, size_t* hits, size_t* misses, size_t* cached);
+/** Query the statistics of the memory allocated on the device (-1: host); requires LIBXSTREAM_MEM_CACHE (otherwise all zero). */
+LIBXSTREAM_EXPORT_C int libxstream_mem_stats(int device, libxstream_mem_statistics* stats);
+/** Attach a tag (e.g., the call site) to an allocation such that the live memory can be accounted per tag (NULL: detach). */
+LIBXSTREAM_EXPORT_C int libxstream_mem_set_tag(int device, const void* memory, const char* tag);
+/** Query the live bytes and allocations of the i-th tag (i < ntags); the tag (string) remains valid. */
+LIBXSTREAM_EXPORT_C int libxstream_mem_tag_stats(int device, size_t i, const char** tag, size_t* live, size_t* nlive);
+/** Query the policy of allocating host memory (flags of libxstream_mem_policy), and the NUMA node (-1: none). */
+LIBXSTREAM_EXPORT_C int libxstream_mem_get_policy(int* policy, int* node);
+/**
+ * Set the policy of allocating host memory (flags of libxstream_mem_policy), and bind the memory to a NUMA node
+ * (-1: placed by the thread touching a page first). The policy applies to host memory allocated afterwards i.e.,
+ * the cached host memory is trimmed. The policy is ignored if the system does not support it (e.g., Windows).
+ */
+LIBXSTREAM_EXPORT_C int libxstream_mem_set_policy(int policy, int node);
 /** Fill memory with zeros; allocated memory can carry an offset. */
 LIBXSTREAM_EXPORT_C int libxstream_memset_zero(void* memory, size_t size, libxstream_stream* stream);
 /** Copy memory from the host to the device; addresses can carry an offset. */
@@ -109,23 +180,62 @@ LIBXSTREAM_EXPORT_C int libxstream_memcpy_h2d(const void* host_mem, void* dev_me
 LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2h(const void* dev_mem, void* host_mem, size_t size, libxstream_stream* stream);
 /** Copy memory from device to device; cross-device copies are allowed as well. */
 LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2d(const void* src, void* dst, size_t size, libxstream_stream* stream);
+/**
+ * Copy memory from the host to the device in chunks (0: LIBXSTREAM_STRIPE_CHUNK) which are spread across up to
+ * nstreams internal streams of the given stream (0 or at most: LIBXSTREAM_STRIPE_NSTREAMS). The copy is ordered
+ * like libxstream_memcpy_h2d i.e., it starts after the work enqueued into the stream so far, and the work enqueued
+ * afterwards waits for all chunks. A small copy, a NULL-stream, or a stream which is capturing is not split.
+ * The chunks of a host stream are transferred concurrently only if there is more than one worker.
+ */
+LIBXSTREAM_EXPORT_C int libxstream_memcpy_h2d_striped(const void* host_mem, void* dev_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream);
+/** Copy memory from the device to the host in chunks across internal streams (see libxstream_memcpy_h2d_striped). */
+LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2h_striped(const void* dev_mem, void* host_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream);
 
 /** Query the range of valid priorities (inclusive bounds). */
 LIBXSTREAM_EXPORT_C int libxstream_stream_priority_range(int* least, int* greatest);
-/** Create a stream on a given device. */
+/** Query the priority a stream is created with unless there is a reason to prefer or defer it (middle of the range). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_priority_default(int* priority);
+/** Create a stream on a given device; a smaller priority value is served first (priority is clamped to the range). */
 LIBXSTREAM_EXPORT_C int libxstream_stream_create(libxstream_stream** stream, int device, int priority, const char* name);
 /** Destroy a stream; pending work must be completed if results are needed. */
 LIBXSTREAM_EXPORT_C int libxstream_stream_destroy(const libxstream_stream* stream);
+/** Query the policy of waiting for the work of the stream (LIBXSTREAM_WAIT_DEFAULT: process-wide policy applies). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_wait_policy(const libxstream_stream* stream, libxstream_wait_policy* policy);
+/** Set the policy of waiting for the work of the stream (LIBXSTREAM_WAIT_DEFAULT: process-wide policy applies). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_set_wait_policy(libxstream_stream* stream, libxstream_wait_policy policy);
 /** Wait for pending work (blocking); NULL to synchronize all streams. */
 LIBXSTREAM_EXPORT_C int libxstream_stream_wait(libxstream_stream* stream);
 /** Wait for an event inside of the specified stream; a NULL-stream designates all streams. */
 LIBXSTREAM_EXPORT_C int libxstream_stream_wait_event(libxstream_stream* stream, const libxstream_event* event);
+/** Call a host function (worker thread) in stream order i.e., once the work enqueued so far is completed; the callback must not wait for the stream. */
+LIBXSTREAM_EXPORT_C int libxstream_stream_add_callback(libxstream_stream* stream, libxstream_callback callback, void* userdata);
 /** Query the device the given stream is constructed for. */
 LIBXSTREAM_EXPORT_C int libxstream_stream_device(const libxstream_stream* stream, int* device);
+/** Query the number of internal streams which carried the chunks of the striped copies enqueued into the stream so far. */
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_nstripes(const libxstream_stream* stream, size_t* nstripes);
+/** Query the number of workers executing the work of the streams (LIBXSTREAM_NWORKERS environment variable). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_nworkers(size_t* nworkers);
+/** Set the number of workers; streams execute concurrently, but the number can only grow once the workers are running. */
+LIBXSTREAM_EXPORT_C int libxstream_stream_set_nworkers(size_t nworkers);
+/** Wait for pending work, and record subsequent work into a graph rather than executing it (no synchronous calls, events, or waits). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_begin_capture(libxstream_stream* stream);
+/** Stop recording, and receive the captured graph; the graph is owned by the caller (libxstream_graph_destroy). */
+LIBXSTREAM_EXPORT_C int libxstream_stream_end_capture(libxstream_stream* stream, libxstream_graph** graph);
+
+/** Destroy a graph; launches of the graph which are still in flight are not affected. */
+LIBXSTREAM_EXPORT_C int libxstream_graph_destroy(const libxstream_graph* graph);
+/** Query the number of captured operations (nodes). */
+LIBXSTREAM_EXPORT_C int libxstream_graph_size(const libxstream_graph* graph, size_t* size);
+/** Replace an argument of a node; a call takes the value as libxstream_fn_input does, other operations take the pointer itself. */
+LIBXSTREAM_EXPORT_C int libxstream_graph_set_arg(libxstream_graph* graph, size_t node, size_t arg, const void* value);
+/** Enqueue all operations of the graph at once; a launch replays the arguments as of enqueuing it i.e., launches can overlap, and patching or destroying the graph afterwards does not affect it. */
+LIBXSTREAM_EXPORT_C int libxstream_graph_launch(libxstream_graph* graph, libxstream_stream* stream);
 
 /** Create an event; event can be recorded multiple times. */
 LIBXSTREAM_EXPORT_C int libxstream_event_create(libxstream_event** event);
-/** Destroy an event; does not implicitly wait for the event to complete. */
+/** Create an event which additionally takes the time at which the work prior to recording the event completed. */
+LIBXSTREAM_EXPORT_C int libxstream_event_create_timed(libxstream_event** event);
+/** Destroy an event; does not implicitly wait for the event to complete (unless the event is timed). */
 LIBXSTREAM_EXPORT_C int libxstream_event_destroy(const libxstream_event* event);
 /** Record an event; an event can be re-recorded multiple times. */
 LIBXSTREAM_EXPORT_C int libxstream_event_record(libxstream_event* event, libxstream_stream* stream);
@@ -133,9 +243,15 @@ LIBXSTREAM_EXPORT_C int libxstream_event_record(libxstream_event* event, libxstr
 LIBXSTREAM_EXPORT_C int libxstream_event_query(const libxstream_event* event, libxstream_bool* occurred);
 /** Wait for the event i.e., waiting for work queued prior to recording the event. */
 LIBXSTREAM_EXPORT_C int libxstream_event_wait(libxstream_event* event);
+/** Time in milliseconds between two timed events; both events must have occurred (LIBXSTREAM_ERROR_CONDITION otherwise). */
+LIBXSTREAM_EXPORT_C int libxstream_event_elapsed(const libxstream_event* start, const libxstream_event* end, double* ms);
 
 /** Receive thread-local signature with capacity of LIBXSTREAM_MAX_NARGS. */
 LIBXSTREAM_EXPORT_C int libxstream_fn_signature(libxstream_argument** signature);
+/** Create a signature with the given capacity; a signature with more than LIBXSTREAM_MAX_NARGS arguments requires LIBXSTREAM_CALL_PACKED. */
+LIBXSTREAM_EXPORT_C int libxstream_fn_create_signature(libxstream_argument** signature, size_t nargs);
+/** Destroy a signature created by libxstream_fn_create_signature; calls which are already enqueued are not affected. */
+LIBXSTREAM_EXPORT_C int libxstream_fn_destroy_signature(const libxstream_argument* signature);
 /** Reset function signature to start over with less arguments (arity). */
 LIBXSTREAM_EXPORT_C int libxstream_fn_clear_signature(libxstream_argument* signature);
 /** Construct an input argument from device data, dimensionality, and shape. */
@@ -146,8 +262,16 @@ LIBXSTREAM_EXPORT_C int libxstream_fn_output(libxstream_argument* signature, siz
 LIBXSTREAM_EXPORT_C int libxstream_fn_inout(libxstream_argument* signature, size_t arg, void* inout, libxstream_type type, size_t dims, const size_t shape[]);
 /** Query the capacity of the function signature (maximum possible arity). */
 LIBXSTREAM_EXPORT_C int libxstream_fn_nargs(const libxstream_argument* signature, size_t* nargs);
-/** Call a user function along with the signature. */
+/** Call a user function along with the signature; the arguments are passed by position (up to LIBXSTREAM_MAX_NARGS), or as a block (LIBXSTREAM_CALL_PACKED). In a packed call, an elemental output must be among the first LIBXSTREAM_MAX_NARGS arrays and elemental outputs (LIBXSTREAM_ERROR_CONDITION otherwise). */
 LIBXSTREAM_EXPORT_C int libxstream_fn_call(libxstream_function function, const libxstream_argument* signature, libxstream_stream* stream, int flags);
+/** Freeze a call of the function with a copy of the signature; the plan is owned by the caller (libxstream_plan_destroy). */
+LIBXSTREAM_EXPORT_C int libxstream_fn_plan(libxstream_plan** plan, libxstream_function function, const libxstream_argument* signature, int flags);
+/** Destroy a plan; calls which are already enqueued are not affected. */
+LIBXSTREAM_EXPORT_C int libxstream_plan_destroy(const libxstream_plan* plan);
+/** Replace the value of an argument as libxstream_fn_input does i.e., an elemental input is copied, otherwise the pointer is taken. */
+LIBXSTREAM_EXPORT_C int libxstream_plan_set_arg(libxstream_plan* plan, size_t arg, const void* value);
+/** Enqueue the planned call; the arguments can be patched again right after (the call takes a copy). */
+LIBXSTREAM_EXPORT_C int libxstream_plan_call(const libxstream_plan* plan, libxstream_stream* stream);
 
 /** Query the size of the elemental type (Byte). */
 LIBXSTREAM_EXPORT_C LIBXSTREAM_TARGET(mic) int libxstream_get_typesize(libxstream_type type, size_t* typesize);
@@ -77,13 +77,37 @@
 /** SIMD width in Byte (actual alignment might be smaller). */
 #define LIBXSTREAM_MAX_SIMD 64
 
+/** Size of a cache line in Byte (POT). */
+#define LIBXSTREAM_CACHELINE 64
+
 /** Alignment in Byte (actual alignment might be smaller). */
 #define LIBXSTREAM_MAX_ALIGN (2 * 1024 * 1024)
 
+/** Caches the memory of libxstream_mem_allocate per device (see libxstream_mem_trim). */
+#define LIBXSTREAM_MEM_CACHE
+
+/** Allocations up to this size (Byte) are carved out of a shared region (LIBXSTREAM_MEM_SLAB) rather than acquiring a region each. */
+#define LIBXSTREAM_MEM_SMALL (64 * 1024)
+
+/** Size of a region (Byte) which is acquired for small allocations (LIBXSTREAM_MEM_SMALL). */
+#define LIBXSTREAM_MEM_SLAB (2 * 1024 * 1024)
+
+/** Number of bins of the size histogram of the memory statistics (libxstream_mem_stats). */
+#define LIBXSTREAM_MEM_NBINS 24
+
+/** Amount of memory (Byte) per device which can be pending in stream-ordered deallocations before the caller waits. */
+#define LIBXSTREAM_MEM_DEFERRED (16 * 1024 * 1024)
+
+/** Maximum number of internal streams per device which carry the stripes of a copy (libxstream_memcpy_h2d_striped). */
+#define LIBXSTREAM_STRIPE_NSTREAMS 4
+
+/** Size of a stripe (Byte) of a copy by default; a copy of less than two stripes is not split. */
+#define LIBXSTREAM_STRIPE_CHUNK (4 * 1024 * 1024)
+
 /** Maximum number of devices (POT). */
 #define LIBXSTREAM_MAX_NDEVICES 4
 
-/** Maximum number of streams per device (POT). */
+/** Initial capacity for the streams per device (POT); the number of streams is not limited. */
 #define LIBXSTREAM_MAX_NSTREAMS 32
 
 /** Maximum dimensionality of arrays. */
@@ -92,8 +116,32 @@
 /** Maximum number of arguments in offload structure. */
 #define LIBXSTREAM_MAX_NARGS 16
 
-/** Maximum number of executions in the queue (POT). */
-#define LIBXSTREAM_MAX_QSIZE 2048
+/** Initial number of segments a queue can refer to; the directory of segments grows on demand (POT). */
+#define LIBXSTREAM_QDIRECTORY 4
+
+/** Number of queue entries allocated at once (POT). */
+#define LIBXSTREAM_QSEGMENT 128
+
+/** Size of the in-place storage of a queue entry (work item and arguments) in Byte. */
+#define LIBXSTREAM_WORKITEM_STORAGE 512
+
+/** Number of workers executing the work of the streams (default); see LIBXSTREAM_NWORKERS environment variable. */
+#define LIBXSTREAM_NWORKERS 1
+
+/** Executes a synchronous call (LIBXSTREAM_CALL_WAIT) on the calling thread if the stream is idle. */
+#define LIBXSTREAM_SYNC_INLINE
+
+/** Number of times an idle worker yields before it blocks (waiting for work). */
+#define LIBXSTREAM_WORKER_SPIN 64
+
+/** Number of stream priorities (0: greatest priority, NPRIORITIES/2: default) unless streams are mapped to compiler streams. */
+#define LIBXSTREAM_NPRIORITIES 8
+
+/** Number of dispatches a listed stream waits at most per priority level before it is preferred (aging). */
+#define LIBXSTREAM_PRIORITY_AGING 16
+
+/** Maximum number of workers executing the work of the streams. */
+#define LIBXSTREAM_MAX_NWORKERS 64
 
 /** Maximum number of host threads. */
 #define LIBXSTREAM_MAX_NTHREADS 512
@@ -101,6 +149,9 @@
 /** Maximum number of locks (POT). */
 #define LIBXSTREAM_MAX_NLOCKS 16
 
+/** Number of times a contended lock is polled before the thread blocks. */
+#define LIBXSTREAM_LOCK_NSPIN 256
+
 /**
  * Number of CPU cycles to actively wait. A positive value translates to cpu cycles
  * whereas a negative value translates into milliseconds. A value of zero designates
@@ -117,8 +168,11 @@
  */
 #define LIBXSTREAM_SLEEP_MS 20
 
-/** Allows client-side to sleep when waiting. */
-#define LIBXSTREAM_SLEEP_CLIENT
+/** Policy of waiting for pending work (libxstream_wait_policy); see LIBXSTREAM_WAIT environment variable. */
+#define LIBXSTREAM_WAIT_POLICY LIBXSTREAM_WAIT_ADAPTIVE
+
+/** Number of times a waiting thread yields before it blocks (LIBXSTREAM_WAIT_ADAPTIVE). */
+#define LIBXSTREAM_WAIT_NSPIN 1024
 
 /** Prefers OpenMP based locking primitives. */
 /*#define LIBXSTREAM_PREFER_OPENMP*/
@@ -51,7 +51,9 @@
  * parallelism. The program is intentionally spartan (command line interface, etc.)
  * in order to keep it within bounds for an introductory code sample. The mechanism
  * selecting the stream to enqueue into as well as selecting the stream to be
- * synchronized shows the essence of the stream programing model.
+ * synchronized shows the essence of the stream programing model. Finally, a single
+ * large copy is split into chunks across internal streams (striped copy), and the
+ * bandwidth is reported depending on the chunk size and the number of streams.
  */
 int main(int argc, char* argv[])
 {
@@ -166,6 +168,33 @@ int main(int argc, char* argv[])
 #endif
     }
 
+#if defined(_OPENMP)
+    size_t nworkers = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_get_nworkers(&nworkers));
+    fprintf(stdout, "\nStriped %s of %lu Byte (%lu workers):\n", copyin ? "copy-in" : "copy-out",
+      static_cast<unsigned long>(maxsize), static_cast<unsigned long>(nworkers));
+    const int nstriped = static_cast<int>(std::max<size_t>(std::min<size_t>(minrepeat, (1u << 30) / maxsize), 1));
+    for (size_t chunk = std::min<size_t>(256 * 1024, maxsize); chunk <= maxsize; chunk <<= 2) {
+      for (size_t nstripes = 1; nstripes <= (LIBXSTREAM_STRIPE_NSTREAMS); nstripes <<= 1) {
+        const double start = omp_get_wtime();
+        for (int i = 0; i < nstriped; ++i) {
+          if (copyin) {
+            LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d_striped(copy[0].mem_hst, copy[0].mem_dev, maxsize, chunk, nstripes, copy[0].stream));
+          }
+          else { // copy-out
+            LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h_striped(copy[0].mem_dev, copy[0].mem_hst, maxsize, chunk, nstripes, copy[0].stream));
+          }
+        }
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(copy[0].stream));
+        const double iduration = omp_get_wtime() - start;
+        if (0 < iduration) {
+          fprintf(stdout, "%lu stream(s) x %lu Byte chunks: %.1f MB/s\n", static_cast<unsigned long>(nstripes), static_cast<unsigned long>(chunk),
+            (1.0 * maxsize * nstriped) / ((1ul << 20) * iduration));
+        }
+      }
+    }
+#endif
+
     if (copyin) {
       LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1/*host*/, copy[0].mem_hst));
       for (size_t i = 0; i < nstreams; ++i) {
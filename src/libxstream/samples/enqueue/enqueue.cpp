@@ -0,0 +1,298 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#include <libxstream_begin.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+#include <libxstream_end.h>
+
+
+/** Counts the number of heap allocations (including the allocations made by LIBXSTREAM). */
+static size_t nallocs = 0;
+
+void* operator new(size_t size)
+{
+#if defined(_OPENMP)
+# pragma omp atomic
+#endif
+  ++nallocs;
+  void *const result = std::malloc(std::max<size_t>(size, 1));
+  if (0 == result) throw std::bad_alloc();
+  return result;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) throw() { std::free(pointer); }
+void operator delete[](void* pointer) throw() { std::free(pointer); }
+
+
+LIBXSTREAM_TARGET(mic) void empty_kernel() {}
+
+LIBXSTREAM_TARGET(mic) void args_kernel(const double*, const float*, float*, const size_t*) {}
+
+/* workaround for issue "cannot find address of function"; compile using "make.sh -g" */
+const libxstream_function kernel = reinterpret_cast<libxstream_function>(empty_kernel);
+const libxstream_function args = reinterpret_cast<libxstream_function>(args_kernel);
+
+
+/**
+ * This program measures the enqueue throughput of LIBXSTREAM when multiple producer
+ * threads are submitting work into the same stream at once (worst-case contention
+ * on the work queue). The work itself is empty, and the stream is created for the
+ * host (device -1) such that the cost of enqueuing work is measured rather than the
+ * cost of an offload. The number of producers is doubled for each step (1, 2, 4, ...)
+ * up to the given maximum. The enqueue rate excludes draining the stream whereas the
+ * total rate includes the time needed to execute all items. Upfront, the latency and
+ * the number of heap allocations per enqueue are measured for a single producer,
+ * a call with four arguments is enqueued with a signature constructed per call and
+ * with a prepared plan (libxstream_fn_plan), and a sequence of operations (h2d, three
+ * calls, d2h) is enqueued directly and replayed as a captured graph for comparison.
+ * A pipeline which allocates a temporary buffer per step (h2d, call) measures the cost
+ * of freeing the buffer synchronously versus in stream order (mem_deallocate_async).
+ */
+int main(int argc, char* argv[])
+{
+  try {
+#if defined(_OPENMP)
+    const int maxproducers = std::min(std::max(1 < argc ? std::atoi(argv[1]) : 64, 1), 1024);
+    const int nitems = std::max(2 < argc ? std::atoi(argv[2]) : 100000, 1);
+    const int device = -1; // host
+
+    libxstream_stream* stream = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&stream, device, 0, "enqueue"));
+    libxstream_argument* signature = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_signature(&signature));
+    // warmup (start background thread, etc.)
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_WAIT));
+
+    char buffer[8];
+    for (int kind = 0; kind < 2; ++kind) {
+      const size_t nallocs_start = nallocs;
+      const double start = omp_get_wtime();
+      for (int i = 0; i < nitems; ++i) {
+        if (0 == kind) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+        }
+        else {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(buffer, buffer + 4, 4, stream));
+        }
+      }
+      const double duration = omp_get_wtime() - start;
+      const size_t nallocs_enqueue = nallocs - nallocs_start;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      fprintf(stdout, "%s: %.0f ns/enqueue, %.2f allocations/enqueue\n", 0 == kind ? "fn_call" : "memcpy_h2d",
+        1E9 * duration / nitems, static_cast<double>(nallocs_enqueue) / nitems);
+    }
+
+    const double scale = 0.5;
+    float in[4], out[4];
+    size_t n = 4;
+    libxstream_plan* plan = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 0, &scale, libxstream_map_to<double>::type(), 0, 0));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 1, in, libxstream_map_to<float>::type(), 1, &n));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_output(signature, 2, out, libxstream_map_to<float>::type(), 1, &n));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 3, &n, libxstream_map_to<size_t>::type(), 0, 0));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_plan(&plan, args, signature, LIBXSTREAM_CALL_DEFAULT));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_clear_signature(signature));
+    for (int kind = 0; kind < 2; ++kind) {
+      const double start = omp_get_wtime();
+      for (int i = 0; i < nitems; ++i) {
+        if (0 == kind) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 0, &scale, libxstream_map_to<double>::type(), 0, 0));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 1, in, libxstream_map_to<float>::type(), 1, &n));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_output(signature, 2, out, libxstream_map_to<float>::type(), 1, &n));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 3, &n, libxstream_map_to<size_t>::type(), 0, 0));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(args, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_clear_signature(signature));
+        }
+        else {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_plan_set_arg(plan, 1, in));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_plan_set_arg(plan, 2, out));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_plan_call(plan, stream));
+        }
+      }
+      const double duration = omp_get_wtime() - start;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      fprintf(stdout, "%s: %.0f ns/call\n", 0 == kind ? "fn_input+fn_call" : "plan_call", 1E9 * duration / nitems);
+    }
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_plan_destroy(plan));
+
+    libxstream_graph* graph = 0;
+    for (int kind = 0; kind < 2; ++kind) {
+      if (0 != kind) { // record the sequence once
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_begin_capture(stream));
+      }
+      const double start = omp_get_wtime();
+      for (int i = 0; i < nitems; ++i) {
+        if (0 == kind || 0 == graph) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(buffer, buffer + 4, 4, stream));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h(buffer + 4, buffer, 4, stream));
+          if (0 != kind) {
+            LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_end_capture(stream, &graph));
+          }
+        }
+        if (0 != graph) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_launch(graph, stream));
+        }
+      }
+      const double duration = omp_get_wtime() - start;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      fprintf(stdout, "%s: %.0f ns/sequence\n", 0 == kind ? "sequence" : "graph", 1E9 * duration / nitems);
+    }
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_destroy(graph));
+
+    for (int kind = 0; kind < 2; ++kind) { // temporary buffers of 1 MB
+      size_t hits = 0, misses = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_cache_info(device, &hits, &misses, 0));
+      const size_t nbuffers = std::min(nitems, 10000);
+      const double start = omp_get_wtime();
+      for (size_t i = 0; i < nbuffers; ++i) {
+        void* memory = 0;
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(device, &memory, 1 << 20, 0));
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(device, memory));
+        if (0 != kind) { // release the memory to the system
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_trim(device, 0));
+        }
+      }
+      const double duration = omp_get_wtime() - start;
+      size_t hits_end = 0, misses_end = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_cache_info(device, &hits_end, &misses_end, 0));
+      fprintf(stdout, "%s: %.0f ns/buffer, %lu hits, %lu misses\n", 0 == kind ? "mem_allocate (cached)" : "mem_allocate (trimmed)",
+        1E9 * duration / nbuffers, static_cast<unsigned long>(hits_end - hits), static_cast<unsigned long>(misses_end - misses));
+    }
+
+    { // small buffers (kept alive) are carved out of shared regions
+      const size_t nbuffers = std::min(nitems, 10000);
+      void** buffers = new void*[nbuffers];
+      libxstream_mem_statistics stats, stats_end;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(device, &stats));
+      const double start = omp_get_wtime();
+      for (size_t i = 0; i < nbuffers; ++i) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(device, buffers + i, sizeof(double), 0));
+      }
+      const double duration = omp_get_wtime() - start;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(device, &stats_end));
+      for (size_t i = 0; i < nbuffers; ++i) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(device, buffers[i]));
+      }
+      delete[] buffers;
+      fprintf(stdout, "mem_allocate (small): %.0f ns/buffer, %lu buffers in %lu regions\n", 1E9 * duration / nbuffers,
+        static_cast<unsigned long>(nbuffers), static_cast<unsigned long>(stats_end.nsegments - stats.nsegments));
+    }
+
+    { // pipeline over multiple streams with a temporary buffer per step
+      const size_t tmpsize = 64 << 10, nsteps = std::min(nitems, 10000);
+      libxstream_stream* pipeline[4];
+      const int nstreams = sizeof(pipeline) / sizeof(*pipeline);
+      for (int i = 0; i < nstreams; ++i) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(pipeline + i, device, 0, "pipeline"));
+      }
+      char *const source = new char[tmpsize];
+      std::fill_n(source, tmpsize, 0);
+      for (int kind = 0; kind < 2; ++kind) {
+        const double start = omp_get_wtime();
+        for (size_t i = 0; i < nsteps; ++i) {
+          libxstream_stream *const s = pipeline[i%nstreams];
+          void* memory = 0;
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(device, &memory, tmpsize, 0));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(source, memory, tmpsize, s));
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, s, LIBXSTREAM_CALL_DEFAULT));
+          if (0 == kind) { // synchronizes all streams
+            LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(device, memory));
+          }
+          else {
+            LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate_async(device, memory, s));
+          }
+        }
+        const double enqueue_duration = omp_get_wtime() - start;
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(0));
+        const double total_duration = omp_get_wtime() - start;
+        fprintf(stdout, "%s: %.0f ns/step (enqueue), %.0f ns/step (total)\n", 0 == kind ? "pipeline (mem_deallocate)" : "pipeline (mem_deallocate_async)",
+          1E9 * enqueue_duration / nsteps, 1E9 * total_duration / nsteps);
+      }
+      delete[] source;
+      for (int i = 0; i < nstreams; ++i) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(pipeline[i]));
+      }
+    }
+    fprintf(stdout, "\n");
+
+    fprintf(stdout, "producers;items;enqueue [items/s];total [items/s]\n");
+    for (int nproducers = 1; nproducers <= maxproducers; nproducers <<= 1) {
+      double enqueue_duration = 0;
+      const double start = omp_get_wtime();
+
+#     pragma omp parallel num_threads(nproducers) reduction(max:enqueue_duration)
+      {
+        libxstream_argument* thread_signature = 0; // thread-local signature
+        LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_fn_signature(&thread_signature));
+        const int nthreads = omp_get_num_threads(), tid = omp_get_thread_num();
+        const int n = nitems / nthreads + (tid < (nitems % nthreads) ? 1 : 0);
+        for (int i = 0; i < n; ++i) {
+          LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_fn_call(kernel, thread_signature, stream, LIBXSTREAM_CALL_DEFAULT));
+        }
+        enqueue_duration = omp_get_wtime() - start;
+      }
+
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      const double total_duration = omp_get_wtime() - start;
+
+      if (0 < enqueue_duration && 0 < total_duration) {
+        fprintf(stdout, "%i;%i;%.0f;%.0f\n", nproducers, nitems, nitems / enqueue_duration, nitems / total_duration);
+        fflush(stdout);
+      }
+    }
+
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(stream));
+#else
+    libxstream_use_sink(&argc); libxstream_use_sink(argv);
+    fprintf(stderr, "OpenMP support needed for performance results!\n");
+#endif
+  }
+  catch(const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  catch(...) {
+    fprintf(stderr, "Error: unknown exception caught!\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#include <libxstream_begin.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+#include <libxstream_end.h>
+
+
+/**
+ * This program compares the policies of allocating host memory (libxstream_mem_set_policy)
+ * by copying a large buffer into another buffer (host-to-host) using a stream of the host.
+ * The first copy includes the page faults of the destination (unless the pages are touched
+ * when allocating), whereas the subsequent copies measure the sustained bandwidth which
+ * depends on the page size (TLB misses) and on the placement of the memory (NUMA node).
+ * The size of the buffers (MB) and the number of copies are given on the command line;
+ * the NUMA node (optional) is only applied to the policies listed with a node.
+ */
+int main(int argc, char* argv[])
+{
+  try {
+#if defined(_OPENMP)
+    const size_t size = static_cast<size_t>(std::max(1 < argc ? std::atoi(argv[1]) : 512, 1)) << 20;
+    const int nrepeat = std::max(2 < argc ? std::atoi(argv[2]) : 8, 1);
+    const int node = 3 < argc ? std::atoi(argv[3]) : -1;
+
+    const struct { int policy, node; const char* name; } policies[] = {
+      { LIBXSTREAM_MEM_DEFAULT, -1, "default" },
+      { LIBXSTREAM_MEM_PREFAULT, -1, "prefault" },
+      { LIBXSTREAM_MEM_HUGEPAGE, -1, "hugepage" },
+      { LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_PREFAULT, -1, "hugepage+prefault" },
+      { LIBXSTREAM_MEM_HUGETLB | LIBXSTREAM_MEM_PREFAULT, -1, "hugetlb+prefault" },
+      { LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_PREFAULT, node, "hugepage+prefault+node" }
+    };
+    const int npolicies = sizeof(policies) / sizeof(*policies) - (0 <= node ? 0 : 1);
+
+    libxstream_stream* stream = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&stream, -1/*host*/, 0, "hostmem"));
+    void* source = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &source, size, 0));
+    memset(source, 1, size);
+
+    fprintf(stdout, "policy;node;allocate [ms];first copy [MB/s];copy [MB/s]\n");
+    for (int i = 0; i < npolicies; ++i) {
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_set_policy(policies[i].policy, policies[i].node));
+
+      void* destination = 0;
+      const double start = omp_get_wtime();
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &destination, size, 0));
+      const double allocated = omp_get_wtime();
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(source, destination, size, stream));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      const double copied = omp_get_wtime();
+      for (int j = 0; j < nrepeat; ++j) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(source, destination, size, stream));
+      }
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+      const double duration = omp_get_wtime() - copied;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, destination));
+
+      const double mbytes = static_cast<double>(size) / (1 << 20);
+      fprintf(stdout, "%s;%i;%.1f;%.0f;%.0f\n", policies[i].name, policies[i].node, 1E3 * (allocated - start),
+        mbytes / std::max(copied - allocated, 1E-9), nrepeat * mbytes / std::max(duration, 1E-9));
+      fflush(stdout);
+    }
+
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_set_policy(LIBXSTREAM_MEM_DEFAULT, -1));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, source));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(stream));
+#else
+    libxstream_use_sink(&argc); libxstream_use_sink(argv);
+    fprintf(stderr, "OpenMP support needed for performance results!\n");
+#endif
+  }
+  catch(const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  catch(...) {
+    fprintf(stderr, "Error: unknown exception caught!\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#!/bin/bash
+
+HERE=$(cd $(dirname $0); pwd -P)
+NAME=$(basename ${HERE})
+
+${HERE}/${NAME} $* | \
+tee ${NAME}.csv
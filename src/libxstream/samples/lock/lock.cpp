@@ -0,0 +1,118 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#include <libxstream.hpp>
+#include <libxstream_begin.h>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+#include <libxstream_end.h>
+
+
+/**
+ * This program measures the latency of acquiring a lock under contention. Each thread repeatedly
+ * acquires a lock, performs a short critical section, and releases the lock. The lock is either
+ * shared by all threads, or each thread locks a different object: "colliding" objects are locked
+ * by address (libxstream_lock_get) where all addresses map to the same lock, whereas "private"
+ * locks are created per object (libxstream_lock_create). The worst-case latency is of interest
+ * when the threads outnumber the cores i.e., when the owner of a lock can be preempted.
+ */
+int main(int argc, char* argv[])
+{
+  try {
+#if defined(_OPENMP)
+    const int nthreads = std::min(std::max(1 < argc ? std::atoi(argv[1]) : 4, 1), LIBXSTREAM_MAX_NTHREADS);
+    const int nacquires = std::max(2 < argc ? std::atoi(argv[2]) : 100000, 1);
+    const int nwork = std::max(3 < argc ? std::atoi(argv[3]) : 100, 0);
+    const char *const name[] = { "shared", "colliding", "private" };
+
+    // objects with a distance such that their addresses hash to the same lock
+    const size_t stride = (LIBXSTREAM_MAX_SIMD) * (LIBXSTREAM_MAX_NLOCKS);
+    std::vector<char> objects(nthreads * stride);
+    std::vector<libxstream_lock*> locks(nthreads, static_cast<libxstream_lock*>(0));
+    std::vector<double> latency(static_cast<size_t>(nthreads) * nacquires);
+    volatile size_t counter = 0;
+
+    fprintf(stdout, "lock;threads;acquires;work;rate [1/us];p50 [us];p99 [us];max [us]\n");
+    for (int n = 0; n < 3; ++n) {
+      libxstream_lock *const shared = libxstream_lock_create();
+      for (int i = 0; i < nthreads; ++i) {
+        locks[i] = 0 == n ? shared : (1 == n ? libxstream_lock_get(&objects[i * stride]) : libxstream_lock_create());
+      }
+
+      const double start = omp_get_wtime();
+#     pragma omp parallel num_threads(nthreads)
+      {
+        const int tid = omp_get_thread_num();
+        libxstream_lock *const lock = locks[tid];
+        double *const thread_latency = &latency[static_cast<size_t>(tid) * nacquires];
+
+        for (int i = 0; i < nacquires; ++i) {
+          const double acquire = omp_get_wtime();
+          libxstream_lock_acquire(lock);
+          thread_latency[i] = 1E6 * (omp_get_wtime() - acquire);
+          for (int j = 0; j < nwork; ++j) ++counter;
+          libxstream_lock_release(lock);
+        }
+      }
+      const double duration = omp_get_wtime() - start;
+
+      if (2 == n) {
+        for (int i = 0; i < nthreads; ++i) libxstream_lock_destroy(locks[i]);
+      }
+      libxstream_lock_destroy(shared);
+
+      const size_t size = latency.size();
+      std::sort(latency.begin(), latency.end());
+      fprintf(stdout, "%s;%i;%i;%i;%.1f;%.2f;%.2f;%.1f\n", name[n], nthreads, nacquires, nwork, 1E-6 * size / duration,
+        latency[size / 2], latency[std::min(size - 1, (99 * size) / 100)], latency[size - 1]);
+      fflush(stdout);
+    }
+#else
+    libxstream_use_sink(&argc); libxstream_use_sink(argv);
+    fprintf(stderr, "OpenMP support needed for performance results!\n");
+#endif
+  }
+  catch(const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  catch(...) {
+    fprintf(stderr, "Error: unknown exception caught!\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#include <libxstream_begin.h>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#if defined(LIBXSTREAM_STDFEATURES)
+# include <thread>
+# include <chrono>
+#endif
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+#include <libxstream_end.h>
+
+
+/** Occupies the worker for the given duration without occupying a core (similar to waiting for an offload). */
+LIBXSTREAM_TARGET(mic) void wait_kernel(LIBXSTREAM_INVAL(double) duration)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  if (0 < LIBXSTREAM_GETVAL(duration)) {
+    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(1E6 * LIBXSTREAM_GETVAL(duration))));
+  }
+#elif defined(_OPENMP)
+  const double start = omp_get_wtime();
+  while ((omp_get_wtime() - start) < LIBXSTREAM_GETVAL(duration));
+#else
+  libxstream_use_sink(&duration);
+#endif
+}
+
+/* workaround for issue "cannot find address of function"; compile using "make.sh -g" */
+const libxstream_function kernel = reinterpret_cast<libxstream_function>(wait_kernel);
+
+
+/**
+ * This program measures the latency of short work items (probes) which are issued into a stream
+ * while the workers are saturated by the bulk work of other streams. Each probe is a function
+ * call followed by waiting for the stream. The latency is measured with the probe stream having
+ * the same priority as the bulk streams, and with the probe stream having the greatest priority.
+ * The bulk work is only preempted between work items i.e., the duration of a bulk item bounds
+ * the latency of a prioritized probe (per worker).
+ */
+int main(int argc, char* argv[])
+{
+  try {
+#if defined(_OPENMP)
+    const int nstreams = std::min(std::max(1 < argc ? std::atoi(argv[1]) : 4, 1), LIBXSTREAM_MAX_NSTREAMS - 1);
+    const int nprobes = std::max(2 < argc ? std::atoi(argv[2]) : 1000, 1);
+    const double duration = 1E-6 * std::max(3 < argc ? std::atoi(argv[3]) : 100, 0);
+    const int nworkers = std::min(std::max(4 < argc ? std::atoi(argv[4]) : 1, 1), LIBXSTREAM_MAX_NWORKERS);
+    const double no_duration = 0;
+    const int device = -1; // host
+
+    int priority_least = 0, priority_greatest = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_priority_range(&priority_least, &priority_greatest));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_set_nworkers(nworkers));
+
+    std::vector<libxstream_stream*> streams(nstreams, static_cast<libxstream_stream*>(0));
+    for (int i = 0; i < nstreams; ++i) {
+      char name[128];
+      LIBXSTREAM_SNPRINTF(name, sizeof(name), "Bulk %i", i + 1);
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&streams[i], device, priority_least, name));
+    }
+
+    libxstream_argument* signature = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_signature(&signature));
+
+    std::vector<double> latency(nprobes);
+    fprintf(stdout, "priority;streams;workers;probes;bulk [us];p50 [us];p99 [us];max [us]\n");
+    for (int n = 0; n < 2; ++n) {
+      const int priority = 0 == n ? priority_least : priority_greatest;
+      libxstream_stream* stream = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&stream, device, priority, "Probe"));
+
+      // enough bulk work to saturate the workers while probing (even without priorities)
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 0, &duration, libxstream_map_to<double>::type(), 0, 0));
+      for (int i = 0; i < 2 * nprobes; ++i) {
+        for (int j = 0; j < nstreams; ++j) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, streams[j], LIBXSTREAM_CALL_DEFAULT));
+        }
+      }
+
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 0, &no_duration, libxstream_map_to<double>::type(), 0, 0));
+      for (int i = 0; i < nprobes; ++i) {
+        const double start = omp_get_wtime();
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, stream, LIBXSTREAM_CALL_DEFAULT));
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+        latency[i] = 1E6 * (omp_get_wtime() - start);
+      }
+
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(0));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(stream));
+
+      std::sort(latency.begin(), latency.end());
+      fprintf(stdout, "%s;%i;%i;%i;%.0f;%.1f;%.1f;%.1f\n", 0 == n ? "same" : "greatest", nstreams, nworkers, nprobes, 1E6 * duration,
+        latency[nprobes / 2], latency[std::min(nprobes - 1, (99 * nprobes) / 100)], latency[nprobes - 1]);
+      fflush(stdout);
+    }
+
+    for (int i = 0; i < nstreams; ++i) {
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(streams[i]));
+    }
+#else
+    libxstream_use_sink(&argc); libxstream_use_sink(argv);
+    fprintf(stderr, "OpenMP support needed for performance results!\n");
+#endif
+  }
+  catch(const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  catch(...) {
+    fprintf(stderr, "Error: unknown exception caught!\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
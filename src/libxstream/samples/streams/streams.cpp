@@ -0,0 +1,145 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#include <libxstream_begin.h>
+#include <libxstream_begin.h>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#if defined(_OPENMP)
+# include <omp.h>
+#endif
+#include <libxstream_end.h>
+
+
+LIBXSTREAM_TARGET(mic) void busy_kernel(LIBXSTREAM_INVAL(double) duration)
+{
+#if defined(_OPENMP)
+  const double start = omp_get_wtime();
+  while ((omp_get_wtime() - start) < LIBXSTREAM_GETVAL(duration));
+#else
+  libxstream_use_sink(&duration);
+#endif
+}
+
+/* workaround for issue "cannot find address of function"; compile using "make.sh -g" */
+const libxstream_function kernel = reinterpret_cast<libxstream_function>(busy_kernel);
+
+
+/**
+ * This program measures how well the work of multiple streams overlaps when executed by
+ * a pool of workers. Each stream (host, device -1) receives the same number of function
+ * calls, and each call keeps its worker busy for the given duration. The number of workers
+ * is doubled for each step (1, 2, 4, ...) up to the given maximum. The speedup is relative
+ * to a single worker, and it is bound by the number of streams and by the number of cores.
+ * Finally, the cost of creating and destroying a stream, and the cost of waiting for all
+ * streams (without pending work) are measured while all streams are alive; neither of them
+ * depends on the number of streams.
+ */
+int main(int argc, char* argv[])
+{
+  try {
+#if defined(_OPENMP)
+    const int nstreams = std::max(1 < argc ? std::atoi(argv[1]) : 8, 1); // not limited
+    const int nitems = std::max(2 < argc ? std::atoi(argv[2]) : 100, 1);
+    const double duration = 1E-6 * std::max(3 < argc ? std::atoi(argv[3]) : 100, 0);
+    const int maxworkers = std::min(std::max(4 < argc ? std::atoi(argv[4]) : nstreams, 1), LIBXSTREAM_MAX_NWORKERS);
+    const int device = -1; // host
+
+    // the workers are started when the first work is enqueued
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_set_nworkers(1));
+
+    std::vector<libxstream_stream*> streams(nstreams, static_cast<libxstream_stream*>(0));
+    for (int i = 0; i < nstreams; ++i) {
+      char name[128];
+      LIBXSTREAM_SNPRINTF(name, sizeof(name), "Stream %i", i + 1);
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&streams[i], device, 0, name));
+    }
+
+    libxstream_argument* signature = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_signature(&signature));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(signature, 0, &duration, libxstream_map_to<double>::type(), 0, 0));
+
+    fprintf(stdout, "workers;streams;items;duration [s];speedup\n");
+    double reference = 0;
+    for (int nworkers = 1; nworkers <= maxworkers; nworkers <<= 1) {
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_set_nworkers(nworkers));
+      const double start = omp_get_wtime();
+
+      for (int i = 0; i < nitems; ++i) {
+        for (int j = 0; j < nstreams; ++j) {
+          LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(kernel, signature, streams[j], LIBXSTREAM_CALL_DEFAULT));
+        }
+      }
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(0));
+
+      const double total = omp_get_wtime() - start;
+      reference = 1 == nworkers ? total : reference;
+      if (0 < total) {
+        fprintf(stdout, "%i;%i;%i;%.3f;%.2f\n", nworkers, nstreams, nitems * nstreams, total, reference / total);
+        fflush(stdout);
+      }
+    }
+
+    const double start = omp_get_wtime();
+    for (int i = 0; i < nitems; ++i) {
+      libxstream_stream* stream = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&stream, device, 0, "transient"));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(stream));
+    }
+    fprintf(stdout, "\nstream_create/destroy: %.0f ns\n", 1E9 * (omp_get_wtime() - start) / nitems);
+
+    const double start_wait = omp_get_wtime();
+    for (int i = 0; i < nitems; ++i) {
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(0));
+    }
+    fprintf(stdout, "stream_wait(all): %.0f ns\n", 1E9 * (omp_get_wtime() - start_wait) / nitems);
+
+    for (int i = 0; i < nstreams; ++i) {
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(streams[i]));
+    }
+#else
+    libxstream_use_sink(&argc); libxstream_use_sink(argv);
+    fprintf(stderr, "OpenMP support needed for performance results!\n");
+#endif
+  }
+  catch(const std::exception& e) {
+    fprintf(stderr, "Error: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  catch(...) {
+    fprintf(stderr, "Error: unknown exception caught!\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
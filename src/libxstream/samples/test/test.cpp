@@ -98,12 +98,28 @@ LIBXSTREAM_TARGET(mic) void complex_cpp(libxstream_bool& ok,
   ok = result ? LIBXSTREAM_TRUE : LIBXSTREAM_FALSE;
 }
 
+LIBXSTREAM_TARGET(mic) void packed(const libxstream_argument* args)
+{
+  size_t arity = 0, value = 0;
+  const void* data = 0;
+  bool ok = LIBXSTREAM_ERROR_NONE == libxstream_get_arity(args, &arity) && (LIBXSTREAM_MAX_NARGS) < arity
+    && LIBXSTREAM_ERROR_NONE == libxstream_get_arity(0, &value) && arity == value // call context
+    && LIBXSTREAM_ERROR_NONE == libxstream_get_dims(args, 1, &value) && 1 == value
+    && LIBXSTREAM_ERROR_NONE == libxstream_get_data(args, 1, &data) && 0 != data;
+  for (size_t i = 2; i < arity && ok; ++i) {
+    ok = LIBXSTREAM_ERROR_NONE == libxstream_get_data(args, i, &data) && i == *static_cast<const size_t*>(data);
+  }
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_get_data(args, 0, &data));
+  *static_cast<libxstream_bool*>(const_cast<void*>(data)) = ok ? LIBXSTREAM_TRUE : LIBXSTREAM_FALSE;
+}
+
 } // namespace test_internal
 
 /* workaround for issue "cannot find address of function"; compile using "make.sh -g" */
 const libxstream_function check = reinterpret_cast<libxstream_function>(test_internal::check);
 const libxstream_function complex_c = reinterpret_cast<libxstream_function>(test_internal::complex_c);
 const libxstream_function complex_cpp = reinterpret_cast<libxstream_function>(test_internal::complex_cpp);
+const libxstream_function packed = reinterpret_cast<libxstream_function>(test_internal::packed);
 
 
 test_type::test_type(int device)
@@ -113,6 +129,11 @@ test_type::test_type(int device)
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_info(device, &mem_free, &mem_avail));
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&m_stream, device, 0, 0));
 
+  libxstream_wait_policy policy = LIBXSTREAM_WAIT_DEFAULT;
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_set_wait_policy(m_stream, LIBXSTREAM_WAIT_BLOCK)); // exercise the wake-up
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_get_wait_policy(m_stream, &policy));
+  LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_WAIT_BLOCK == policy);
+
   const size_t size = 4711u * 1024u;
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &m_host_mem, size, 0));
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(device, &m_dev_mem1, size, 0));
@@ -120,12 +141,39 @@ test_type::test_type(int device)
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_info(device, &mem_free, &mem_avail));
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(0)); // not necessary; test
 
+#if defined(LIBXSTREAM_MEM_CACHE)
+  { // a deallocated buffer is cached, and serves a subsequent allocation (of a similar size)
+    size_t hits = 0, hits_end = 0, cached = 0, trimmed = 0;
+    void *buffer = 0, *small = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &buffer, size, 0));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, buffer));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_cache_info(-1, &hits, 0, &cached));
+    LIBXSTREAM_CHECK_CONDITION_THROW(size <= cached);
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &small, size / 8, 0)); // split
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &buffer, size / 2, 0)); // split
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_cache_info(-1, &hits_end, 0, 0));
+    LIBXSTREAM_CHECK_CONDITION_THROW(hits + 2 == hits_end);
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, small));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, buffer));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_trim(-1, &trimmed)); // merged again
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_cache_info(-1, 0, 0, &cached));
+    LIBXSTREAM_CHECK_CONDITION_THROW(size <= trimmed && 0 == cached);
+  }
+#endif
+
   const char pattern_a = 'a', pattern_b = 'b';
   LIBXSTREAM_ASSERT(pattern_a != pattern_b);
   std::fill_n(reinterpret_cast<char*>(m_host_mem), size, pattern_a);
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(m_host_mem, m_dev_mem1, size, m_stream));
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2d(m_dev_mem1, m_dev_mem2, size, m_stream));
 
+  { // the temporary buffer is deallocated once the copy is completed
+    void* temporary = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(device, &temporary, size, 0));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2d(m_dev_mem1, temporary, size, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate_async(device, temporary, m_stream));
+  }
+
   size_t typesize = 0;
   unsigned char *const puc = 0, auc[16], *const* ppuc = &puc, *apuc[16];
   LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_ERROR_NONE == libxstream_get_typesize(libxstream_map_to_type(puc ), &typesize) && 1 == typesize);
@@ -215,6 +263,38 @@ test_type::test_type(int device)
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(complex_cpp, signature, m_stream, LIBXSTREAM_CALL_WAIT));
   LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
 
+  // more arguments than LIBXSTREAM_MAX_NARGS are passed as a block (packed)
+  const size_t npacked = 3 * (LIBXSTREAM_MAX_NARGS);
+  size_t values[3*(LIBXSTREAM_MAX_NARGS)];
+  libxstream_argument* block = 0;
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_create_signature(&block, npacked));
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_nargs(block, &nargs));
+  LIBXSTREAM_CHECK_CONDITION_THROW(npacked == nargs);
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_output(block, 0, &ok, libxstream_map_to_type(ok), 0, 0));
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(block, 1, m_dev_mem1, LIBXSTREAM_TYPE_VOID, 1, &size));
+  for (size_t i = 2; i < npacked; ++i) {
+    values[i] = i;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(block, i, values + i, libxstream_map_to_type(values[i]), 0, 0));
+  }
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_get_arity(block, &arity));
+  LIBXSTREAM_CHECK_CONDITION_THROW(npacked == arity);
+  ok = LIBXSTREAM_FALSE;
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_call(packed, block, m_stream, LIBXSTREAM_CALL_PACKED));
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_destroy_signature(block)); // the call took a copy
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(m_stream));
+  LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+
+#if defined(LIBXSTREAM_CHECK)
+  // an elemental output after the first LIBXSTREAM_MAX_NARGS pointers of a packed call is rejected up front
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_create_signature(&block, (LIBXSTREAM_MAX_NARGS) + 1));
+  for (size_t i = 0; i < (LIBXSTREAM_MAX_NARGS); ++i) {
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_input(block, i, m_dev_mem1, LIBXSTREAM_TYPE_VOID, 1, &size));
+  }
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_output(block, LIBXSTREAM_MAX_NARGS, &ok, libxstream_map_to_type(ok), 0, 0));
+  LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_ERROR_CONDITION == libxstream_fn_call(packed, block, m_stream, LIBXSTREAM_CALL_PACKED));
+  LIBXSTREAM_CHECK_CALL_THROW(libxstream_fn_destroy_signature(block));
+#endif
+
   std::fill_n(reinterpret_cast<char*>(m_host_mem), size, pattern_b);
   LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h(m_dev_mem2, m_host_mem, size, m_stream));
 
@@ -243,6 +323,58 @@ test_type::test_type(int device)
   const char zero = 0;
   test_internal::check(ok, LIBXSTREAM_SETVAL(zero), m_host_mem, LIBXSTREAM_SETVAL(size));
   LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+
+  { // striped copies are joined with the stream i.e., the copy in between sees all chunks
+    char *const host_mem = reinterpret_cast<char*>(m_host_mem);
+    std::fill_n(host_mem, size2, pattern_b);
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d_striped(host_mem, m_dev_mem1, size2, 64 * 1024, 2, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2d(m_dev_mem1, m_dev_mem2, size2, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h_striped(m_dev_mem2, host_mem + size2, size2, 64 * 1024, 2, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(m_stream));
+    test_internal::check(ok, LIBXSTREAM_SETVAL(pattern_b), host_mem + size2, LIBXSTREAM_SETVAL(size2));
+    LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+  }
+
+  { // a striped copy is split by default regardless of the number of workers
+    char *const host_mem = reinterpret_cast<char*>(m_host_mem);
+    const size_t chunk = std::max(size2 / (LIBXSTREAM_STRIPE_NSTREAMS), static_cast<size_t>(1));
+    const size_t nstripes_expected = std::min((size2 + chunk - 1) / chunk, static_cast<size_t>(LIBXSTREAM_STRIPE_NSTREAMS));
+    size_t nstripes = 0;
+    libxstream_stream* stream = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_create(&stream, device, 0, "striped"));
+    std::fill_n(host_mem, size2, pattern_a);
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d_striped(host_mem, m_dev_mem1, size2, chunk, 0, stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h_striped(m_dev_mem1, host_mem + size2, size2, chunk, 0, stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_get_nstripes(stream, &nstripes));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_destroy(stream));
+    LIBXSTREAM_CHECK_CONDITION_THROW(nstripes_expected == nstripes && 1 < nstripes);
+    test_internal::check(ok, LIBXSTREAM_SETVAL(pattern_a), host_mem + size2, LIBXSTREAM_SETVAL(size2));
+    LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+  }
+
+  { // a launch is not affected by patching the graph afterwards, and it outlives the graph
+    char *const host_mem = reinterpret_cast<char*>(m_host_mem);
+    const size_t n = size / 4;
+    std::fill_n(host_mem, n, pattern_a);
+    std::fill_n(host_mem + n, n, pattern_b);
+    libxstream_graph* graph = 0;
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_begin_capture(m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_h2d(host_mem, m_dev_mem1, n, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memcpy_d2h(m_dev_mem1, host_mem + 2 * n, n, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_end_capture(m_stream, &graph));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_memset_zero(m_dev_mem2, size, m_stream)); // keeps the stream busy
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_launch(graph, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_set_arg(graph, 0, 0, host_mem + n));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_set_arg(graph, 1, 1, host_mem + 3 * n));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_launch(graph, m_stream));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_graph_destroy(graph));
+    LIBXSTREAM_CHECK_CALL_THROW(libxstream_stream_wait(m_stream));
+    test_internal::check(ok, LIBXSTREAM_SETVAL(pattern_a), host_mem + 2 * n, LIBXSTREAM_SETVAL(n));
+    LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+    test_internal::check(ok, LIBXSTREAM_SETVAL(pattern_b), host_mem + 3 * n, LIBXSTREAM_SETVAL(n));
+    LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_FALSE != ok);
+  }
 }
 
 
@@ -273,6 +405,65 @@ int main(int argc, char* argv[])
       LIBXSTREAM_PRINT0(2, "No device found or device not ready!");
     }
 
+    { // host memory allocated according to a policy (process-wide)
+      const size_t size = 3u << 20;
+      int policy = LIBXSTREAM_MEM_DEFAULT, node = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_set_policy(LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_PREFAULT, -1));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_get_policy(&policy, &node));
+      LIBXSTREAM_CHECK_CONDITION_THROW((LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_PREFAULT) == policy && -1 == node);
+      void* buffer = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &buffer, size, 0));
+      LIBXSTREAM_CHECK_CONDITION_THROW(0 != buffer && 0 == (reinterpret_cast<uintptr_t>(buffer) % LIBXSTREAM_MAX_SIMD));
+      std::fill_n(static_cast<char*>(buffer), size, 'a');
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, buffer));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_set_policy(LIBXSTREAM_MEM_DEFAULT, -1)); // releases the buffer
+      LIBXSTREAM_CHECK_CONDITION_THROW(LIBXSTREAM_ERROR_NONE != libxstream_mem_set_policy(-1, -1));
+    }
+
+#if defined(LIBXSTREAM_MEM_CACHE)
+    { // accounting of the live memory (high-water mark, histogram, and tags)
+      const size_t size = 1000;
+      libxstream_mem_statistics stats, stats_end;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(-1, &stats));
+      void* buffer = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, &buffer, size, 0));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_set_tag(-1, buffer, __FILE__));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(-1, &stats_end));
+      LIBXSTREAM_CHECK_CONDITION_THROW(stats.live + size == stats_end.live && stats.nlive + 1 == stats_end.nlive && stats.nallocs + 1 == stats_end.nallocs);
+      LIBXSTREAM_CHECK_CONDITION_THROW(stats_end.live <= stats_end.peak && stats.histogram[4] + 1 == stats_end.histogram[4] && 0 < stats_end.ntags);
+      const char* tag = 0;
+      size_t live = 0, nlive = 0, i = 0;
+      for (; i < stats_end.ntags && LIBXSTREAM_ERROR_NONE == libxstream_mem_tag_stats(-1, i, &tag, &live, &nlive) && 0 != strcmp(__FILE__, tag); ++i);
+      LIBXSTREAM_CHECK_CONDITION_THROW(i < stats_end.ntags && size == live && 1 == nlive);
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, buffer));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_tag_stats(-1, i, &tag, &live, &nlive));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(-1, &stats_end));
+      LIBXSTREAM_CHECK_CONDITION_THROW(0 == live && 0 == nlive && stats.live == stats_end.live && stats.nlive == stats_end.nlive);
+    }
+
+    { // small buffers are carved out of a shared region
+      void* small[256];
+      const size_t nsmall = sizeof(small) / sizeof(*small);
+      libxstream_mem_statistics stats, stats_end;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_trim(-1, 0));
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(-1, &stats));
+      for (size_t i = 0; i < nsmall; ++i) {
+        int owner = 0;
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_allocate(-1, small + i, 24, 0));
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_device(static_cast<char*>(small[i]) + 23, &owner));
+        LIBXSTREAM_CHECK_CONDITION_THROW(-1 == owner && 0 == (reinterpret_cast<uintptr_t>(small[i]) % LIBXSTREAM_MAX_SIMD));
+      }
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_stats(-1, &stats_end));
+      LIBXSTREAM_CHECK_CONDITION_THROW((stats_end.acquired - stats.acquired) <= (LIBXSTREAM_MEM_SLAB) && stats.nsegments + 1 >= stats_end.nsegments);
+      for (size_t i = 0; i < nsmall; ++i) {
+        LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_deallocate(-1, small[i]));
+      }
+      size_t trimmed = 0;
+      LIBXSTREAM_CHECK_CALL_THROW(libxstream_mem_trim(-1, &trimmed)); // merged again
+      LIBXSTREAM_CHECK_CONDITION_THROW((LIBXSTREAM_MEM_SLAB) <= trimmed);
+    }
+#endif
+
 #if defined(_OPENMP)
     // chunksize: limit memory consumption on high core count systems
     const int chunksize = std::max(ntasks / LIBXSTREAM_MAX_NDEVICES, 1);
@@ -31,9 +31,11 @@
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 #include "libxstream.hpp"
 #include "libxstream_alloc.hpp"
+#include "libxstream_cache.hpp"
 #include "libxstream_workitem.hpp"
 #include "libxstream_context.hpp"
 #include "libxstream_event.hpp"
+#include "libxstream_graph.hpp"
 #include "libxstream_offload.hpp"
 
 #include <libxstream_begin.h>
@@ -45,7 +47,9 @@
 #if defined(LIBXSTREAM_STDFEATURES)
 # include <thread>
 # include <atomic>
-# define LIBXSTREAM_STDMUTEX
+# include <chrono>
+/** Prefers std::mutex over the adaptive lock (spin, then futex). */
+/*# define LIBXSTREAM_STDMUTEX*/
 # if defined(LIBXSTREAM_STDMUTEX)
 #   include <mutex>
 # endif
@@ -71,9 +75,15 @@
 #if defined(_WIN32)
 # include <windows.h>
 #else
+# include <xmmintrin.h>
 # include <unistd.h>
 #endif
 
+#if defined(__linux__)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
 #if !defined(YieldProcessor)
 # if defined(__MIC__)
 #   define YieldProcessor() _mm_delay_32(100)
@@ -229,6 +239,244 @@ LIBXSTREAM_TARGET(mic) DST bitwise_cast(const SRC& src)
   return result.dst;
 }
 
+
+#if defined(LIBXSTREAM_STDFEATURES) && !defined(LIBXSTREAM_STDMUTEX)
+/** State of the adaptive lock: 0 (unlocked), 1 (locked), or 2 (locked and possibly contended). */
+typedef std::atomic<int> lock_type;
+
+
+LIBXSTREAM_TARGET(mic) void lock_block(lock_type& lock)
+{
+#if defined(__linux__)
+  // sleeps unless the lock changed its state meanwhile
+  syscall(SYS_futex, reinterpret_cast<volatile int*>(&lock), FUTEX_WAIT_PRIVATE, 2, 0, 0, 0);
+#else
+  if (2 == lock.load(std::memory_order_relaxed)) {
+    this_thread_yield();
+  }
+#endif
+}
+
+
+LIBXSTREAM_TARGET(mic) void lock_wake(lock_type& lock)
+{
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<volatile int*>(&lock), FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+#else
+  libxstream_use_sink(&lock);
+#endif
+}
+#endif
+
+/** Acquires memory from the system (device or host); see libxstream_cache. */
+int mem_acquire(int device, void** memory, size_t size, size_t alignment)
+{
+  int result = LIBXSTREAM_ERROR_NONE;
+
+#if defined(LIBXSTREAM_OFFLOAD)
+  if (0 <= device) {
+    result = libxstream_virt_allocate(memory, size, alignment, &device, sizeof(device));
+
+    if (LIBXSTREAM_ERROR_NONE == result) {
+      LIBXSTREAM_ASYNC_BEGIN
+      {
+        const char* buffer = ptr<const char,1>();
+        const size_t size = val<const size_t,2>();
+
+        LIBXSTREAM_PRINT(2, "mem_acquire: device=%i buffer=0x%llx size=%lu", LIBXSTREAM_ASYNC_DEVICE,
+          reinterpret_cast<unsigned long long>(buffer), static_cast<unsigned long>(size));
+
+#       pragma offload_transfer target(mic:LIBXSTREAM_ASYNC_DEVICE) nocopy(buffer: length(size) LIBXSTREAM_OFFLOAD_ALLOC)
+      }
+      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, *memory, size);
+      result = work.status();
+    }
+  }
+  else {
+#else
+  {
+#endif
+    // the policy applies to the host memory interface (not to the host fallback of a device)
+    result = 0 > device ? libxstream_host_allocate(memory, size, alignment) : libxstream_real_allocate(memory, size, alignment);
+
+    LIBXSTREAM_PRINT(2, "mem_acquire: device=%i buffer=0x%llx size=%lu", device,
+      reinterpret_cast<unsigned long long>(*memory), static_cast<unsigned long>(size));
+
+    if (LIBXSTREAM_ERROR_NONE == result) {
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ALLOC_PINNED)
+      LIBXSTREAM_ASYNC_BEGIN
+      {
+        const char* buffer = ptr<const char,1>();
+        const size_t size = val<const size_t,2>();
+#       pragma offload_transfer target(mic) host_pin(buffer: length(size))
+      }
+      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, *memory, size);
+      result = work.status();
+#endif
+    }
+  }
+
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+/** Releases memory which was acquired from the system (mem_acquire). */
+int mem_release(int device, const void* memory)
+{
+  int result = LIBXSTREAM_ERROR_NONE;
+
+  if (memory) {
+#if defined(LIBXSTREAM_OFFLOAD)
+    if (0 <= device) {
+      LIBXSTREAM_ASYNC_BEGIN
+      {
+        const char *const memory = ptr<const char,1>();
+        LIBXSTREAM_PRINT(2, "mem_release: device=%i buffer=0x%llx", LIBXSTREAM_ASYNC_DEVICE, reinterpret_cast<unsigned long long>(memory));
+#       pragma offload_transfer target(mic:LIBXSTREAM_ASYNC_DEVICE) nocopy(memory: length(0) LIBXSTREAM_OFFLOAD_FREE)
+        LIBXSTREAM_ASYNC_QENTRY.status() = libxstream_virt_deallocate(memory);
+      }
+      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, memory);
+      result = work.status();
+    }
+    else {
+#else
+    {
+      libxstream_use_sink(&device);
+#endif
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ALLOC_PINNED)
+      LIBXSTREAM_ASYNC_BEGIN
+      {
+        const char* memory = ptr<const char,1>();
+        LIBXSTREAM_PRINT(2, "mem_release: device=%i buffer=0x%llx", LIBXSTREAM_ASYNC_DEVICE, reinterpret_cast<unsigned long long>(memory));
+#       pragma offload_transfer target(mic) host_unpin(memory: length(0))
+        LIBXSTREAM_ASYNC_QENTRY.status() = libxstream_host_deallocate(memory);
+      }
+      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, memory);
+      result = work.status();
+#else
+      LIBXSTREAM_PRINT(2, "mem_release: device=%i buffer=0x%llx", device, reinterpret_cast<unsigned long long>(memory));
+      result = libxstream_host_deallocate(memory); // device memory (host fallback) is not mapped
+#endif
+    }
+  }
+
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+#if defined(LIBXSTREAM_MEM_CACHE)
+/** Releases the segments which are entirely cached; returns the number of bytes. */
+size_t mem_trim(int device)
+{
+  std::vector<void*> segments;
+  const size_t result = libxstream_cache::instance(device).trim(segments);
+  const size_t nsegments = segments.size();
+  for (size_t i = 0; i < nsegments; ++i) {
+    LIBXSTREAM_CHECK_CALL_ASSERT(mem_release(device, segments[i]));
+  }
+  return result;
+}
+#endif
+
+
+/** Deallocates memory without synchronization i.e., the memory is not in use anymore. */
+int mem_free(int device, const void* memory)
+{
+  int result = LIBXSTREAM_ERROR_NONE;
+
+  if (memory) {
+#if defined(LIBXSTREAM_MEM_CACHE)
+    LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
+    LIBXSTREAM_PRINT(2, "mem_deallocate: device=%i buffer=0x%llx", device, reinterpret_cast<unsigned long long>(memory));
+
+    if (!libxstream_cache::instance(device).deallocate(memory)) {
+      result = LIBXSTREAM_ERROR_CONDITION;
+      for (int i = -1; i < (LIBXSTREAM_MAX_NDEVICES); ++i) {
+        if (i != device && libxstream_cache::instance(i).deallocate(memory)) {
+          LIBXSTREAM_PRINT(1, "mem_deallocate: device %i does not match allocating device %i!", device, i);
+          result = LIBXSTREAM_ERROR_NONE;
+          break;
+        }
+      }
+    }
+#else
+    result = mem_release(device, memory);
+#endif
+  }
+
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+/** Splits a copy into chunks across the stripes of the given stream, and joins them with the stream. */
+int memcpy_striped(const void* src, void* dst, size_t size, size_t chunk, size_t nstreams, libxstream_stream& stream,
+  int (*memcpy_fn)(const void*, void*, size_t, libxstream_stream*))
+{
+  if (0 == chunk) chunk = LIBXSTREAM_STRIPE_CHUNK;
+  // the copy is split regardless of the number of workers (the stripes of a host stream run concurrently with more than one)
+  if (0 == nstreams) nstreams = LIBXSTREAM_STRIPE_NSTREAMS;
+  const size_t nchunks = (size + chunk - 1) / chunk;
+  nstreams = std::min(std::min(nstreams, nchunks), static_cast<size_t>(LIBXSTREAM_STRIPE_NSTREAMS));
+
+  if (2 > nstreams || stream.capturing()) {
+    return memcpy_fn(src, dst, size, &stream);
+  }
+
+  LIBXSTREAM_PRINT(2, "memcpy_striped: stream=0x%llx 0x%llx->0x%llx size=%lu chunk=%lu nstreams=%lu", reinterpret_cast<unsigned long long>(&stream),
+    reinterpret_cast<unsigned long long>(src), reinterpret_cast<unsigned long long>(dst), static_cast<unsigned long>(size),
+    static_cast<unsigned long>(chunk), static_cast<unsigned long>(nstreams));
+
+  libxstream_stream* stripes[LIBXSTREAM_STRIPE_NSTREAMS];
+  // the chunks start once the work enqueued into the stream so far is completed
+  libxstream_event fork;
+  bool ready = true;
+  LIBXSTREAM_CHECK_CALL(fork.record(stream, true));
+  LIBXSTREAM_CHECK_CALL(fork.query(ready));
+  for (size_t i = 0; i < nstreams; ++i) {
+    stripes[i] = stream.stripe(i);
+    if (!ready) {
+      LIBXSTREAM_CHECK_CALL(fork.wait_stream(stripes[i]));
+    }
+  }
+
+  const char *const s = static_cast<const char*>(src);
+  char *const d = static_cast<char*>(dst);
+  for (size_t i = 0; i < nchunks; ++i) {
+    const size_t offset = i * chunk;
+    LIBXSTREAM_CHECK_CALL(memcpy_fn(s + offset, d + offset, std::min(chunk, size - offset), stripes[i % nstreams]));
+  }
+
+  // the work enqueued into the stream afterwards waits for all chunks
+  libxstream_event join;
+  for (size_t i = 0; i < nstreams; ++i) {
+    LIBXSTREAM_CHECK_CALL(join.record(*stripes[i], 0 == i));
+  }
+  return join.wait_stream(&stream);
+}
+
+
+/** Checks that a packed call transfers back its elemental outputs i.e., they are among the first LIBXSTREAM_MAX_NARGS pointers. */
+bool packed_translatable(const libxstream_argument* signature, size_t arity)
+{
+  size_t np = 0;
+  for (size_t i = 0; i < arity; ++i) {
+    if (0 != signature[i].dims) {
+      ++np;
+    }
+    else if (0 != (libxstream_argument::kind_output & signature[i].kind)) {
+      if ((LIBXSTREAM_MAX_NARGS) <= np) {
+        LIBXSTREAM_PRINT(1, "fn_call: packed elemental output %lu is beyond the first %i pointers", static_cast<unsigned long>(i), LIBXSTREAM_MAX_NARGS);
+        return false;
+      }
+      ++np;
+    }
+  }
+  return true;
+}
+
 } // namespace libxstream_internal
 
 
@@ -242,7 +490,7 @@ LIBXSTREAM_TARGET(mic) libxstream_lock* libxstream_lock_create()
 # if defined(LIBXSTREAM_STDMUTEX)
   std::mutex *const typed_lock = new std::mutex;
 # else
-  std::atomic<int> *const typed_lock = new std::atomic<int>(0);
+  libxstream_internal::lock_type *const typed_lock = new libxstream_internal::lock_type(0);
 # endif
 #elif defined(_OPENMP)
   omp_lock_t typed_lock;
@@ -286,7 +534,7 @@ LIBXSTREAM_TARGET(mic) void libxstream_lock_destroy(libxstream_lock* lock)
 # if defined(LIBXSTREAM_STDMUTEX)
   std::mutex *const typed_lock = static_cast<std::mutex*>(lock);
 # else
-  std::atomic<int> *const typed_lock = static_cast<std::atomic<int>*>(lock);
+  libxstream_internal::lock_type *const typed_lock = static_cast<libxstream_internal::lock_type*>(lock);
 # endif
   delete typed_lock;
 #elif defined(_OPENMP)
@@ -315,10 +563,21 @@ LIBXSTREAM_TARGET(mic) void libxstream_lock_acquire(libxstream_lock* lock)
   std::mutex *const typed_lock = static_cast<std::mutex*>(lock);
   typed_lock->lock();
 # else
-  std::atomic<int>& typed_lock = *static_cast<std::atomic<int>*>(lock);
-  if (1 < ++typed_lock) {
-    while (1 < typed_lock) {
-      this_thread_sleep();
+  libxstream_internal::lock_type& typed_lock = *static_cast<libxstream_internal::lock_type*>(lock);
+  int state = 0;
+  if (!typed_lock.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+    // poll for a short period since the lock is usually held for a short time only
+    bool locked = false;
+    for (int i = 0; i < (LIBXSTREAM_LOCK_NSPIN) && !locked; ++i) {
+      YieldProcessor();
+      state = 0;
+      locked = 0 == typed_lock.load(std::memory_order_relaxed)
+        && typed_lock.compare_exchange_weak(state, 1, std::memory_order_acquire);
+    }
+    if (!locked) { // block the thread (marks the lock as contended)
+      while (0 != typed_lock.exchange(2, std::memory_order_acquire)) {
+        libxstream_internal::lock_block(typed_lock);
+      }
     }
   }
 # endif
@@ -343,8 +602,10 @@ LIBXSTREAM_TARGET(mic) void libxstream_lock_release(libxstream_lock* lock)
   std::mutex *const typed_lock = static_cast<std::mutex*>(lock);
   typed_lock->unlock();
 # else
-  std::atomic<int>& typed_lock = *static_cast<std::atomic<int>*>(lock);
-  --typed_lock;
+  libxstream_internal::lock_type& typed_lock = *static_cast<libxstream_internal::lock_type*>(lock);
+  if (2 == typed_lock.exchange(0, std::memory_order_release)) {
+    libxstream_internal::lock_wake(typed_lock);
+  }
 # endif
 #elif defined(_OPENMP)
   omp_lock_t typed_lock = libxstream_internal::bitwise_cast<omp_lock_t>(lock);
@@ -367,9 +628,9 @@ LIBXSTREAM_TARGET(mic) bool libxstream_lock_try(libxstream_lock* lock)
   std::mutex *const typed_lock = static_cast<std::mutex*>(lock);
   const bool result = typed_lock->try_lock();
 # else
-  std::atomic<int>& typed_lock = *static_cast<std::atomic<int>*>(lock);
-  const bool result = 1 == ++typed_lock;
-  if (!result) --typed_lock;
+  libxstream_internal::lock_type& typed_lock = *static_cast<libxstream_internal::lock_type*>(lock);
+  int state = 0;
+  const bool result = typed_lock.compare_exchange_strong(state, 1, std::memory_order_acquire);
 # endif
 #elif defined(_OPENMP)
   omp_lock_t typed_lock = libxstream_internal::bitwise_cast<omp_lock_t>(lock);
@@ -473,6 +734,24 @@ LIBXSTREAM_TARGET(mic) void this_thread_sleep(size_t ms)
 }
 
 
+LIBXSTREAM_TARGET(mic) double libxstream_timer()
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  typedef std::chrono::steady_clock clock_type;
+  return std::chrono::duration<double>(clock_type::now().time_since_epoch()).count();
+#elif defined(_WIN32)
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return static_cast<double>(counter.QuadPart) / frequency.QuadPart;
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + 1E-9 * now.tv_nsec;
+#endif
+}
+
+
 LIBXSTREAM_TARGET(mic) void this_thread_wait(size_t& cycle)
 {
 #if 0 != (LIBXSTREAM_SPIN_CYCLES)
@@ -549,6 +828,23 @@ LIBXSTREAM_EXPORT_C int libxstream_set_active_device(int device)
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_get_wait_policy(libxstream_wait_policy* policy)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != policy);
+  *policy = static_cast<libxstream_wait_policy>(libxstream_default_wait_policy());
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_set_wait_policy(libxstream_wait_policy policy)
+{
+  LIBXSTREAM_CHECK_CONDITION(LIBXSTREAM_WAIT_DEFAULT <= policy && LIBXSTREAM_WAIT_BLOCK >= policy);
+  LIBXSTREAM_PRINT(2, "set_wait_policy: policy=%i", policy);
+  libxstream_default_wait_policy(policy);
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_mem_info(int device, size_t* allocatable, size_t* physical)
 {
   LIBXSTREAM_CHECK_CONDITION(allocatable || physical);
@@ -592,108 +888,207 @@ LIBXSTREAM_EXPORT_C int libxstream_mem_info(int device, size_t* allocatable, siz
 LIBXSTREAM_EXPORT_C int libxstream_mem_allocate(int device, void** memory, size_t size, size_t alignment)
 {
   LIBXSTREAM_CHECK_CONDITION(0 != memory);
+#if defined(LIBXSTREAM_MEM_CACHE)
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
   int result = LIBXSTREAM_ERROR_NONE;
 
-#if defined(LIBXSTREAM_OFFLOAD)
-  if (0 <= device) {
-    result = libxstream_virt_allocate(memory, size, alignment, &device, sizeof(device));
-
-    if (LIBXSTREAM_ERROR_NONE == result) {
-      LIBXSTREAM_ASYNC_BEGIN
-      {
-        const char* buffer = ptr<const char,1>();
-        const size_t size = val<const size_t,2>();
-
-        LIBXSTREAM_PRINT(2, "mem_allocate: device=%i buffer=0x%llx size=%lu", LIBXSTREAM_ASYNC_DEVICE,
-          reinterpret_cast<unsigned long long>(buffer), static_cast<unsigned long>(size));
-
-#       pragma offload_transfer target(mic:LIBXSTREAM_ASYNC_DEVICE) nocopy(buffer: length(size) LIBXSTREAM_OFFLOAD_ALLOC)
+  if (0 < size) {
+    libxstream_cache& cache = libxstream_cache::instance(device);
+    *memory = cache.allocate(size, alignment);
+
+    if (0 == *memory) { // acquire a segment of the size class, or a region which serves subsequent small allocations
+      const size_t size_class = libxstream_cache::size_class(size);
+      size_t segment_size = (LIBXSTREAM_MEM_SMALL) >= size ? std::max<size_t>(LIBXSTREAM_MEM_SLAB, size_class) : size_class;
+      void* segment = 0;
+      result = libxstream_internal::mem_acquire(device, &segment, segment_size, alignment);
+      if (LIBXSTREAM_ERROR_NONE != result && size_class < segment_size) { // no region
+        segment_size = size_class;
+        result = libxstream_internal::mem_acquire(device, &segment, segment_size, alignment);
+      }
+      if (LIBXSTREAM_ERROR_NONE != result && 0 < libxstream_internal::mem_trim(device)) { // memory pressure
+        result = libxstream_internal::mem_acquire(device, &segment, segment_size, alignment);
+      }
+      if (LIBXSTREAM_ERROR_NONE == result) {
+        *memory = cache.insert(segment, segment_size, size);
       }
-      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, *memory, size);
-      result = work.status();
     }
+
+    LIBXSTREAM_PRINT(2, "mem_allocate: device=%i buffer=0x%llx size=%lu", device,
+      reinterpret_cast<unsigned long long>(*memory), static_cast<unsigned long>(size));
   }
   else {
+    *memory = 0;
+  }
+
+  return result;
 #else
-  {
-    libxstream_use_sink(&device);
+  return libxstream_internal::mem_acquire(device, memory, size, alignment);
 #endif
-    LIBXSTREAM_PRINT(2, "mem_allocate: device=%i buffer=0x%llx size=%lu", device,
-      reinterpret_cast<unsigned long long>(*memory), static_cast<unsigned long>(size));
+}
 
-    result = libxstream_real_allocate(memory, size, alignment);
 
-    if (LIBXSTREAM_ERROR_NONE == result) {
-#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ALLOC_PINNED)
-      LIBXSTREAM_ASYNC_BEGIN
-      {
-        const char* buffer = ptr<const char,1>();
-        const size_t size = val<const size_t,2>();
-#       pragma offload_transfer target(mic) host_pin(buffer: length(size))
-      }
-      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, *memory, size);
-      result = work.status();
-#endif
+LIBXSTREAM_EXPORT_C int libxstream_mem_device(const void* memory, int* device)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != memory && 0 != device);
+  int result = LIBXSTREAM_ERROR_CONDITION;
+#if defined(LIBXSTREAM_MEM_CACHE)
+  for (int i = -1; i < (LIBXSTREAM_MAX_NDEVICES); ++i) {
+    const void* segment = 0;
+    if (libxstream_cache::instance(i).contains(memory, &segment)) {
+# if defined(LIBXSTREAM_OFFLOAD)
+      // the region carries the device it was acquired for (libxstream_virt_data)
+      LIBXSTREAM_ASSERT(0 > i || i == *static_cast<const int*>(libxstream_virt_data(segment)));
+# endif
+      libxstream_use_sink(segment);
+      *device = i;
+      result = LIBXSTREAM_ERROR_NONE;
+      break;
     }
   }
-
-  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+#endif
   return result;
 }
 
 
 LIBXSTREAM_EXPORT_C int libxstream_mem_deallocate(int device, const void* memory)
 {
-  int result = LIBXSTREAM_ERROR_NONE;
-
   if (memory) {
     // synchronize across all devices not just the given device
     libxstream_stream::wait_all(true);
+  }
+  return libxstream_internal::mem_free(device, memory);
+}
 
-#if defined(LIBXSTREAM_OFFLOAD)
-    if (0 <= device) {
-# if defined(LIBXSTREAM_CHECK)
-      const int memory_device = *static_cast<const int*>(libxstream_virt_data(memory));
-      if (device != memory_device) {
-        LIBXSTREAM_PRINT(1, "mem_deallocate: device %i does not match allocating device %i!", device, memory_device);
-        LIBXSTREAM_CHECK_CONDITION(0 <= memory_device);
-        device = memory_device;
-      }
-# endif
-      LIBXSTREAM_ASYNC_BEGIN
-      {
-        const char *const memory = ptr<const char,1>();
-        LIBXSTREAM_PRINT(2, "mem_deallocate: device=%i buffer=0x%llx", LIBXSTREAM_ASYNC_DEVICE, reinterpret_cast<unsigned long long>(memory));
-#       pragma offload_transfer target(mic:LIBXSTREAM_ASYNC_DEVICE) nocopy(memory: length(0) LIBXSTREAM_OFFLOAD_FREE)
-        LIBXSTREAM_ASYNC_QENTRY.status() = libxstream_virt_deallocate(memory);
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_deallocate_async(int device, const void* memory, libxstream_stream* stream)
+{
+  if (0 == stream) {
+    return libxstream_mem_deallocate(device, memory);
+  }
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES) && !stream->capturing());
+
+  if (memory) {
+    LIBXSTREAM_PRINT(2, "mem_deallocate_async: device=%i buffer=0x%llx stream=0x%llx", device,
+      reinterpret_cast<unsigned long long>(memory), reinterpret_cast<unsigned long long>(stream));
+#if defined(LIBXSTREAM_MEM_CACHE)
+    const size_t deferred = libxstream_cache::instance(device).defer(memory);
+#endif
+
+    LIBXSTREAM_ASYNC_BEGIN
+    {
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (1 < (2*LIBXSTREAM_ASYNC+1)/2)
+      if (!(LIBXSTREAM_ASYNC_READY) && 0 <= LIBXSTREAM_ASYNC_DEVICE) {
+#       pragma offload_wait LIBXSTREAM_ASYNC_TARGET_WAIT
       }
-      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, memory);
-      result = work.status();
+#endif
+      // the work enqueued so far (including the events the stream waits for) is completed
+      LIBXSTREAM_ASYNC_QENTRY.status() = libxstream_internal::mem_free(val<int,0>(), ptr<const void,1>());
     }
-    else {
+    LIBXSTREAM_ASYNC_END(stream, LIBXSTREAM_CALL_DEFAULT, work, device, memory);
+
+#if defined(LIBXSTREAM_MEM_CACHE)
+    // backpressure: bound the memory which is held back by deallocations not yet executed
+    if ((LIBXSTREAM_MEM_DEFERRED) < deferred) {
+      return stream->wait(true);
+    }
+#endif
+  }
+
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_stats(int device, libxstream_mem_statistics* stats)
+{
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES) && 0 != stats);
+#if defined(LIBXSTREAM_MEM_CACHE)
+  libxstream_cache::instance(device).stats(*stats);
 #else
-    {
-      libxstream_use_sink(&device);
+  memset(stats, 0, sizeof(libxstream_mem_statistics));
 #endif
-#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ALLOC_PINNED)
-      LIBXSTREAM_ASYNC_BEGIN
-      {
-        const char* memory = ptr<const char,1>();
-        LIBXSTREAM_PRINT(2, "mem_deallocate: device=%i buffer=0x%llx", LIBXSTREAM_ASYNC_DEVICE, reinterpret_cast<unsigned long long>(memory));
-#       pragma offload_transfer target(mic) host_unpin(memory: length(0))
-        LIBXSTREAM_ASYNC_QENTRY.status() = libxstream_real_deallocate(memory);
-      }
-      LIBXSTREAM_ASYNC_END(0, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_DEVICE, work, device, memory);
-      result = work.status();
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_set_tag(int device, const void* memory, const char* tag)
+{
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES) && 0 != memory);
+  LIBXSTREAM_PRINT(3, "mem_set_tag: device=%i buffer=0x%llx tag=%s", device, reinterpret_cast<unsigned long long>(memory), tag ? tag : "");
+#if defined(LIBXSTREAM_MEM_CACHE)
+  return libxstream_cache::instance(device).tag(memory, tag) ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION;
 #else
-      LIBXSTREAM_PRINT(2, "mem_deallocate: device=%i buffer=0x%llx", device, reinterpret_cast<unsigned long long>(memory));
-      result = libxstream_real_deallocate(memory);
+  libxstream_use_sink(tag);
+  return LIBXSTREAM_ERROR_NONE;
 #endif
-    }
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_tag_stats(int device, size_t i, const char** tag, size_t* live, size_t* nlive)
+{
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
+#if defined(LIBXSTREAM_MEM_CACHE)
+  return libxstream_cache::instance(device).tag_stats(i, tag, live, nlive) ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION;
+#else
+  libxstream_use_sink(&i); libxstream_use_sink(tag); libxstream_use_sink(live); libxstream_use_sink(nlive);
+  return LIBXSTREAM_ERROR_CONDITION;
+#endif
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_get_policy(int* policy, int* node)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != policy || 0 != node);
+  const int host_policy = libxstream_host_policy(node);
+  if (policy) {
+    *policy = host_policy;
   }
+  return LIBXSTREAM_ERROR_NONE;
+}
 
-  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
-  return result;
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_set_policy(int policy, int node)
+{
+  const int all = LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_HUGETLB | LIBXSTREAM_MEM_PREFAULT;
+  LIBXSTREAM_CHECK_CONDITION(0 == (policy & ~all) && -1 <= node && node < static_cast<int>(8 * sizeof(unsigned long)));
+  LIBXSTREAM_PRINT(2, "mem_set_policy: policy=%i node=%i", policy, node);
+  libxstream_host_policy(policy, node);
+#if defined(LIBXSTREAM_MEM_CACHE)
+  libxstream_internal::mem_trim(-1); // cached memory follows the previous policy
+#endif
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_trim(int device, size_t* size)
+{
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
+#if defined(LIBXSTREAM_MEM_CACHE)
+  const size_t trimmed = libxstream_internal::mem_trim(device);
+#else
+  const size_t trimmed = 0;
+#endif
+  LIBXSTREAM_PRINT(2, "mem_trim: device=%i size=%lu", device, static_cast<unsigned long>(trimmed));
+  if (size) {
+    *size = trimmed;
+  }
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_mem_cache_info(int device, size_t* hits, size_t* misses, size_t* cached)
+{
+  LIBXSTREAM_CHECK_CONDITION(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
+#if defined(LIBXSTREAM_MEM_CACHE)
+  const libxstream_cache& cache = libxstream_cache::instance(device);
+  if (hits) *hits = cache.hits();
+  if (misses) *misses = cache.misses();
+  if (cached) *cached = cache.cached();
+#else
+  if (hits) *hits = 0;
+  if (misses) *misses = 0;
+  if (cached) *cached = 0;
+#endif
+  return LIBXSTREAM_ERROR_NONE;
 }
 
 
@@ -816,6 +1211,28 @@ LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2h(const void* dev_mem, void* host_me
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_memcpy_h2d_striped(const void* host_mem, void* dev_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != host_mem && 0 != dev_mem && host_mem != dev_mem);
+  const int result = 0 != stream
+    ? libxstream_internal::memcpy_striped(host_mem, dev_mem, size, chunk, nstreams, *stream, libxstream_memcpy_h2d)
+    : libxstream_memcpy_h2d(host_mem, dev_mem, size, stream);
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2h_striped(const void* dev_mem, void* host_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != dev_mem && 0 != host_mem && dev_mem != host_mem);
+  const int result = 0 != stream
+    ? libxstream_internal::memcpy_striped(dev_mem, host_mem, size, chunk, nstreams, *stream, libxstream_memcpy_d2h)
+    : libxstream_memcpy_d2h(dev_mem, host_mem, size, stream);
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_memcpy_d2d(const void* src, void* dst, size_t size, libxstream_stream* stream)
 {
   LIBXSTREAM_CHECK_CONDITION(0 != src && 0 != dst);
@@ -877,9 +1294,19 @@ LIBXSTREAM_EXPORT_C int libxstream_stream_priority_range(int* least, int* greate
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_stream_priority_default(int* priority)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != priority);
+  *priority = libxstream_stream::priority_default();
+  LIBXSTREAM_PRINT(3, "libxstream_stream_priority_default: priority=%i", *priority);
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_stream_create(libxstream_stream** stream, int device, int priority, const char* name)
 {
   if (stream) {
+    LIBXSTREAM_CHECK_CONDITION(-1 <= device && (LIBXSTREAM_MAX_NDEVICES) > device);
     libxstream_stream *const s = new libxstream_stream(device, priority, name);
     LIBXSTREAM_ASSERT(s);
     *stream = s;
@@ -962,13 +1389,34 @@ LIBXSTREAM_EXPORT_C int libxstream_stream_wait_event(libxstream_stream* stream,
 {
   // TODO: print in order
   //LIBXSTREAM_PRINT(2, "stream_wait_event: stream=0x%llx event=0x%llx", reinterpret_cast<unsigned long long>(stream), reinterpret_cast<unsigned long long>(event));
-  LIBXSTREAM_CHECK_CONDITION(0 != event);
+  LIBXSTREAM_CHECK_CONDITION(0 != event && (0 == stream || !stream->capturing()));
   const int result = libxstream_event(*event).wait_stream(stream);
   LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
   return result;
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_stream_add_callback(libxstream_stream* stream, libxstream_callback callback, void* userdata)
+{
+  LIBXSTREAM_PRINT(2, "stream_add_callback: stream=0x%llx callback=0x%llx", reinterpret_cast<unsigned long long>(stream), reinterpret_cast<unsigned long long>(callback));
+  LIBXSTREAM_CHECK_CONDITION(0 != stream && 0 != callback);
+
+  LIBXSTREAM_ASYNC_BEGIN
+  {
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (1 < (2*LIBXSTREAM_ASYNC+1)/2)
+    if (!(LIBXSTREAM_ASYNC_READY) && 0 <= LIBXSTREAM_ASYNC_DEVICE) {
+#     pragma offload_wait LIBXSTREAM_ASYNC_TARGET_WAIT
+    }
+#endif
+    const libxstream_callback function = reinterpret_cast<libxstream_callback>(val<libxstream_function,0>());
+    function(LIBXSTREAM_ASYNC_STREAM, ptr<void,1>());
+  }
+  LIBXSTREAM_ASYNC_END(stream, LIBXSTREAM_CALL_DEFAULT, work, reinterpret_cast<libxstream_function>(callback), userdata);
+
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_stream_device(const libxstream_stream* stream, int* device)
 {
   LIBXSTREAM_CHECK_CONDITION(0 != device);
@@ -1009,6 +1457,102 @@ LIBXSTREAM_EXPORT_C int libxstream_stream_device(const libxstream_stream* stream
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_nstripes(const libxstream_stream* stream, size_t* nstripes)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != stream && 0 != nstripes);
+  *nstripes = stream->nstripes();
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_nworkers(size_t* nworkers)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != nworkers);
+  *nworkers = libxstream_scheduler_size();
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_set_nworkers(size_t nworkers)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 < nworkers && (LIBXSTREAM_MAX_NWORKERS) >= nworkers);
+  LIBXSTREAM_PRINT(2, "stream_set_nworkers: nworkers=%lu", static_cast<unsigned long>(nworkers));
+  return libxstream_scheduler_size(nworkers);
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_get_wait_policy(const libxstream_stream* stream, libxstream_wait_policy* policy)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != stream && 0 != policy);
+  *policy = static_cast<libxstream_wait_policy>(stream->queue().wait_policy());
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_set_wait_policy(libxstream_stream* stream, libxstream_wait_policy policy)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != stream && LIBXSTREAM_WAIT_DEFAULT <= policy && LIBXSTREAM_WAIT_BLOCK >= policy);
+  LIBXSTREAM_PRINT(2, "stream_set_wait_policy: stream=0x%llx policy=%i", reinterpret_cast<unsigned long long>(stream), policy);
+  stream->queue().wait_policy(policy);
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_begin_capture(libxstream_stream* stream)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != stream);
+  LIBXSTREAM_PRINT(2, "stream_begin_capture: stream=0x%llx", reinterpret_cast<unsigned long long>(stream));
+  const int result = stream->begin_capture();
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_stream_end_capture(libxstream_stream* stream, libxstream_graph** graph)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != stream && 0 != graph && stream->capturing());
+  *graph = stream->end_capture();
+  LIBXSTREAM_PRINT(2, "stream_end_capture: stream=0x%llx graph=0x%llx size=%lu", reinterpret_cast<unsigned long long>(stream),
+    reinterpret_cast<unsigned long long>(*graph), static_cast<unsigned long>((*graph)->size()));
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_graph_destroy(const libxstream_graph* graph)
+{
+  LIBXSTREAM_PRINT(2, "graph_destroy: graph=0x%llx", reinterpret_cast<unsigned long long>(graph));
+  delete graph;
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_graph_size(const libxstream_graph* graph, size_t* size)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != graph && 0 != size);
+  *size = graph->size();
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_graph_set_arg(libxstream_graph* graph, size_t node, size_t arg, const void* value)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != graph);
+  LIBXSTREAM_PRINT(3, "graph_set_arg: graph=0x%llx node=%lu arg=%lu value=0x%llx", reinterpret_cast<unsigned long long>(graph),
+    static_cast<unsigned long>(node), static_cast<unsigned long>(arg), reinterpret_cast<unsigned long long>(value));
+  return graph->arg(node, arg, value);
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_graph_launch(libxstream_graph* graph, libxstream_stream* stream)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != graph && 0 != stream && !stream->capturing());
+  LIBXSTREAM_PRINT(2, "graph_launch: graph=0x%llx stream=0x%llx", reinterpret_cast<unsigned long long>(graph), reinterpret_cast<unsigned long long>(stream));
+  const int result = graph->launch(*stream);
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_event_create(libxstream_event** event)
 {
   LIBXSTREAM_CHECK_CONDITION(event);
@@ -1018,9 +1562,21 @@ LIBXSTREAM_EXPORT_C int libxstream_event_create(libxstream_event** event)
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_event_create_timed(libxstream_event** event)
+{
+  LIBXSTREAM_CHECK_CONDITION(event);
+  *event = new libxstream_event(true);
+  LIBXSTREAM_PRINT(2, "event_create_timed: event=0x%llx", reinterpret_cast<unsigned long long>(*event));
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_event_destroy(const libxstream_event* event)
 {
   LIBXSTREAM_PRINT(0 != event ? 2 : 0, "event_destroy: event=0x%llx", reinterpret_cast<unsigned long long>(event));
+  if (0 != event && event->timed()) { // the worker still refers to the event until the timestamp is taken
+    LIBXSTREAM_CHECK_CALL(event->wait());
+  }
   delete event;
   return LIBXSTREAM_ERROR_NONE;
 }
@@ -1029,6 +1585,8 @@ LIBXSTREAM_EXPORT_C int libxstream_event_destroy(const libxstream_event* event)
 LIBXSTREAM_EXPORT_C int libxstream_event_record(libxstream_event* event, libxstream_stream* stream)
 {
   LIBXSTREAM_PRINT(2, "event_record: event=0x%llx stream=0x%llx", reinterpret_cast<unsigned long long>(event), reinterpret_cast<unsigned long long>(stream));
+  LIBXSTREAM_CHECK_CONDITION(0 != event && (0 == stream || !stream->capturing()));
+  LIBXSTREAM_CHECK_CONDITION(0 != stream || !event->timed()); // a timed event is recorded into a single stream
   const int result = stream ? event->record(*stream, true) : libxstream_stream::enqueue(*event);
   LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
   return result;
@@ -1053,12 +1611,23 @@ LIBXSTREAM_EXPORT_C int libxstream_event_wait(libxstream_event* event)
 {
   LIBXSTREAM_PRINT(2, "event_wait: event=0x%llx", reinterpret_cast<unsigned long long>(event));
   LIBXSTREAM_CHECK_CONDITION(event);
-  const int result = event->wait(0, true);
+  const int result = event->wait();
   LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
   return result;
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_event_elapsed(const libxstream_event* start, const libxstream_event* end, double* ms)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != start && 0 != end && 0 != ms);
+  double tstart = 0, tend = 0;
+  LIBXSTREAM_CHECK_CALL(start->time(tstart));
+  LIBXSTREAM_CHECK_CALL(end->time(tend));
+  *ms = 1E3 * (tend - tstart);
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_fn_signature(libxstream_argument** signature)
 {
   static LIBXSTREAM_TLS libxstream_argument arguments[(LIBXSTREAM_MAX_NARGS)+1];
@@ -1068,6 +1637,31 @@ LIBXSTREAM_EXPORT_C int libxstream_fn_signature(libxstream_argument** signature)
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_fn_create_signature(libxstream_argument** signature, size_t nargs)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != signature);
+  libxstream_argument *const arguments = new libxstream_argument[nargs+1];
+  const int result = libxstream_construct(arguments, nargs);
+  if (LIBXSTREAM_ERROR_NONE == result) {
+    *signature = arguments;
+  }
+  else {
+    delete[] arguments;
+  }
+  LIBXSTREAM_PRINT(2, "fn_create_signature: signature=0x%llx nargs=%lu", reinterpret_cast<unsigned long long>(arguments), static_cast<unsigned long>(nargs));
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_fn_destroy_signature(const libxstream_argument* signature)
+{
+  LIBXSTREAM_PRINT(0 != signature ? 2 : 0, "fn_destroy_signature: signature=0x%llx", reinterpret_cast<unsigned long long>(signature));
+  delete[] signature;
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 LIBXSTREAM_EXPORT_C int libxstream_fn_clear_signature(libxstream_argument* signature)
 {
   size_t nargs = 0;
@@ -1124,10 +1718,7 @@ LIBXSTREAM_EXPORT_C int libxstream_fn_nargs(const libxstream_argument* signature
   LIBXSTREAM_CHECK_CONDITION(0 != nargs);
   size_t n = 0;
   if (signature) {
-    while (libxstream_argument::kind_invalid != signature[n].kind) {
-      LIBXSTREAM_ASSERT(n < (LIBXSTREAM_MAX_NARGS));
-      ++n;
-    }
+    while (libxstream_argument::kind_invalid != signature[n].kind) ++n;
   }
   *nargs = n;
   return LIBXSTREAM_ERROR_NONE;
@@ -1136,7 +1727,12 @@ LIBXSTREAM_EXPORT_C int libxstream_fn_nargs(const libxstream_argument* signature
 
 LIBXSTREAM_EXPORT_C int libxstream_fn_call(libxstream_function function, const libxstream_argument* signature, libxstream_stream* stream, int flags)
 {
-  LIBXSTREAM_CHECK_CONDITION(0 != function);
+  LIBXSTREAM_CHECK_CONDITION(0 != function && (0 == stream || !stream->capturing() || 0 == (LIBXSTREAM_CALL_WAIT & flags)));
+  if (0 != (LIBXSTREAM_CALL_PACKED & flags)) {
+    size_t arity = 0;
+    LIBXSTREAM_CHECK_CALL(libxstream_get_arity(signature, &arity));
+    LIBXSTREAM_CHECK_CONDITION(libxstream_internal::packed_translatable(signature, arity));
+  }
   const libxstream_workqueue::entry_type& work = libxstream_offload(function, signature, stream, flags);
   const int result = 0 == (LIBXSTREAM_CALL_WAIT & flags) ? work.status() : work.wait();
   LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
@@ -1144,6 +1740,44 @@ LIBXSTREAM_EXPORT_C int libxstream_fn_call(libxstream_function function, const l
 }
 
 
+LIBXSTREAM_EXPORT_C int libxstream_fn_plan(libxstream_plan** plan, libxstream_function function, const libxstream_argument* signature, int flags)
+{
+  size_t arity = 0;
+  LIBXSTREAM_CHECK_CALL(libxstream_get_arity(signature, &arity));
+  LIBXSTREAM_CHECK_CONDITION(0 != plan && 0 != function && 0 == (LIBXSTREAM_CALL_EXTERNAL & flags)
+    && ((LIBXSTREAM_MAX_NARGS) >= arity || 0 != (LIBXSTREAM_CALL_PACKED & flags)));
+  LIBXSTREAM_CHECK_CONDITION(0 == (LIBXSTREAM_CALL_PACKED & flags) || libxstream_internal::packed_translatable(signature, arity));
+  *plan = new libxstream_plan(function, signature, flags);
+  LIBXSTREAM_PRINT(2, "fn_plan: plan=0x%llx fn=0x%llx arity=%lu flags=%i", reinterpret_cast<unsigned long long>(*plan),
+    reinterpret_cast<unsigned long long>(function), static_cast<unsigned long>((*plan)->arity()), flags);
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_plan_destroy(const libxstream_plan* plan)
+{
+  LIBXSTREAM_PRINT(0 != plan ? 2 : 0, "plan_destroy: plan=0x%llx", reinterpret_cast<unsigned long long>(plan));
+  delete plan;
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_plan_set_arg(libxstream_plan* plan, size_t arg, const void* value)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != plan);
+  LIBXSTREAM_PRINT(3, "plan_set_arg: plan=0x%llx arg=%lu value=0x%llx", reinterpret_cast<unsigned long long>(plan),
+    static_cast<unsigned long>(arg), reinterpret_cast<unsigned long long>(value));
+  return plan->arg(arg, value);
+}
+
+
+LIBXSTREAM_EXPORT_C int libxstream_plan_call(const libxstream_plan* plan, libxstream_stream* stream)
+{
+  LIBXSTREAM_CHECK_CONDITION(0 != plan && (0 == stream || !stream->capturing() || 0 == (LIBXSTREAM_CALL_WAIT & plan->flags())));
+  return plan->call(stream);
+}
+
+
 LIBXSTREAM_EXPORT_C LIBXSTREAM_TARGET(mic) int libxstream_get_typesize(libxstream_type type, size_t* typesize)
 {
   LIBXSTREAM_CHECK_CONDITION(0 != typesize);
@@ -1225,7 +1859,7 @@ LIBXSTREAM_EXPORT_C LIBXSTREAM_TARGET(mic) int libxstream_get_argument(const voi
   int result = LIBXSTREAM_ERROR_NONE;
 
   if (0 != hit) {
-    LIBXSTREAM_ASSERT((LIBXSTREAM_MAX_NARGS) > (hit - context.signature));
+    LIBXSTREAM_ASSERT((LIBXSTREAM_MAX_NARGS) > (hit - context.signature) || 0 != (LIBXSTREAM_CALL_PACKED & context.flags));
     *arg = hit - context.signature;
   }
   else {
@@ -1250,7 +1884,6 @@ LIBXSTREAM_EXPORT_C LIBXSTREAM_TARGET(mic) int libxstream_get_arity(const libxst
   size_t n = 0;
   if (signature) {
     while (LIBXSTREAM_TYPE_INVALID != signature[n].type) {
-      LIBXSTREAM_ASSERT(n < (LIBXSTREAM_MAX_NARGS));
       LIBXSTREAM_ASSERT(libxstream_argument::kind_invalid != signature[n].kind);
       ++n;
     }
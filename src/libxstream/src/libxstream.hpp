@@ -52,6 +52,8 @@ LIBXSTREAM_TARGET(mic) int this_thread_id();
 LIBXSTREAM_TARGET(mic) void this_thread_yield();
 LIBXSTREAM_TARGET(mic) void this_thread_sleep(size_t ms = LIBXSTREAM_SLEEP_MS);
 LIBXSTREAM_TARGET(mic) void this_thread_wait(size_t& cycle);
+/** Seconds elapsed since an unspecified point in time (monotonic clock). */
+LIBXSTREAM_TARGET(mic) double libxstream_timer();
 
 /**
  * The following flags are complimentary to libxstream_call_flags,
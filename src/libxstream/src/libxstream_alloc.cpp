@@ -35,6 +35,7 @@
 #include <libxstream_begin.h>
 #include <algorithm>
 #include <cstring>
+#include <map>
 #include <libxstream_end.h>
 
 #if defined(__MKL)
@@ -46,11 +47,18 @@
 #else
 # include <xmmintrin.h>
 # include <sys/mman.h>
+# include <unistd.h>
+# if defined(__linux__)
+#   include <sys/syscall.h>
+# endif
 #endif
 
 #define LIBXSTREAM_ALLOC_VALLOC
 //#define LIBXSTREAM_ALLOC_MMAP
 
+/** Size of a huge page in Byte (transparent huge pages). */
+#define LIBXSTREAM_ALLOC_HUGEPAGE (2 << 20)
+
 
 namespace libxstream_alloc_internal {
 
@@ -68,6 +76,48 @@ LIBXSTREAM_TARGET(mic) S linear_size(size_t dims, const T shape[], S initial_siz
   return result;
 }
 
+
+int host_policy = LIBXSTREAM_MEM_DEFAULT, host_node = -1;
+
+#if !defined(_WIN32)
+/** Host memory which is mapped according to a policy (the aligned address refers to the mapping and its size). */
+class mapping_type {
+public:
+  mapping_type(): m_lock(libxstream_lock_create()) {}
+  ~mapping_type() { libxstream_lock_destroy(m_lock); }
+
+public:
+  void insert(const void* memory, void* buffer, size_t size) {
+    libxstream_lock_acquire(m_lock);
+    m_mapped[memory] = std::make_pair(buffer, size);
+    libxstream_lock_release(m_lock);
+  }
+
+  bool remove(const void* memory, void** buffer, size_t* size) {
+    libxstream_lock_acquire(m_lock);
+    const std::map<const void*,std::pair<void*,size_t> >::iterator i = m_mapped.find(memory);
+    const bool result = i != m_mapped.end();
+    if (result) {
+      *buffer = i->second.first;
+      *size = i->second.second;
+      m_mapped.erase(i);
+    }
+    libxstream_lock_release(m_lock);
+    return result;
+  }
+
+private:
+  std::map<const void*,std::pair<void*,size_t> > m_mapped;
+  libxstream_lock* m_lock;
+};
+
+mapping_type& mapping()
+{
+  static mapping_type instance;
+  return instance;
+}
+#endif
+
 } // namespace libxstream_alloc_internal
 
 
@@ -277,6 +327,94 @@ int libxstream_real_deallocate(const void* memory)
 }
 
 
+int libxstream_host_policy(int* node)
+{
+  if (node) {
+    *node = libxstream_alloc_internal::host_node;
+  }
+  return libxstream_alloc_internal::host_policy;
+}
+
+
+void libxstream_host_policy(int policy, int node)
+{
+  libxstream_alloc_internal::host_policy = policy;
+  libxstream_alloc_internal::host_node = node;
+}
+
+
+int libxstream_host_allocate(void** memory, size_t size, size_t alignment)
+{
+  int node = -1;
+  const int policy = libxstream_host_policy(&node);
+#if defined(_WIN32)
+  libxstream_use_sink(&policy);
+#else
+  if ((LIBXSTREAM_MEM_DEFAULT != policy || 0 <= node) && 0 != memory && 0 < size) {
+    static const size_t pagesize = std::max<long>(sysconf(_SC_PAGESIZE), 4096);
+    const bool huge = 0 != ((LIBXSTREAM_MEM_HUGEPAGE | LIBXSTREAM_MEM_HUGETLB) & policy);
+    const size_t granularity = huge ? std::max<size_t>(LIBXSTREAM_ALLOC_HUGEPAGE, pagesize) : pagesize;
+    const size_t auto_alignment = std::max(libxstream_alignment(size, alignment), granularity);
+    const size_t aligned_size = libxstream_align(size, granularity);
+    size_t mapped_size = aligned_size;
+    void* buffer = MAP_FAILED;
+    char* aligned = 0;
+
+# if defined(MAP_HUGETLB)
+    if (0 != (LIBXSTREAM_MEM_HUGETLB & policy) && auto_alignment == granularity) { // reserved huge pages are aligned
+      buffer = mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+# endif
+    if (MAP_FAILED == buffer) { // over-allocate such that the aligned address leaves room for the size
+      mapped_size = aligned_size + auto_alignment - pagesize;
+      buffer = mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (MAP_FAILED == buffer) {
+        return LIBXSTREAM_ERROR_RUNTIME;
+      }
+# if defined(MADV_HUGEPAGE)
+      if (huge) {
+        madvise(libxstream_align(buffer, auto_alignment), aligned_size, MADV_HUGEPAGE);
+      }
+# endif
+    }
+    aligned = static_cast<char*>(libxstream_align(buffer, auto_alignment));
+    LIBXSTREAM_ASSERT(buffer <= aligned && (aligned + aligned_size) <= (static_cast<char*>(buffer) + mapped_size));
+
+    if (0 <= node) { // place the pages before they are touched
+# if defined(__linux__) && defined(SYS_mbind)
+      const unsigned long nodemask = 1UL << node;
+      if (0 != syscall(SYS_mbind, aligned, aligned_size, 2/*MPOL_BIND*/, &nodemask, 8 * sizeof(nodemask) + 1, 0)) {
+        munmap(buffer, mapped_size);
+        return LIBXSTREAM_ERROR_RUNTIME;
+      }
+# endif
+    }
+    if (0 != (LIBXSTREAM_MEM_PREFAULT & policy)) {
+      for (size_t i = 0; i < aligned_size; i += pagesize) aligned[i] = 0;
+    }
+
+    libxstream_alloc_internal::mapping().insert(aligned, buffer, mapped_size);
+    *memory = aligned;
+    return LIBXSTREAM_ERROR_NONE;
+  }
+#endif
+  return libxstream_real_allocate(memory, size, alignment);
+}
+
+
+int libxstream_host_deallocate(const void* memory)
+{
+#if !defined(_WIN32)
+  void* buffer = 0;
+  size_t size = 0;
+  if (0 != memory && libxstream_alloc_internal::mapping().remove(memory, &buffer, &size)) {
+    return 0 == munmap(buffer, size) ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_RUNTIME;
+  }
+#endif
+  return libxstream_real_deallocate(memory);
+}
+
+
 int libxstream_virt_allocate(void** memory, size_t size, size_t alignment, const void* data, size_t data_size)
 {
   LIBXSTREAM_CHECK_CONDITION(0 == data_size || 0 != data);
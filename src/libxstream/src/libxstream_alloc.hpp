@@ -51,6 +51,14 @@ LIBXSTREAM_TARGET(mic) size_t libxstream_linear_address(size_t dims, const int o
 int libxstream_real_allocate(void** memory, size_t size, size_t alignment);
 int libxstream_real_deallocate(const void* memory);
 
+/** Policy of allocating host memory (libxstream_mem_policy), and the NUMA node (-1: none). */
+int libxstream_host_policy(int* node = 0);
+void libxstream_host_policy(int policy, int node);
+
+/** Allocates host memory according to the policy (libxstream_host_policy); falls back to libxstream_real_allocate. */
+int libxstream_host_allocate(void** memory, size_t size, size_t alignment);
+int libxstream_host_deallocate(const void* memory);
+
 int libxstream_virt_allocate(void** memory, size_t size, size_t alignment, const void* data = 0, size_t data_size = 0);
 int libxstream_virt_deallocate(const void* memory);
 
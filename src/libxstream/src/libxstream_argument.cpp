@@ -46,7 +46,6 @@ int libxstream_construct(libxstream_argument arguments[], size_t arg, libxstream
     && ((0 == dims && 0 == shape) || (0 == dims && 0 != shape && weak_candidate) || (0 < dims))
     && (LIBXSTREAM_MAX_NDIMS) >= dims);
 
-  LIBXSTREAM_ASSERT((LIBXSTREAM_MAX_NARGS) >= arg);
   libxstream_argument& argument = arguments[arg];
 
 #if defined(LIBXSTREAM_DEBUG)
@@ -86,7 +85,7 @@ int libxstream_construct(libxstream_argument arguments[], size_t arg, libxstream
 
 int libxstream_construct(libxstream_argument* signature, size_t nargs)
 {
-  LIBXSTREAM_CHECK_CONDITION((0 != signature || 0 == nargs) && (LIBXSTREAM_MAX_NARGS) >= nargs);
+  LIBXSTREAM_CHECK_CONDITION(0 != signature || 0 == nargs);
 
   if (0 != signature) {
     LIBXSTREAM_PRAGMA_LOOP_COUNT(0, LIBXSTREAM_MAX_NARGS, LIBXSTREAM_MAX_NARGS/2)
@@ -0,0 +1,384 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+#include "libxstream_cache.hpp"
+#include "libxstream_alloc.hpp"
+
+#include <libxstream_begin.h>
+#include <algorithm>
+#include <libxstream_end.h>
+
+/** Granularity of the size classes (and the smallest class) in Byte. */
+#define LIBXSTREAM_CACHE_GRAIN 64
+/** Number of size classes per power of two. */
+#define LIBXSTREAM_CACHE_NCLASSES 4
+/** Number of cached blocks which are tried for a request with an alignment they do not satisfy. */
+#define LIBXSTREAM_CACHE_NTRIES 8
+
+
+struct libxstream_cache::block_type {
+  block_type(char* address, size_t size, block_type* prev = 0, block_type* next = 0)
+    : address(address), size(size), requested(0), tag(0), prev(prev), next(next), slot(), used(false), deferred(false)
+  {}
+  char* address;
+  size_t size, requested;
+  tag_type* tag;
+  // adjacent blocks of the same segment
+  block_type *prev, *next;
+  // position in the list of cached blocks (if cached)
+  free_type::iterator slot;
+  bool used, deferred;
+};
+
+
+namespace libxstream_cache_internal {
+
+size_t bin(size_t size)
+{
+  size_t result = 0;
+  for (size_t limit = 64; limit < size && result < (LIBXSTREAM_MEM_NBINS - 1); limit <<= 1) ++result;
+  return result;
+}
+
+} // namespace libxstream_cache_internal
+
+
+libxstream_cache& libxstream_cache::instance(int device)
+{
+  static libxstream_cache caches[(LIBXSTREAM_MAX_NDEVICES)+1];
+  LIBXSTREAM_ASSERT(-1 <= device && device < (LIBXSTREAM_MAX_NDEVICES));
+  return caches[device+1];
+}
+
+
+size_t libxstream_cache::size_class(size_t size)
+{
+  size_t result = LIBXSTREAM_CACHE_GRAIN;
+  if (result < size) {
+    size_t pot = result;
+    while ((pot << 1) <= size) pot <<= 1;
+    const size_t step = std::max<size_t>(pot / (LIBXSTREAM_CACHE_NCLASSES), LIBXSTREAM_CACHE_GRAIN);
+    result = ((size + step - 1) / step) * step;
+  }
+  return result;
+}
+
+
+libxstream_cache::libxstream_cache()
+  : m_lock(libxstream_lock_create())
+  , m_hits(0), m_misses(0), m_cached(0), m_acquired(0), m_deferred(0)
+  , m_live(0), m_peak(0), m_nallocs(0)
+{
+  std::fill_n(m_histogram, LIBXSTREAM_MEM_NBINS, 0);
+}
+
+
+libxstream_cache::~libxstream_cache()
+{
+  // segments are not released at exit (the device may be gone already)
+  for (used_type::const_iterator i = m_used.begin(); i != m_used.end(); ++i) delete i->second;
+  for (free_type::const_iterator i = m_free.begin(); i != m_free.end(); ++i) delete i->second;
+  libxstream_lock_destroy(m_lock);
+}
+
+
+void* libxstream_cache::allocate(size_t size, size_t alignment)
+{
+  const size_t sclass = size_class(size);
+#if defined(LIBXSTREAM_DEBUG)
+  // the debug allocator does not align the memory either (libxstream_real_allocate)
+  libxstream_use_sink(&alignment);
+  const size_t align = 1;
+#else
+  const size_t align = libxstream_alignment(size, alignment);
+#endif
+  void* result = 0;
+
+  libxstream_lock_acquire(m_lock);
+  free_type::iterator i = m_free.lower_bound(sclass);
+  for (size_t n = 0; i != m_free.end() && n < (LIBXSTREAM_CACHE_NTRIES); ++i, ++n) {
+    if (0 == (reinterpret_cast<uintptr_t>(i->second->address) % align)) {
+      result = use(*i->second, sclass, size);
+      break;
+    }
+  }
+  if (0 != result) ++m_hits; else ++m_misses;
+  libxstream_lock_release(m_lock);
+
+  return result;
+}
+
+
+void* libxstream_cache::insert(void* segment, size_t segment_size, size_t size)
+{
+  LIBXSTREAM_ASSERT(0 != segment && size <= segment_size);
+  block_type *const block = new block_type(static_cast<char*>(segment), segment_size);
+
+  libxstream_lock_acquire(m_lock);
+  m_acquired += segment_size;
+  m_cached += segment_size;
+  m_segments[block->address] = segment_size;
+  block->slot = m_free.insert(free_type::value_type(segment_size, block));
+  void *const result = use(*block, size_class(size), size);
+  libxstream_lock_release(m_lock);
+
+  return result;
+}
+
+
+bool libxstream_cache::deallocate(const void* memory)
+{
+  bool result = false;
+
+  libxstream_lock_acquire(m_lock);
+  const used_type::iterator i = m_used.find(memory);
+  if (i != m_used.end()) {
+    block_type *const block = i->second;
+    m_used.erase(i);
+    if (block->deferred) {
+      LIBXSTREAM_ASSERT(block->size <= m_deferred);
+      m_deferred -= block->size;
+      block->deferred = false;
+    }
+    if (tag_type *const tag = block->tag) {
+      LIBXSTREAM_ASSERT(block->requested <= tag->live && 0 < tag->nlive);
+      tag->live -= block->requested;
+      --tag->nlive;
+      block->tag = 0;
+    }
+    LIBXSTREAM_ASSERT(block->requested <= m_live);
+    m_live -= block->requested;
+    --m_histogram[libxstream_cache_internal::bin(block->requested)];
+    release(*block);
+    result = true;
+  }
+  libxstream_lock_release(m_lock);
+
+  return result;
+}
+
+
+bool libxstream_cache::owns(const void* memory, size_t* size) const
+{
+  libxstream_lock_acquire(m_lock);
+  const used_type::const_iterator i = m_used.find(memory);
+  const bool result = i != m_used.end();
+  if (result && 0 != size) {
+    *size = i->second->size;
+  }
+  libxstream_lock_release(m_lock);
+  return result;
+}
+
+
+bool libxstream_cache::contains(const void* memory, const void** segment) const
+{
+  const char *const address = static_cast<const char*>(memory);
+  bool result = false;
+
+  libxstream_lock_acquire(m_lock);
+  std::map<const char*,size_t>::const_iterator i = m_segments.upper_bound(address);
+  if (i != m_segments.begin()) {
+    --i;
+    result = address < (i->first + i->second);
+    if (result && 0 != segment) {
+      *segment = i->first;
+    }
+  }
+  libxstream_lock_release(m_lock);
+
+  return result;
+}
+
+
+size_t libxstream_cache::defer(const void* memory)
+{
+  libxstream_lock_acquire(m_lock);
+  const used_type::const_iterator i = m_used.find(memory);
+  if (i != m_used.end() && !i->second->deferred) {
+    i->second->deferred = true;
+    m_deferred += i->second->size;
+  }
+  const size_t result = m_deferred;
+  libxstream_lock_release(m_lock);
+  return result;
+}
+
+
+void libxstream_cache::stats(libxstream_mem_statistics& stats) const
+{
+  libxstream_lock_acquire(m_lock);
+  stats.live = m_live;
+  stats.peak = m_peak;
+  stats.nlive = m_used.size();
+  stats.nallocs = m_nallocs;
+  stats.acquired = m_acquired;
+  stats.cached = m_cached;
+  stats.nsegments = m_segments.size();
+  stats.ntags = m_tags.size();
+  std::copy(m_histogram, m_histogram + LIBXSTREAM_MEM_NBINS, stats.histogram);
+  libxstream_lock_release(m_lock);
+}
+
+
+bool libxstream_cache::tag(const void* memory, const char* tag)
+{
+  libxstream_lock_acquire(m_lock);
+  const used_type::iterator i = m_used.find(memory);
+  const bool result = i != m_used.end();
+  if (result) {
+    block_type& block = *i->second;
+    if (0 != block.tag) {
+      block.tag->live -= block.requested;
+      --block.tag->nlive;
+      block.tag = 0;
+    }
+    if (0 != tag) {
+      const std::map<std::string,size_t>::const_iterator j = m_tag_index.find(tag);
+      if (j != m_tag_index.end()) {
+        block.tag = &m_tags[j->second];
+      }
+      else {
+        m_tag_index[tag] = m_tags.size();
+        m_tags.push_back(tag_type(tag));
+        block.tag = &m_tags.back();
+      }
+      block.tag->live += block.requested;
+      ++block.tag->nlive;
+    }
+  }
+  libxstream_lock_release(m_lock);
+  return result;
+}
+
+
+bool libxstream_cache::tag_stats(size_t i, const char** tag, size_t* live, size_t* nlive) const
+{
+  libxstream_lock_acquire(m_lock);
+  const bool result = i < m_tags.size();
+  if (result) {
+    const tag_type& t = m_tags[i];
+    if (tag) *tag = t.name.c_str();
+    if (live) *live = t.live;
+    if (nlive) *nlive = t.nlive;
+  }
+  libxstream_lock_release(m_lock);
+  return result;
+}
+
+
+size_t libxstream_cache::trim(std::vector<void*>& segments)
+{
+  size_t result = 0;
+
+  libxstream_lock_acquire(m_lock);
+  for (free_type::iterator i = m_free.begin(); i != m_free.end();) {
+    block_type *const block = i->second;
+    if (0 == block->prev && 0 == block->next) { // entire segment
+      segments.push_back(block->address);
+      m_segments.erase(block->address);
+      result += block->size;
+      m_free.erase(i++);
+      delete block;
+    }
+    else {
+      ++i;
+    }
+  }
+  LIBXSTREAM_ASSERT(result <= m_cached && result <= m_acquired);
+  m_cached -= result;
+  m_acquired -= result;
+  libxstream_lock_release(m_lock);
+
+  return result;
+}
+
+
+void* libxstream_cache::use(block_type& block, size_t size, size_t requested)
+{
+  LIBXSTREAM_ASSERT(size <= block.size);
+  m_free.erase(block.slot);
+
+  // split the block unless the remainder is small compared to the request
+  const size_t remainder = block.size - size;
+  if ((LIBXSTREAM_CACHE_GRAIN) <= remainder && (size / (LIBXSTREAM_CACHE_NCLASSES)) <= remainder) {
+    block_type *const rest = new block_type(block.address + size, remainder, &block, block.next);
+    if (0 != block.next) block.next->prev = rest;
+    block.next = rest;
+    block.size = size;
+    rest->slot = m_free.insert(free_type::value_type(remainder, rest));
+  }
+
+  LIBXSTREAM_ASSERT(block.size <= m_cached);
+  m_cached -= block.size;
+  m_used[block.address] = &block;
+  block.used = true;
+
+  block.requested = requested;
+  m_live += requested;
+  m_peak = std::max(m_peak, m_live);
+  ++m_histogram[libxstream_cache_internal::bin(requested)];
+  ++m_nallocs;
+  return block.address;
+}
+
+
+void libxstream_cache::release(block_type& block)
+{
+  m_cached += block.size;
+  block.used = false;
+  block_type* result = &block;
+
+  // merge with the adjacent blocks which are cached as well
+  if (block_type *const next = block.next) {
+    if (!next->used) {
+      m_free.erase(next->slot);
+      block.size += next->size;
+      block.next = next->next;
+      if (0 != block.next) block.next->prev = &block;
+      delete next;
+    }
+  }
+  if (block_type *const prev = block.prev) {
+    if (!prev->used) {
+      m_free.erase(prev->slot);
+      prev->size += block.size;
+      prev->next = block.next;
+      if (0 != prev->next) prev->next->prev = prev;
+      delete &block;
+      result = prev;
+    }
+  }
+
+  result->slot = m_free.insert(free_type::value_type(result->size, result));
+}
+
+#endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
@@ -0,0 +1,127 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#ifndef LIBXSTREAM_CACHE_HPP
+#define LIBXSTREAM_CACHE_HPP
+
+#include "libxstream.hpp"
+
+#include <libxstream_begin.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <libxstream_end.h>
+
+#if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+
+
+/**
+ * Caching allocator of a device (or the host). Memory is acquired from the system in segments which are handed
+ * out as blocks; a deallocated block remains cached and is merged with adjacent cached blocks of its segment.
+ * A request is rounded up to its size class, and served by the smallest cached block which fits (a block much
+ * larger than the request is split e.g., small requests are carved out of a larger segment). The cache does not
+ * acquire or release memory itself: a miss is served by a segment the caller acquired (insert), and only entirely
+ * cached segments are handed back (trim).
+ * The cache accounts for the allocated memory (statistics), optionally per tag.
+ */
+class libxstream_cache {
+public:
+  /** Cache of the given device (host: -1). */
+  static libxstream_cache& instance(int device);
+  /** Size class of a request i.e., the size acquired if the request misses the cache. */
+  static size_t size_class(size_t size);
+
+public:
+  libxstream_cache();
+  ~libxstream_cache();
+
+public:
+  /** Serves a request from the cache; NULL if the request missed. */
+  void* allocate(size_t size, size_t alignment);
+  /** Adopts a segment acquired after a miss (size_class), and serves the request by the segment. */
+  void* insert(void* segment, size_t segment_size, size_t size);
+  /** Returns the block to the cache; false if the block is not allocated by this cache. */
+  bool deallocate(const void* memory);
+  /** Checks whether the block is allocated by this cache (and receives its size). */
+  bool owns(const void* memory, size_t* size = 0) const;
+  /** Checks whether the address belongs to a segment of this cache (and receives the segment). */
+  bool contains(const void* memory, const void** segment = 0) const;
+  /** Marks the block as pending deallocation (in stream order); returns the number of bytes pending. */
+  size_t defer(const void* memory);
+
+  /** Removes the entirely cached segments (to be released by the caller); returns the number of bytes. */
+  size_t trim(std::vector<void*>& segments);
+
+  size_t hits() const { return m_hits; }
+  size_t misses() const { return m_misses; }
+  /** Number of bytes which are cached i.e., acquired but not allocated. */
+  size_t cached() const { return m_cached; }
+  /** Number of bytes acquired from the system. */
+  size_t acquired() const { return m_acquired; }
+  /** Number of bytes which are allocated but pending deallocation. */
+  size_t deferred() const { return m_deferred; }
+
+  /** Receives the statistics of the allocated memory (the requested sizes rather than the size classes). */
+  void stats(libxstream_mem_statistics& stats) const;
+  /** Attaches the tag to the allocated block (NULL: detach); false if the block is not allocated by this cache. */
+  bool tag(const void* memory, const char* tag);
+  /** Statistics of the i-th tag; false if there is no such tag. */
+  bool tag_stats(size_t i, const char** tag, size_t* live, size_t* nlive) const;
+
+private:
+  libxstream_cache(const libxstream_cache& other);
+  libxstream_cache& operator=(const libxstream_cache& other);
+
+  struct block_type;
+  typedef std::multimap<size_t,block_type*> free_type;
+  typedef std::map<const void*,block_type*> used_type;
+  struct tag_type {
+    explicit tag_type(const char* name): name(name), live(0), nlive(0) {}
+    std::string name;
+    size_t live, nlive;
+  };
+
+  void* use(block_type& block, size_t size, size_t requested);
+  void release(block_type& block);
+
+private:
+  free_type m_free; // cached blocks by size
+  used_type m_used; // allocated blocks by address
+  std::map<const char*,size_t> m_segments; // acquired segments by address
+  std::deque<tag_type> m_tags; // stable references
+  std::map<std::string,size_t> m_tag_index;
+  libxstream_lock* m_lock;
+  size_t m_hits, m_misses, m_cached, m_acquired, m_deferred;
+  size_t m_live, m_peak, m_nallocs, m_histogram[LIBXSTREAM_MEM_NBINS];
+};
+
+#endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+#endif // LIBXSTREAM_CACHE_HPP
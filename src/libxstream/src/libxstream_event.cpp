@@ -33,9 +33,7 @@
 #include "libxstream_workitem.hpp"
 
 #include <libxstream_begin.h>
-#if defined(LIBXSTREAM_STDFEATURES)
-# include <atomic>
-#endif
+#include <algorithm>
 #include <libxstream_end.h>
 
 #if defined(LIBXSTREAM_OFFLOAD) && (0 != LIBXSTREAM_OFFLOAD)
@@ -43,80 +41,30 @@
 #endif
 
 
-libxstream_event::libxstream_event()
-  : m_slots(0)
-#if defined(LIBXSTREAM_STDFEATURES)
-  , m_expected(new std::atomic<size_t>(0))
-#else
-  , m_expected(new size_t(0))
-#endif
-{}
-
-
-libxstream_event::libxstream_event(const libxstream_event& other)
-  : m_slots(other.m_slots ? new slot_type[(LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS)] : 0)
-#if defined(LIBXSTREAM_STDFEATURES)
-  , m_expected(other.m_expected ? new std::atomic<size_t>(static_cast<size_t>(*static_cast<const std::atomic<size_t>*>(other.m_expected))) : 0)
-#else
-  , m_expected(other.m_expected ? new size_t(*static_cast<const size_t*>(other.m_expected)) : 0)
-#endif
+libxstream_event::libxstream_event(bool timed)
+  : m_time(-1), m_timed(timed)
 {
-  if (m_slots) {
-    std::copy(&other.m_slots[0], &other.m_slots[0] + (LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS), &m_slots[0]);
-  }
-}
-
-
-libxstream_event::~libxstream_event()
-{
-  delete[] m_slots;
-#if defined(LIBXSTREAM_STDFEATURES)
-  delete static_cast<std::atomic<size_t>*>(m_expected);
-#else
-  delete static_cast<size_t*>(m_expected);
-#endif
+  m_point.timeline = 0;
+  m_point.ticket = 0;
 }
 
 
 void libxstream_event::swap(libxstream_event& other)
 {
-  std::swap(m_slots, other.m_slots);
-  std::swap(m_expected, other.m_expected);
+  std::swap(m_point, other.m_point);
+  m_points.swap(other.m_points);
+  std::swap(m_time, other.m_time);
+  std::swap(m_timed, other.m_timed);
 }
 
 
 int libxstream_event::record(libxstream_stream& stream, bool reset)
 {
-#if defined(LIBXSTREAM_STDFEATURES)
-  std::atomic<size_t>& expected = *static_cast<std::atomic<size_t>*>(m_expected);
-#else
-  size_t& expected = *static_cast<size_t*>(m_expected);
-#endif
-  LIBXSTREAM_CHECK_CONDITION((LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS) >= expected);
-
-  if (reset) {
-#if defined(LIBXSTREAM_STDFEATURES)
-    expected = 0;
-#elif defined(_OPENMP)
-# if (201107 <= _OPENMP)
-#   pragma omp atomic write
-# else
-#   pragma omp critical
-#   endif
-    expected = 0;
-#else // generic
-    libxstream_lock *const lock = libxstream_lock_get(this);
-    libxstream_lock_acquire(lock);
-    expected = 0;
-    libxstream_lock_release(lock);
-#endif
-  }
-
-  LIBXSTREAM_ASYNC_BEGIN
-  {
-    int& status = LIBXSTREAM_ASYNC_QENTRY.status();
 #if defined(LIBXSTREAM_OFFLOAD)
-    if (0 <= LIBXSTREAM_ASYNC_DEVICE) {
+  if (0 <= stream.device()) { // the completion of a marker observes the pending offload signal
+    LIBXSTREAM_ASYNC_BEGIN
+    {
+      int status = LIBXSTREAM_ERROR_CONDITION;
       if (LIBXSTREAM_ASYNC_READY) {
 #       pragma offload LIBXSTREAM_ASYNC_TARGET_SIGNAL //out(status)
         {
@@ -129,70 +77,73 @@ int libxstream_event::record(libxstream_stream& stream, bool reset)
           status = LIBXSTREAM_ERROR_NONE;
         }
       }
+      LIBXSTREAM_ASYNC_QENTRY.status() = status;
     }
-    else
+    LIBXSTREAM_ASYNC_END(stream, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_EVENT, work);
+  }
 #endif
+  if (m_timed) { // the timestamp is taken before the timeline reaches the ticket
+    m_time = -1;
+    LIBXSTREAM_ASYNC_BEGIN
     {
-      status = LIBXSTREAM_ERROR_NONE;
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (1 < (2*LIBXSTREAM_ASYNC+1)/2)
+      if (!(LIBXSTREAM_ASYNC_READY) && 0 <= LIBXSTREAM_ASYNC_DEVICE) {
+#       pragma offload_wait LIBXSTREAM_ASYNC_TARGET_WAIT
+      }
+#endif
+      *ptr<double,0>() = libxstream_timer();
     }
+    LIBXSTREAM_ASYNC_END(stream, LIBXSTREAM_CALL_DEFAULT, work, &m_time);
+  }
+  const libxstream_workqueue& queue = stream.queue();
+  point_type point;
+  point.timeline = queue.timeline();
+  point.ticket = queue.ticket();
+
+  if (reset || 0 == m_point.timeline) {
+    m_point = point;
+    m_points.clear();
+  }
+  else {
+    m_points.push_back(point);
   }
-  LIBXSTREAM_ASYNC_END(stream, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_EVENT, work);
 
-  if (0 == m_slots) {
-    libxstream_lock *const lock = libxstream_lock_get(this);
-    libxstream_lock_acquire(lock);
+  return LIBXSTREAM_ERROR_NONE;
+}
 
-    if (0 == m_slots) {
-      m_slots = new slot_type[(LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS)];
-      std::fill_n(m_slots, (LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS), slot_type(0));
-    }
 
-    libxstream_lock_release(lock);
+int libxstream_event::query(bool& occurred, const libxstream_stream* exclude) const
+{
+  const void *const excluded = exclude ? exclude->queue().timeline() : 0;
+  occurred = true; // everything "occurred" if nothing is expected
+
+  if (0 != m_point.timeline) {
+    occurred = excluded == m_point.timeline || libxstream_workqueue::reached(m_point.timeline, m_point.ticket);
+    const size_t n = m_points.size();
+    for (size_t i = 0; i < n && occurred; ++i) {
+      const point_type& point = m_points[i];
+      occurred = excluded == point.timeline || libxstream_workqueue::reached(point.timeline, point.ticket);
+    }
   }
-  LIBXSTREAM_ASSERT(0 != m_slots);
-
-#if defined(LIBXSTREAM_STDFEATURES)
-  const size_t slot = ++expected;
-#elif defined(_OPENMP)
-  size_t slot = 0;
-# if (201107 <= _OPENMP)
-# pragma omp atomic capture
-# else
-# pragma omp critical
-# endif
-  slot = ++expected;
-#else // generic
-  size_t slot = 0;
-  libxstream_lock *const lock = libxstream_lock_get(this);
-  libxstream_lock_acquire(lock);
-  slot = ++expected;
-  libxstream_lock_release(lock);
-#endif
-  m_slots[slot-1] = &LIBXSTREAM_ASYNC_INTERNAL(work);
 
   return LIBXSTREAM_ERROR_NONE;
 }
 
 
-int libxstream_event::query(bool& occurred, const libxstream_stream* exclude) const
+int libxstream_event::wait(const libxstream_stream* exclude) const
 {
-#if defined(LIBXSTREAM_STDFEATURES)
-  const size_t expected = *static_cast<const std::atomic<size_t>*>(m_expected);
-#else
-  const size_t expected = *static_cast<const size_t*>(m_expected);
-#endif
-  LIBXSTREAM_ASSERT((LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS) >= expected);
-  LIBXSTREAM_ASSERT(0 == expected || 0 != m_slots);
-  occurred = true; // everythig "occurred" if nothing is expected
+  const void *const excluded = exclude ? exclude->queue().timeline() : 0;
   int result = LIBXSTREAM_ERROR_NONE;
 
-  if (0 != m_slots) {
-    for (size_t i = 0; i < expected; ++i) {
-      const slot_type slot = m_slots[i];
-      const libxstream_workitem *const item = slot ? slot->item() : 0;
-      if ((0 != item && exclude != item->stream()) || LIBXSTREAM_ERROR_NONE != slot->status()) {
-        occurred = false;
-        i = expected; // break
+  if (0 != m_point.timeline) {
+    if (excluded != m_point.timeline) {
+      result = libxstream_workqueue::wait(m_point.timeline, m_point.ticket);
+    }
+    const size_t n = m_points.size();
+    for (size_t i = 0; i < n && LIBXSTREAM_ERROR_NONE == result; ++i) {
+      const point_type& point = m_points[i];
+      if (excluded != point.timeline) {
+        result = libxstream_workqueue::wait(point.timeline, point.ticket);
       }
     }
   }
@@ -202,54 +153,23 @@ int libxstream_event::query(bool& occurred, const libxstream_stream* exclude) co
 }
 
 
-int libxstream_event::wait(const libxstream_stream* exclude, bool any)
+int libxstream_event::time(double& value) const
 {
-#if defined(LIBXSTREAM_STDFEATURES)
-  const size_t expected = *static_cast<std::atomic<size_t>*>(m_expected);
-#else
-  const size_t expected = *static_cast<size_t*>(m_expected);
-#endif
-  LIBXSTREAM_ASSERT((LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS) >= expected);
-  LIBXSTREAM_ASSERT(0 == expected || 0 != m_slots);
-  int result = LIBXSTREAM_ERROR_NONE;
-
-  if (0 != m_slots && 0 < expected) {
-    for (size_t i = 0; i < expected; ++i) {
-      const slot_type slot = m_slots[i];
-      const libxstream_workitem *const item = slot ? slot->item() : 0;
-      if (0 != item && exclude != item->stream()) {
-        result = slot->wait(any, false);
-        LIBXSTREAM_CHECK_ERROR(result);
-        m_slots[i] = 0;
-      }
-    }
+  bool occurred = false;
+  LIBXSTREAM_CHECK_CONDITION(m_timed && 0 != m_point.timeline);
+  LIBXSTREAM_CHECK_CALL(query(occurred));
+  LIBXSTREAM_CHECK_CONDITION(occurred);
+  value = m_time;
+  return LIBXSTREAM_ERROR_NONE;
+}
 
-#if defined(LIBXSTREAM_STDFEATURES)
-    std::atomic<size_t>& expected_dst = *static_cast<std::atomic<size_t>*>(m_expected);
-#else
-    size_t& expected_dst = *static_cast<size_t*>(m_expected);
-#endif
-    LIBXSTREAM_ASSERT(expected == expected_dst);
 
-#if defined(LIBXSTREAM_STDFEATURES)
-    expected_dst = 0;
-#elif defined(_OPENMP)
-# if (201107 <= _OPENMP)
-#   pragma omp atomic write
-# else
-#   pragma omp critical
-#   endif
-    expected_dst = 0;
-#else // generic
-    libxstream_lock *const lock = libxstream_lock_get(this);
-    libxstream_lock_acquire(lock);
-    expected_dst = 0;
-    libxstream_lock_release(lock);
-#endif
+int libxstream_event::reserve(size_t npoints)
+{
+  if (1 < npoints) {
+    m_points.reserve(npoints - 1);
   }
-
-  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
-  return result;
+  return LIBXSTREAM_ERROR_NONE;
 }
 
 
@@ -33,41 +33,54 @@
 
 #include "libxstream_workqueue.hpp"
 
+#include <libxstream_begin.h>
+#include <vector>
+#include <libxstream_end.h>
+
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 
 
+/**
+ * An event is a point on the timeline of a stream i.e., the number of work items which are completed once the
+ * event occurred. Recording into multiple streams (all streams) adds further points. Recording into a single
+ * stream as well as querying such an event is allocation-free, and does not enqueue any work item.
+ */
 struct/*!class*/ libxstream_event {
 public:
-  libxstream_event();
-  libxstream_event(const libxstream_event& other);
-
-  ~libxstream_event();
+  explicit libxstream_event(bool timed = false);
 
 public:
-  libxstream_event& operator=(const libxstream_event& rhs) {
-    libxstream_event tmp(rhs);
-    swap(tmp);
-    return *this;
-  }
-
   void swap(libxstream_event& other);
 
-  // Enqueue this event into the given stream; reset to start over.
+  // Record the work enqueued so far into the given stream; reset to start over.
   int record(libxstream_stream& stream, bool reset);
 
   // Query whether the event already happened or not.
   int query(bool& occurred, const libxstream_stream* exclude = 0) const;
 
   // Wait for the event to happen; optionally exclude events related to a given stream.
-  int wait(const libxstream_stream* exclude, bool any);
+  int wait(const libxstream_stream* exclude = 0) const;
 
   // Wait for the event to happen using a barrier i.e., waiting within the given stream.
   int wait_stream(libxstream_stream* stream);
 
+  // Make room for the given number of records (streams).
+  int reserve(size_t npoints);
+
+  // A timed event takes the time at which the work prior to recording completed (worker).
+  bool timed() const { return m_timed; }
+  // Time (libxstream_timer) of the occurred event; LIBXSTREAM_ERROR_CONDITION if not timed or not occurred.
+  int time(double& value) const;
+
 private:
-  typedef libxstream_workqueue::entry_type* slot_type;
-  slot_type* m_slots;
-  void* m_expected;
+  struct point_type {
+    const void* timeline;
+    size_t ticket;
+  };
+  point_type m_point; // first stream
+  std::vector<point_type> m_points; // further streams
+  double m_time; // written by the worker before the timeline reaches the ticket
+  bool m_timed;
 };
 
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
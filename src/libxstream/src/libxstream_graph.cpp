@@ -0,0 +1,175 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+#include "libxstream_graph.hpp"
+#include "libxstream_workitem.hpp"
+
+#include <libxstream_begin.h>
+#if defined(LIBXSTREAM_STDFEATURES)
+# include <atomic>
+#endif
+#include <libxstream_end.h>
+
+
+/** Nodes of a graph; not modified as long as a launch refers to them. */
+struct libxstream_graph::nodes_type {
+  std::vector<libxstream_workitem*> items;
+#if defined(LIBXSTREAM_STDFEATURES)
+  std::atomic<size_t> nrefs;
+#else
+  volatile size_t nrefs;
+#endif
+
+  nodes_type(): nrefs(1) {}
+
+  ~nodes_type() {
+    const size_t size = items.size();
+    for (size_t i = 0; i < size; ++i) {
+      libxstream_workitem::destroy(items[i], 0);
+    }
+  }
+
+  nodes_type* acquire() {
+#if defined(LIBXSTREAM_STDFEATURES)
+    nrefs.fetch_add(1, std::memory_order_relaxed);
+#else
+    libxstream_lock *const lock = libxstream_lock_get(this);
+    libxstream_lock_acquire(lock);
+    ++nrefs;
+    libxstream_lock_release(lock);
+#endif
+    return this;
+  }
+
+  void release() {
+#if defined(LIBXSTREAM_STDFEATURES)
+    // the last reference observes the work of the other references
+    const bool last = 1 == nrefs.fetch_sub(1, std::memory_order_acq_rel);
+#else
+    libxstream_lock *const lock = libxstream_lock_get(this);
+    libxstream_lock_acquire(lock);
+    const bool last = 0 == --nrefs;
+    libxstream_lock_release(lock);
+#endif
+    if (last) delete this;
+  }
+
+  bool shared() const {
+#if defined(LIBXSTREAM_STDFEATURES)
+    return 1 != nrefs.load(std::memory_order_acquire);
+#else
+    libxstream_lock *const lock = libxstream_lock_get(this);
+    libxstream_lock_acquire(lock);
+    const bool result = 1 != nrefs;
+    libxstream_lock_release(lock);
+    return result;
+#endif
+  }
+};
+
+
+libxstream_graph::libxstream_graph()
+  : m_nodes(new nodes_type)
+  , m_entry(0, 0) // completed
+{}
+
+
+libxstream_graph::~libxstream_graph()
+{
+  m_nodes->release(); // launches in flight keep the nodes alive
+}
+
+
+size_t libxstream_graph::size() const
+{
+  return m_nodes->items.size();
+}
+
+
+libxstream_workqueue::entry_type& libxstream_graph::capture(const libxstream_workitem& workitem)
+{
+  if (0 == ((LIBXSTREAM_CALL_WAIT | LIBXSTREAM_CALL_EVENT | LIBXSTREAM_CALL_LOOP) & workitem.flags())) {
+    m_nodes->items.push_back(workitem.clone(0, 0)); // private copy (heap)
+    m_entry.status() = LIBXSTREAM_ERROR_NONE;
+  }
+  else {
+    m_entry.status() = LIBXSTREAM_ERROR_CONDITION;
+  }
+  return m_entry;
+}
+
+
+int libxstream_graph::arg(size_t node, size_t arg, const void* value)
+{
+  LIBXSTREAM_CHECK_CONDITION(node < m_nodes->items.size());
+
+  if (m_nodes->shared()) { // copy on write i.e., the launches in flight are not affected
+    nodes_type *const nodes = new nodes_type;
+    const size_t size = m_nodes->items.size();
+    nodes->items.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      nodes->items.push_back(m_nodes->items[i]->clone(0, 0));
+    }
+    m_nodes->release();
+    m_nodes = nodes;
+  }
+
+  return m_nodes->items[node]->arg(arg, value);
+}
+
+
+int libxstream_graph::launch(libxstream_stream& stream)
+{
+  LIBXSTREAM_ASYNC_BEGIN
+  {
+    nodes_type& nodes = *ptr<nodes_type,0>();
+    const size_t size = nodes.items.size();
+
+    for (size_t i = 0; i < size && LIBXSTREAM_ERROR_NONE == LIBXSTREAM_ASYNC_QENTRY.status(); ++i) {
+      // the node runs as a copy which is private to this launch (stream, pending signal)
+      union { char data[LIBXSTREAM_WORKITEM_STORAGE]; double value; void* pointer; } storage;
+      libxstream_workitem *const node = nodes.items[i]->clone(storage.data, sizeof(storage));
+      node->run(LIBXSTREAM_ASYNC_QENTRY, LIBXSTREAM_ASYNC_STREAM);
+      if (0 != node->pending()) {
+        pending(node->pending()); // the next node waits for the signal of the previous node
+      }
+      libxstream_workitem::destroy(node, storage.data);
+    }
+    nodes.release();
+  }
+  LIBXSTREAM_ASYNC_END(&stream, LIBXSTREAM_CALL_DEFAULT, work, m_nodes->acquire());
+
+  const int result = work.status();
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
+#endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
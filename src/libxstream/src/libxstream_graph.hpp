@@ -0,0 +1,85 @@
+/******************************************************************************
+** Copyright (c) 2014-2015, Intel Corporation                                **
+** All rights reserved.                                                      **
+**                                                                           **
+** Redistribution and use in source and binary forms, with or without        **
+** modification, are permitted provided that the following conditions        **
+** are met:                                                                  **
+** 1. Redistributions of source code must retain the above copyright         **
+**    notice, this list of conditions and the following disclaimer.          **
+** 2. Redistributions in binary form must reproduce the above copyright      **
+**    notice, this list of conditions and the following disclaimer in the    **
+**    documentation and/or other materials provided with the distribution.   **
+** 3. Neither the name of the copyright holder nor the names of its          **
+**    contributors may be used to endorse or promote products derived        **
+**    from this software without specific prior written permission.          **
+**                                                                           **
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS       **
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT         **
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR     **
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT      **
+** HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,    **
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  **
+** TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR    **
+** PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF    **
+** LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING      **
+** NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS        **
+** SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.              **
+******************************************************************************/
+/* Hans Pabst (Intel Corp.)
+******************************************************************************/
+#ifndef LIBXSTREAM_GRAPH_HPP
+#define LIBXSTREAM_GRAPH_HPP
+
+#include "libxstream_workqueue.hpp"
+
+#include <libxstream_begin.h>
+#include <vector>
+#include <libxstream_end.h>
+
+#if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+
+
+class libxstream_workitem;
+
+
+/**
+ * Work captured from a stream rather than executed (libxstream_stream::begin_capture). The nodes are
+ * private copies of the captured work items, and the graph is launched as a single work item which
+ * executes the nodes in order of capture. A launch executes on behalf of the stream it is enqueued into.
+ * A launch refers to the nodes as they were when it was enqueued (patching copies the nodes if a launch
+ * is still in flight), and it runs a copy of each node i.e., launches can overlap and outlive the graph.
+ */
+struct/*!class*/ libxstream_graph {
+public:
+  libxstream_graph();
+  ~libxstream_graph();
+
+public:
+  size_t size() const;
+
+  /**
+   * Records a copy of the work item. The returned entry is already completed, and its status tells
+   * whether the item could be captured; work which is waited for or which refers to its queue entry
+   * (synchronous calls, events) cannot be replayed.
+   */
+  libxstream_workqueue::entry_type& capture(const libxstream_workitem& workitem);
+
+  /** Replaces an argument of the given node (see libxstream_workitem::arg). */
+  int arg(size_t node, size_t arg, const void* value);
+
+  /** Enqueues the entire graph into the stream (one work item). */
+  int launch(libxstream_stream& stream);
+
+private:
+  libxstream_graph(const libxstream_graph& other);
+  libxstream_graph& operator=(const libxstream_graph& other);
+
+private:
+  struct nodes_type;
+  nodes_type* m_nodes; // shared with the launches in flight
+  libxstream_workqueue::entry_type m_entry;
+};
+
+#endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
+#endif // LIBXSTREAM_GRAPH_HPP
@@ -36,6 +36,7 @@
 
 #include <libxstream_begin.h>
 #include <algorithm>
+#include <vector>
 #include <libxstream_end.h>
 
 
@@ -64,7 +65,10 @@ LIBXSTREAM_TARGET(mic) void call(libxstream_function function, libxstream_argume
 
   libxstream_context& context = libxstream_context::instance(arguments, flags);
 
-  switch (arity) {
+  if (0 != (LIBXSTREAM_CALL_PACKED & flags)) { // any arity
+    function(static_cast<const libxstream_argument*>(arguments));
+  }
+  else switch (arity) {
     case  0: function(); break;
     case  1: function(a[0]); break;
     case  2: function(a[0], a[1]); break;
@@ -114,22 +118,33 @@ libxstream_workqueue::entry_type& libxstream_offload(libxstream_function functio
       reinterpret_cast<unsigned long long>(signature), static_cast<unsigned long>(arity), cflags);
     LIBXSTREAM_PRINT0(3, "************************************************************************");
 
+    if ((LIBXSTREAM_MAX_NARGS) < arity && 0 == (LIBXSTREAM_CALL_PACKED & cflags)) { // positional arguments
+      LIBXSTREAM_ASYNC_QENTRY.status() = LIBXSTREAM_ERROR_CONDITION;
+    }
+    else
 #if defined(LIBXSTREAM_OFFLOAD)
     if (0 <= LIBXSTREAM_ASYNC_DEVICE) {
       char* p[(LIBXSTREAM_MAX_NARGS)];
+      std::vector<char*> q; // packed call: arrays beyond LIBXSTREAM_MAX_NARGS pointers
       unsigned int s = 0;
       LIBXSTREAM_ASSERT(LIBXSTREAM_MAX_NARGS <= 8 * sizeof(s));
+      bool translatable = true;
       size_t np = 0;
       LIBXSTREAM_PRAGMA_LOOP_COUNT(0, LIBXSTREAM_MAX_NARGS, LIBXSTREAM_MAX_NARGS/2)
       for (size_t i = 0; i < arity; ++i) {
         if (char *const pointer = reinterpret_cast<char*>(m_signature[i].data.pointer)) {
           if (0 != m_signature[i].dims) {
-            p[np] = pointer;
+            if ((LIBXSTREAM_MAX_NARGS) > np) p[np] = pointer; else q.push_back(pointer);
             ++np;
           }
           else if (0 != (libxstream_argument::kind_output & m_signature[i].kind)) {
-            p[np] = pointer;
-            s |= ((2 << np) >> 1);
+            if ((LIBXSTREAM_MAX_NARGS) > np) {
+              p[np] = pointer;
+              s |= ((2 << np) >> 1);
+            }
+            else { // an elemental output is transferred back, and hence it must be among the first pointers
+              translatable = false;
+            }
             ++np;
           }
         }
@@ -506,7 +521,41 @@ libxstream_workqueue::entry_type& libxstream_offload(libxstream_function functio
             }
           }
         } break;
-        default: {
+        default: if (translatable) { // packed call: the remaining pointers are translated as an array of pointers
+          char *a0 = p[0], *a1 = p[1],  *a2 = p[2],   *a3 = p[3],   *a4 = p[4],   *a5 = p[5],   *a6 = p[6],   *a7 = p[7];
+          char *a8 = p[8], *a9 = p[9], *a10 = p[10], *a11 = p[11], *a12 = p[12], *a13 = p[13], *a14 = p[14], *a15 = p[15];
+          char* *const aq = &q[0];
+          const size_t nq = q.size();
+          if (0 == (LIBXSTREAM_ASYNC_PENDING)) {
+#           pragma offload LIBXSTREAM_ASYNC_TARGET_SIGNAL in(fhybrid, fnative, arity, cflags, nq) in(signature: length(arity + 1)) \
+              LIBXSTREAM_OFFLOAD_DATA( a0, s&1)    LIBXSTREAM_OFFLOAD_DATA( a1, s&2)    LIBXSTREAM_OFFLOAD_DATA( a2, s&4)     LIBXSTREAM_OFFLOAD_DATA( a3, s&8)    \
+              LIBXSTREAM_OFFLOAD_DATA( a4, s&16)   LIBXSTREAM_OFFLOAD_DATA( a5, s&32)   LIBXSTREAM_OFFLOAD_DATA( a6, s&64)    LIBXSTREAM_OFFLOAD_DATA( a7, s&128)  \
+              LIBXSTREAM_OFFLOAD_DATA( a8, s&256)  LIBXSTREAM_OFFLOAD_DATA( a9, s&512)  LIBXSTREAM_OFFLOAD_DATA(a10, s&1024)  LIBXSTREAM_OFFLOAD_DATA(a11, s&2048) \
+              LIBXSTREAM_OFFLOAD_DATA(a12, s&4096) LIBXSTREAM_OFFLOAD_DATA(a13, s&8192) LIBXSTREAM_OFFLOAD_DATA(a14, s&16384) LIBXSTREAM_OFFLOAD_DATA(a15, s&32768) \
+              in(aq[0:nq]: length(0) alloc_if(0) free_if(0))
+            {
+              char* head[] = { a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15 };
+              std::vector<char*> translation(head, head + sizeof(head) / sizeof(*head));
+              translation.insert(translation.end(), aq, aq + nq);
+              libxstream_offload_internal::call(fhybrid ? fhybrid : reinterpret_cast<libxstream_function>(fnative), signature, &translation[0], arity, cflags);
+            }
+          }
+          else {
+#           pragma offload LIBXSTREAM_ASYNC_TARGET_SIGNAL_WAIT in(fhybrid, fnative, arity, cflags, nq) in(signature: length(arity + 1)) \
+              LIBXSTREAM_OFFLOAD_DATA( a0, s&1)    LIBXSTREAM_OFFLOAD_DATA( a1, s&2)    LIBXSTREAM_OFFLOAD_DATA( a2, s&4)     LIBXSTREAM_OFFLOAD_DATA( a3, s&8)    \
+              LIBXSTREAM_OFFLOAD_DATA( a4, s&16)   LIBXSTREAM_OFFLOAD_DATA( a5, s&32)   LIBXSTREAM_OFFLOAD_DATA( a6, s&64)    LIBXSTREAM_OFFLOAD_DATA( a7, s&128)  \
+              LIBXSTREAM_OFFLOAD_DATA( a8, s&256)  LIBXSTREAM_OFFLOAD_DATA( a9, s&512)  LIBXSTREAM_OFFLOAD_DATA(a10, s&1024)  LIBXSTREAM_OFFLOAD_DATA(a11, s&2048) \
+              LIBXSTREAM_OFFLOAD_DATA(a12, s&4096) LIBXSTREAM_OFFLOAD_DATA(a13, s&8192) LIBXSTREAM_OFFLOAD_DATA(a14, s&16384) LIBXSTREAM_OFFLOAD_DATA(a15, s&32768) \
+              in(aq[0:nq]: length(0) alloc_if(0) free_if(0))
+            {
+              char* head[] = { a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15 };
+              std::vector<char*> translation(head, head + sizeof(head) / sizeof(*head));
+              translation.insert(translation.end(), aq, aq + nq);
+              libxstream_offload_internal::call(fhybrid ? fhybrid : reinterpret_cast<libxstream_function>(fnative), signature, &translation[0], arity, cflags);
+            }
+          }
+        }
+        else {
           LIBXSTREAM_ASYNC_QENTRY.status() = LIBXSTREAM_ERROR_CONDITION;
         }
       }
@@ -517,9 +566,38 @@ libxstream_workqueue::entry_type& libxstream_offload(libxstream_function functio
       libxstream_offload_internal::call(fhybrid ? fhybrid : ((libxstream_function)fnative), signature, 0, arity, cflags);
     }
   }
-  LIBXSTREAM_ASYNC_END(stream, flags & ~LIBXSTREAM_CALL_WAIT, work, function, signature);
+  LIBXSTREAM_ASYNC_END(stream, flags, work, function, signature);
 
   return LIBXSTREAM_ASYNC_INTERNAL(work);
 }
 
+
+libxstream_plan::libxstream_plan(libxstream_function function, const libxstream_argument signature[], int flags)
+  : m_function(function)
+  , m_arity(0)
+  , m_flags(flags)
+{
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_get_arity(signature, &m_arity));
+  LIBXSTREAM_ASSERT(m_arity <= (LIBXSTREAM_MAX_NARGS) || 0 != (LIBXSTREAM_CALL_PACKED & flags));
+  m_signature.assign(signature, signature + m_arity);
+  m_signature.resize(m_arity + 1);
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_construct(&m_signature[0], m_arity, libxstream_argument::kind_invalid, 0, LIBXSTREAM_TYPE_INVALID, 0, 0));
+}
+
+
+int libxstream_plan::arg(size_t arg, const void* value)
+{
+  LIBXSTREAM_CHECK_CONDITION(arg < m_arity);
+  return libxstream_set_value(m_signature[arg], value);
+}
+
+
+int libxstream_plan::call(libxstream_stream* stream) const
+{
+  const libxstream_workqueue::entry_type& work = libxstream_offload(m_function, &m_signature[0], stream, m_flags);
+  const int result = 0 == (LIBXSTREAM_CALL_WAIT & m_flags) ? work.status() : work.wait();
+  LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
+  return result;
+}
+
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
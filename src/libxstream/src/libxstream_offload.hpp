@@ -32,11 +32,42 @@
 #define LIBXSTREAM_OFFLOAD_HPP
 
 #include "libxstream_workqueue.hpp"
+#include "libxstream_argument.hpp"
+
+#include <libxstream_begin.h>
+#include <vector>
+#include <libxstream_end.h>
 
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 
 
 libxstream_workqueue::entry_type& libxstream_offload(libxstream_function function, const libxstream_argument signature[], libxstream_stream* stream, int flags);
 
+
+/**
+ * Call of a function with a signature which is frozen once (libxstream_fn_plan). A call only patches the values
+ * of the arguments; the signature is not constructed again, and it is copied into the work item as usual.
+ */
+struct/*!class*/ libxstream_plan {
+public:
+  libxstream_plan(libxstream_function function, const libxstream_argument signature[], int flags);
+
+public:
+  size_t arity() const { return m_arity; }
+  int flags() const { return m_flags; }
+
+  /** Replaces the value of an argument in the same way as libxstream_fn_input (by-value or by-pointer). */
+  int arg(size_t arg, const void* value);
+
+  /** Enqueues the call into the stream; the plan can be patched again right after. */
+  int call(libxstream_stream* stream) const;
+
+private:
+  std::vector<libxstream_argument> m_signature; // any arity (LIBXSTREAM_CALL_PACKED)
+  libxstream_function m_function;
+  size_t m_arity;
+  int m_flags;
+};
+
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 #endif // LIBXSTREAM_OFFLOAD_HPP
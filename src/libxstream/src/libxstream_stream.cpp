@@ -33,10 +33,12 @@
 #include "libxstream_workqueue.hpp"
 #include "libxstream_workitem.hpp"
 #include "libxstream_event.hpp"
+#include "libxstream_graph.hpp"
 
 #include <libxstream_begin.h>
 #include <algorithm>
 #include <string>
+#include <vector>
 #include <cstdio>
 #if defined(LIBXSTREAM_STDFEATURES)
 # include <atomic>
@@ -49,124 +51,134 @@
 
 namespace libxstream_stream_internal {
 
+/**
+ * Streams which are alive, organized in one list per device (index 0 designates the host). Inserting
+ * and removing a stream is O(1) i.e., a removed stream is replaced by the last stream of its list.
+ * Iterating the streams of a device scales with the number of live streams rather than a capacity.
+ */
 static/*IPO*/ class registry_type {
 public:
   typedef libxstream_stream* value_type;
+  typedef std::vector<value_type> list_type;
 
 public:
   registry_type()
-    : m_istreams(0)
+    : m_lock(libxstream_lock_create())
   {
-    std::fill_n(m_signals, LIBXSTREAM_MAX_NDEVICES, 0);
-    std::fill_n(m_streams, (LIBXSTREAM_MAX_NDEVICES) * (LIBXSTREAM_MAX_NSTREAMS), static_cast<value_type>(0));
+    std::fill_n(m_signals, (LIBXSTREAM_MAX_NDEVICES) + 1, 0);
+    for (size_t i = 0; i <= (LIBXSTREAM_MAX_NDEVICES); ++i) {
+      m_streams[i].reserve(LIBXSTREAM_MAX_NSTREAMS);
+    }
   }
 
   ~registry_type() {
-    const size_t n = max_nstreams();
-    for (size_t i = 0; i < n; ++i) {
+    for (size_t i = 0; i <= (LIBXSTREAM_MAX_NDEVICES); ++i) {
+      while (!m_streams[i].empty()) { // destroying a stream removes it from the list
+        value_type stream = m_streams[i].back();
+        if (0 != stream->m_owner) stream = stream->m_owner; // stripes are destroyed by their owner
 #if defined(LIBXSTREAM_DEBUG)
-      if (0 != m_streams[i]) {
-        LIBXSTREAM_PRINT(1, "stream=0x%llx (%s) is dangling!", reinterpret_cast<unsigned long long>(m_streams[i]), m_streams[i]->name());
-      }
+        LIBXSTREAM_PRINT(1, "stream=0x%llx (%s) is dangling!", reinterpret_cast<unsigned long long>(stream), stream->name());
 #endif
-      libxstream_stream_destroy(m_streams[i]);
+        libxstream_stream_destroy(stream);
+      }
     }
+    libxstream_lock_destroy(m_lock);
   }
 
 public:
   size_t priority_range(int device, int& least, int& greatest) {
-    const size_t n = max_nstreams();
+    libxstream_lock_acquire(m_lock);
+    const list_type& streams = list(device);
+    const size_t n = streams.size();
     for (size_t i = 0; i < n; ++i) {
-      if (const value_type stream = m_streams[i]) {
-        const int stream_device = stream->device();
-        if (stream_device == device) {
-          const int priority = stream->priority();
-          least = std::min(least, priority);
-          greatest = std::max(least, priority);
-        }
-      }
+      const int priority = streams[i]->priority();
+      least = std::min(least, priority);
+      greatest = std::max(least, priority);
     }
     size_t result = 0;
     for (size_t i = 0; i < n; ++i) {
-      if (const value_type stream = m_streams[i]) {
-        const int stream_device = stream->device();
-        if (stream_device == device) {
-          const int priority = stream->priority();
-          result += priority - greatest;
-        }
-      }
+      const int priority = streams[i]->priority();
+      result += priority - greatest;
     }
+    libxstream_lock_release(m_lock);
     return result;
   }
 
-  volatile value_type& allocate() {
-#if !defined(LIBXSTREAM_STDFEATURES)
-    libxstream_lock *const lock = libxstream_lock_get(this);
-    libxstream_lock_acquire(lock);
-#endif
-    volatile value_type* i = m_streams + LIBXSTREAM_MOD(m_istreams++, (LIBXSTREAM_MAX_NDEVICES) * (LIBXSTREAM_MAX_NSTREAMS));
-    while (0 != *i) i = m_streams + LIBXSTREAM_MOD(m_istreams++, (LIBXSTREAM_MAX_NDEVICES) * (LIBXSTREAM_MAX_NSTREAMS));
-#if !defined(LIBXSTREAM_STDFEATURES)
-    libxstream_lock_release(lock);
-#endif
-    return *i;
+  void insert(libxstream_stream& stream) {
+    libxstream_lock_acquire(m_lock);
+    list_type& streams = list(stream.device());
+    stream.m_index = streams.size();
+    streams.push_back(&stream);
+    libxstream_lock_release(m_lock);
+  }
+
+  void remove(libxstream_stream& stream) {
+    libxstream_lock_acquire(m_lock);
+    list_type& streams = list(stream.device());
+    LIBXSTREAM_ASSERT(stream.m_index < streams.size() && &stream == streams[stream.m_index]);
+    const value_type last = streams.back();
+    streams[stream.m_index] = last;
+    last->m_index = stream.m_index;
+    streams.pop_back();
+    libxstream_lock_release(m_lock);
   }
 
-  size_t max_nstreams() const {
-    return std::min<size_t>(m_istreams, (LIBXSTREAM_MAX_NDEVICES) * (LIBXSTREAM_MAX_NSTREAMS));
+  /** Returns the i-th stripe of the stream, or publishes the given stripe unless another stripe was published before. */
+  value_type stripe(libxstream_stream& stream, size_t i, value_type stripe) {
+    LIBXSTREAM_ASSERT(i < (LIBXSTREAM_STRIPE_NSTREAMS));
+    libxstream_lock_acquire(m_lock);
+    if (0 == stream.m_stripes[i]) stream.m_stripes[i] = stripe;
+    const value_type result = stream.m_stripes[i];
+    libxstream_lock_release(m_lock);
+    return result;
   }
 
-  size_t nstreams(int device, const libxstream_stream* end = 0) const {
-    const size_t n = max_nstreams();
+  size_t nstripes(const libxstream_stream& stream) const {
     size_t result = 0;
-    if (0 == end) {
-      for (size_t i = 0; i < n; ++i) {
-        const value_type stream = m_streams[i];
-        result += (0 != stream && stream->device() == device) ? 1 : 0;
-      }
-    }
-    else {
-      for (size_t i = 0; i < n; ++i) {
-        const value_type stream = m_streams[i];
-        if (end != stream) {
-          result += (0 != stream && stream->device() == device) ? 1 : 0;
-        }
-        else {
-          i = n; // break
-        }
-      }
-    }
+    libxstream_lock_acquire(m_lock);
+    while (result < (LIBXSTREAM_STRIPE_NSTREAMS) && 0 != stream.m_stripes[result]) ++result;
+    libxstream_lock_release(m_lock);
+    return result;
+  }
+
+  size_t nstreams(int device) const {
+    libxstream_lock_acquire(m_lock);
+    const size_t result = list(device).size();
+    libxstream_lock_release(m_lock);
     return result;
   }
 
   size_t nstreams() const {
-    const size_t n = max_nstreams();
-    size_t result = 0;
-    for (size_t i = 0; i < n; ++i) {
-      const value_type stream = m_streams[i];
-      result += 0 != stream ? 1 : 0;
-    }
+    libxstream_lock_acquire(m_lock);
+    const size_t result = nstreams_locked();
+    libxstream_lock_release(m_lock);
     return result;
   }
 
   libxstream_signal signal(int device) {
-    LIBXSTREAM_ASSERT(-1 <= device && device <= LIBXSTREAM_MAX_NDEVICES);
+    LIBXSTREAM_ASSERT(-1 <= device && device < LIBXSTREAM_MAX_NDEVICES);
+#if defined(LIBXSTREAM_STDFEATURES)
     return ++m_signals[device+1];
-  }
-
-  volatile value_type* streams() {
-    return m_streams;
+#else // signals are generated by multiple workers
+    libxstream_lock_acquire(m_lock);
+    const libxstream_signal result = ++m_signals[device+1];
+    libxstream_lock_release(m_lock);
+    return result;
+#endif
   }
 
   int enqueue(libxstream_event& event, const libxstream_stream* exclude) {
     int result = LIBXSTREAM_ERROR_NONE;
-    const size_t n = max_nstreams();
+    list_type streams;
+    snapshot(streams);
+    const size_t n = streams.size();
     bool reset = true;
+    LIBXSTREAM_CHECK_CALL(event.reserve(n));
 
     for (size_t i = 0; i < n; ++i) {
-      const value_type stream = m_streams[i];
+      const value_type stream = streams[i];
 
-      if (stream != exclude) {
+      if (stream != exclude && !stream->capturing()) {
         result = event.record(*stream, reset);
         LIBXSTREAM_CHECK_ERROR(result);
         reset = false;
@@ -177,54 +189,31 @@ public:
     return result;
   }
 
-  value_type schedule(const libxstream_stream* exclude) {
-    const size_t n = max_nstreams();
-    size_t start = 0, offset = 0;
-
-    if (0 != exclude) {
-      for (size_t i = 0; i < n; ++i) {
-        if (m_streams[i] == exclude) {
-          start = i;
-          offset = 1;
-          i = n; // break
-        }
-      }
-    }
-
-    const size_t end = start + n;
-    value_type result = 0;
-
-    for (size_t i = start + offset; i < end; ++i) {
-      const value_type stream = m_streams[/*i%n*/i<n?i:(i-n)]; // round-robin
-      if (0 != stream) {
-        result = stream;
-        i = end; // break
-      }
-    }
-
-    return result;
-  }
-
+  /**
+   * Waits for the work in flight (counted per device) rather than visiting every stream i.e., the wait
+   * also covers work which is enqueued concurrently, and work of the global queue (any device).
+   */
   int wait_all(int device, bool any) {
     int result = LIBXSTREAM_ERROR_NONE;
-    const size_t n = max_nstreams();
-
-    if (0 < n) {
-      size_t i = 0;
-      do {
-        if (const value_type stream = m_streams[i]) {
-          const int stream_device = stream->device();
-          if (stream_device == device) {
-            result = stream->wait(any);
-            LIBXSTREAM_CHECK_ERROR(result);
-          }
-        }
-        ++i;
+
+    if (any) {
+      result = libxstream_inflight_wait(device);
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (1 < (2*LIBXSTREAM_ASYNC+1)/2)
+      // completed work items might still carry a pending offload signal
+      if (LIBXSTREAM_ERROR_NONE == result) {
+        result = wait_streams(device, any);
       }
-      while(i < n);
+#endif
     }
     else {
-      result = wait_all(any);
+      list_type streams;
+      snapshot(streams, device);
+      if (!streams.empty()) {
+        result = wait_streams(streams, any);
+      }
+      else {
+        result = wait_all(any);
+      }
     }
 
     LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
@@ -233,18 +222,21 @@ public:
 
   int wait_all(bool any) {
     int result = LIBXSTREAM_ERROR_NONE;
-    const size_t n = max_nstreams();
-
-    if (0 < n) {
-      size_t i = 0;
-      do {
-        if (const value_type stream = m_streams[i]) {
-          result = stream->wait(any);
-          LIBXSTREAM_CHECK_ERROR(result);
-        }
-        ++i;
-      }
-      while(i < n);
+
+    if (any) {
+      result = libxstream_inflight_wait(-2);
+      LIBXSTREAM_CHECK_ERROR(result);
+#if !defined(LIBXSTREAM_OFFLOAD) || !defined(LIBXSTREAM_ASYNC) || (1 >= (2*LIBXSTREAM_ASYNC+1)/2)
+      return result;
+#endif
+      // completed work items might still carry a pending offload signal
+    }
+
+    list_type streams;
+    snapshot(streams);
+
+    if (!streams.empty()) {
+      result = wait_streams(streams, any);
     }
     else {
       LIBXSTREAM_ASYNC_BEGIN
@@ -264,13 +256,69 @@ public:
   }
 
 private:
-  volatile value_type m_streams[(LIBXSTREAM_MAX_NDEVICES)*(LIBXSTREAM_MAX_NSTREAMS)];
-  libxstream_signal m_signals[(LIBXSTREAM_MAX_NDEVICES)+1];
+  int wait_streams(const list_type& streams, bool any) const {
+    int result = LIBXSTREAM_ERROR_NONE;
+    const size_t n = streams.size();
+    for (size_t i = 0; i < n; ++i) {
+      result = streams[i]->wait(any);
+      LIBXSTREAM_CHECK_ERROR(result);
+    }
+    return result;
+  }
+
+#if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (1 < (2*LIBXSTREAM_ASYNC+1)/2)
+  int wait_streams(int device, bool any) const {
+    list_type streams;
+    snapshot(streams, device);
+    return wait_streams(streams, any);
+  }
+#endif
+
+  /**
+   * Copies the streams of the given device (all devices if the device is less than -1). Enqueuing
+   * might execute work, and waiting can block, hence it happens without holding the lock of the registry.
+   */
+  void snapshot(list_type& streams, int device = -2) const {
+    libxstream_lock_acquire(m_lock);
+    if (-1 <= device) {
+      streams = list(device);
+    }
+    else {
+      streams.reserve(nstreams_locked());
+      for (size_t i = 0; i <= (LIBXSTREAM_MAX_NDEVICES); ++i) {
+        streams.insert(streams.end(), m_streams[i].begin(), m_streams[i].end());
+      }
+    }
+    libxstream_lock_release(m_lock);
+  }
+
+  size_t nstreams_locked() const {
+    size_t result = 0;
+    for (size_t i = 0; i <= (LIBXSTREAM_MAX_NDEVICES); ++i) {
+      result += m_streams[i].size();
+    }
+    return result;
+  }
+
+  list_type& list(int device) {
+    LIBXSTREAM_ASSERT(-1 <= device && device < LIBXSTREAM_MAX_NDEVICES);
+    return m_streams[device+1];
+  }
+
+  const list_type& list(int device) const {
+    LIBXSTREAM_ASSERT(-1 <= device && device < LIBXSTREAM_MAX_NDEVICES);
+    return m_streams[device+1];
+  }
+
+private:
+  list_type m_streams[(LIBXSTREAM_MAX_NDEVICES)+1];
 #if defined(LIBXSTREAM_STDFEATURES)
-  std::atomic<size_t> m_istreams;
+  std::atomic<libxstream_signal> m_signals[(LIBXSTREAM_MAX_NDEVICES)+1];
 #else
-  size_t m_istreams;
+  libxstream_signal m_signals[(LIBXSTREAM_MAX_NDEVICES)+1];
 #endif
+  // guards the lists (and the signals if there are no atomics)
+  libxstream_lock* m_lock;
 } registry;
 
 } // namespace libxstream_stream_internal
@@ -280,8 +328,8 @@ private:
 {
 #if defined(LIBXSTREAM_OFFLOAD) && (0 != LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (3 == (2*LIBXSTREAM_ASYNC+1)/2)
   const int result = LIBXSTREAM_MAX_NTHREADS;
-#else // not supported (empty range)
-  const int result = 0;
+#else // priority of the host-side scheduling
+  const int result = (LIBXSTREAM_NPRIORITIES) - 1;
 #endif
   return result;
 }
@@ -291,22 +339,23 @@ private:
 {
 #if defined(LIBXSTREAM_OFFLOAD) && (0 != LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (3 == (2*LIBXSTREAM_ASYNC+1)/2)
   const int result = 0;
-#else // not supported (empty range)
+#else // priority of the host-side scheduling
   const int result = 0;
 #endif
   return result;
 }
 
 
-/*static*/int libxstream_stream::enqueue(libxstream_event& event, const libxstream_stream* exclude)
+/*static*/int libxstream_stream::priority_default()
 {
-  return libxstream_stream_internal::registry.enqueue(event, exclude);
+  const int priority_least = priority_range_least(), priority_greatest = priority_range_greatest();
+  return priority_greatest + (priority_least - priority_greatest) / 2;
 }
 
 
-/*static*/libxstream_stream* libxstream_stream::schedule(const libxstream_stream* exclude)
+/*static*/int libxstream_stream::enqueue(libxstream_event& event, const libxstream_stream* exclude)
 {
-  return libxstream_stream_internal::registry.schedule(exclude);
+  return libxstream_stream_internal::registry.enqueue(event, exclude);
 }
 
 
@@ -323,12 +372,13 @@ private:
 
 
 libxstream_stream::libxstream_stream(int device, int priority, const char* name)
-  : m_device(device), m_priority(priority)
+  : m_queue(device), m_lock(libxstream_lock_create()), m_capture(0), m_owner(0), m_index(0), m_device(device), m_priority(priority)
 #if defined(LIBXSTREAM_OFFLOAD) && defined(LIBXSTREAM_ASYNC) && (3 == (2*LIBXSTREAM_ASYNC+1)/2)
   , m_handle(0) // lazy creation
   , m_npartitions(0)
 #endif
 {
+  std::fill_n(m_stripes, LIBXSTREAM_STRIPE_NSTREAMS, static_cast<libxstream_stream*>(0));
   // sanitize the stream priority
   const int priority_least = priority_range_least(), priority_greatest = priority_range_greatest();
   m_priority = std::max(priority_greatest, std::min(priority_least, priority));
@@ -347,21 +397,25 @@ libxstream_stream::libxstream_stream(int device, int priority, const char* name)
   libxstream_use_sink(name);
 #endif
 
-  using namespace libxstream_stream_internal;
-  volatile registry_type::value_type& entry = libxstream_stream_internal::registry.allocate();
-  entry = this;
+  libxstream_stream_internal::registry.insert(*this);
 }
 
 
 libxstream_stream::~libxstream_stream()
 {
   LIBXSTREAM_CHECK_CALL_ASSERT(wait(true));
+  delete m_capture; // unfinished capture
+  for (size_t i = 0; i < (LIBXSTREAM_STRIPE_NSTREAMS); ++i) {
+    delete m_stripes[i]; // waits for chunks which are not joined
+  }
+
+  libxstream_stream_internal::registry.remove(*this);
 
-  using namespace libxstream_stream_internal;
-  volatile registry_type::value_type *const end = registry.streams() + registry.max_nstreams();
-  volatile registry_type::value_type *const stream = std::find(registry.streams(), end, this);
-  LIBXSTREAM_ASSERT(stream != end);
-  *stream = 0; // unregister stream
+  // a worker may still hold the stream (or take it from the ready list)
+  while (m_queue.listed()) this_thread_yield();
+  libxstream_lock_acquire(m_lock);
+  libxstream_lock_release(m_lock);
+  libxstream_lock_destroy(m_lock);
 
 #if defined(LIBXSTREAM_OFFLOAD) && (0 != LIBXSTREAM_OFFLOAD) && !defined(__MIC__) && defined(LIBXSTREAM_ASYNC) && (3 == (2*LIBXSTREAM_ASYNC+1)/2)
   if (0 != m_handle) {
@@ -374,16 +428,78 @@ libxstream_stream::~libxstream_stream()
 libxstream_workqueue::entry_type& libxstream_stream::enqueue(libxstream_workitem& workitem)
 {
   LIBXSTREAM_ASSERT(this == workitem.stream());
+  if (0 != m_capture) {
+    return m_capture->capture(workitem);
+  }
+
   libxstream_workqueue::entry_type& entry = m_queue.allocate_entry_mt();
   entry.push(workitem);
+  if (m_queue.enlist()) {
+    libxstream_dispatch(this, entry);
+  }
   return entry;
 }
 
 
+int libxstream_stream::begin_capture()
+{
+  LIBXSTREAM_CHECK_CONDITION(0 == m_capture);
+  LIBXSTREAM_CHECK_CALL(wait(true));
+  m_capture = new libxstream_graph;
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+libxstream_graph* libxstream_stream::end_capture()
+{
+  libxstream_graph *const result = m_capture;
+  m_capture = 0;
+  return result;
+}
+
+
+libxstream_stream* libxstream_stream::stripe(size_t i)
+{
+  LIBXSTREAM_ASSERT(0 == m_owner);
+  libxstream_stream* result = libxstream_stream_internal::registry.stripe(*this, i, 0);
+
+  if (0 == result) {
+    char name[32];
+    LIBXSTREAM_SNPRINTF(name, sizeof(name), "stripe %i", static_cast<int>(i + 1));
+    libxstream_stream *const stripe = new libxstream_stream(m_device, m_priority, name);
+    stripe->m_owner = this;
+    result = libxstream_stream_internal::registry.stripe(*this, i, stripe);
+    if (result != stripe) { // another thread published a stripe meanwhile
+      delete stripe;
+    }
+  }
+
+  return result;
+}
+
+
+size_t libxstream_stream::nstripes() const
+{
+  return libxstream_stream_internal::registry.nstripes(*this);
+}
+
+
+void libxstream_stream::claim()
+{
+  libxstream_lock_acquire(m_lock);
+}
+
+
+void libxstream_stream::release()
+{
+  libxstream_lock_release(m_lock);
+}
+
+
 int libxstream_stream::wait(bool any)
 {
   int result = LIBXSTREAM_ERROR_NONE;
-  const libxstream_workqueue::entry_type *const entry = work();
+  const libxstream_workqueue::entry_type *const entry = 0 == m_capture ? work() : 0;
 
   if (0 != entry && entry->item()) { // pending work
     LIBXSTREAM_ASYNC_BEGIN
@@ -444,7 +560,7 @@ _Offload_stream libxstream_stream::handle() const
     const size_t priority_range_device = priority_least_device - priority_greatest_device;
     LIBXSTREAM_ASSERT(priority_sum <= priority_range_device);
 
-    const size_t istream = libxstream_stream_internal::registry.nstreams(m_device, this); // index
+    const size_t istream = m_index; // position among the streams of the device
     const size_t denominator = 0 == priority_range_device ? nstreams : (priority_range_device - priority_sum);
     const size_t nthreads = (0 == priority_range_device ? nthreads_total : (priority_range_device - (m_priority - priority_greatest_device))) / denominator;
     const size_t remainder = nthreads_total - nthreads * denominator;
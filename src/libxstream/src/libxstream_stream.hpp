@@ -42,15 +42,18 @@
 
 class libxstream_workitem;
 struct libxstream_event;
+struct libxstream_graph;
+namespace libxstream_stream_internal { class registry_type; }
 
 
 struct/*!class*/ libxstream_stream {
 public:
   static int priority_range_least();
   static int priority_range_greatest();
+  /** Middle of the range i.e., a stream can be created with a greater as well as with a lower priority. */
+  static int priority_default();
 
   static int enqueue(libxstream_event& event, const libxstream_stream* exclude = 0);
-  static libxstream_stream* schedule(const libxstream_stream* exclude);
 
   static int wait_all(int device, bool any);
   static int wait_all(bool any);
@@ -63,11 +66,37 @@ public:
   const libxstream_workqueue::entry_type* work() const { return m_queue.front(); }
   libxstream_workqueue::entry_type* work() { return m_queue.front(); }
 
+  const libxstream_workqueue& queue() const { return m_queue; }
+  libxstream_workqueue& queue() { return m_queue; }
+
   int device() const    { return m_device; }
   int priority() const  { return m_priority; }
 
   libxstream_workqueue::entry_type& enqueue(libxstream_workitem& workitem);
 
+  /**
+   * Completes the pending work, and records the subsequently enqueued work into a graph instead
+   * of executing it. Ending the capture hands over the graph to the caller (libxstream_graph_launch).
+   */
+  int begin_capture();
+  libxstream_graph* end_capture();
+  bool capturing() const { return 0 != m_capture; }
+
+  /**
+   * Returns the i-th stream which carries the chunks of a striped copy enqueued into this stream. The stripes
+   * are created on demand with the device and the priority of this stream, and destroyed along with this stream.
+   */
+  libxstream_stream* stripe(size_t i);
+  /** Returns the number of stripes created so far. */
+  size_t nstripes() const;
+
+  /**
+   * Claims the stream for the worker of the scheduler which took the stream from the ready list.
+   * The claim is not contended by other workers, but it allows to destroy the stream safely.
+   */
+  void claim();
+  void release();
+
   /**
    * Wait for any pending work to complete with the option to wait for all work i.e.,
    * across thread-local queues. The any-flag allows to omit waiting if the thread
@@ -89,12 +118,18 @@ public:
 private:
   libxstream_stream(const libxstream_stream& other);
   libxstream_stream& operator=(const libxstream_stream& other);
+  friend class libxstream_stream_internal::registry_type;
 
 private:
 #if defined(LIBXSTREAM_TRACE) && 0 != ((2*LIBXSTREAM_TRACE+1)/2) && defined(LIBXSTREAM_DEBUG)
   char m_name[128];
 #endif
   mutable libxstream_workqueue m_queue;
+  libxstream_lock* m_lock; // claimed by the executing worker
+  libxstream_graph* m_capture; // work is recorded rather than enqueued
+  libxstream_stream* m_stripes[LIBXSTREAM_STRIPE_NSTREAMS]; // published under the lock of the registry
+  libxstream_stream* m_owner; // stream which carries the stripes of this stream (if any)
+  size_t m_index; // position among the streams of the device (registry)
   int m_device;
   int m_priority;
 
@@ -34,10 +34,14 @@
 
 #include <libxstream_begin.h>
 #include <algorithm>
+#include <cstdlib>
 #include <cstdio>
+#include <vector>
 #if defined(LIBXSTREAM_STDFEATURES)
+# include <condition_variable>
 # include <thread>
 # include <atomic>
+# include <mutex>
 #else
 # if defined(__GNUC__)
 #   include <pthread.h>
@@ -57,86 +61,215 @@ public:
 public:
   scheduler_type()
     : m_global_queue()
-    , m_stream(0)
-#if defined(LIBXSTREAM_STDFEATURES)
-    , m_thread() // do not start here
-#else
-    , m_thread(0)
+    , m_ready_ticket(0)
+    , m_ready_size(0)
+#if !defined(LIBXSTREAM_STDFEATURES)
+    , m_ready_lock(libxstream_lock_create())
 #endif
+    , m_lock(libxstream_lock_create())
+    , m_nworkers(0)
+    , m_size(0)
     , m_terminated(false)
-  {}
+  {
+    m_ready.reserve((LIBXSTREAM_MAX_NDEVICES) * (LIBXSTREAM_MAX_NSTREAMS) + 1);
+  }
 
   ~scheduler_type() {
     if (running()) {
       m_terminated = true;
 
-      // terminates the background thread
-      entry_type& entry = m_global_queue.allocate_entry();
-      delete entry.dangling();
-      entry = entry_type(&m_global_queue);
-      entry.wait();
+      // terminates the workers (one invalid item each)
+      entry_type* entry = 0;
+      for (size_t i = 0; i < m_nworkers; ++i) {
+        entry = &m_global_queue.allocate_entry();
+        entry->terminate();
+      }
+      if (m_global_queue.enlist()) {
+        enlist(0);
+      }
+      entry->wait();
 
+      for (size_t i = 0; i < m_nworkers; ++i) {
 #if defined(LIBXSTREAM_STDFEATURES)
-      m_thread.detach();
+        m_threads[i].detach();
 #else
 # if defined(__GNUC__)
-      pthread_detach(m_thread);
+        pthread_detach(m_threads[i]);
 # else
-      CloseHandle(m_thread);
+        CloseHandle(m_threads[i]);
 # endif
 #endif
+      }
     }
+#if !defined(LIBXSTREAM_STDFEATURES)
+    libxstream_lock_destroy(m_ready_lock);
+#endif
+    libxstream_lock_destroy(m_lock);
   }
 
 public:
   bool running() const {
-#if defined(LIBXSTREAM_STDFEATURES)
-    return m_thread.joinable() && !m_terminated;
-#else
-    return 0 != m_thread && !m_terminated;
-#endif
+    return 0 != m_nworkers && !m_terminated;
+  }
+
+  size_t size() const {
+    return 0 != m_size ? m_size : default_size();
+  }
+
+  int size(size_t nworkers) {
+    int result = LIBXSTREAM_ERROR_NONE;
+    libxstream_lock_acquire(m_lock);
+
+    if (m_nworkers <= nworkers && 0 < nworkers && (LIBXSTREAM_MAX_NWORKERS) >= nworkers) {
+      m_size = nworkers;
+    }
+    else {
+      result = LIBXSTREAM_ERROR_CONDITION;
+    }
+
+    libxstream_lock_release(m_lock);
+
+    if (LIBXSTREAM_ERROR_NONE == result && 0 != m_nworkers) {
+      start(); // grow the pool
+    }
+
+    return result;
   }
 
   void start() {
-    if (!m_terminated && !running()) {
-      libxstream_lock *const lock = libxstream_lock_get(this);
-      libxstream_lock_acquire(lock);
+    if (!m_terminated && m_nworkers < size()) {
+      libxstream_lock_acquire(m_lock);
 
-      if (!running()) {
+      const size_t nworkers = size();
+      for (size_t i = m_nworkers; i < nworkers && !m_terminated; ++i) {
 #if defined(LIBXSTREAM_STDFEATURES)
-        std::thread(run, this).swap(m_thread);
+        std::thread(run, this).swap(m_threads[i]);
 #else
 # if defined(__GNUC__)
-        pthread_create(&m_thread, 0, run, this);
+        pthread_create(m_threads + i, 0, run, this);
 # else
-        m_thread = CreateThread(0, 0, run, this, 0, 0);
+        m_threads[i] = CreateThread(0, 0, run, this, 0, 0);
 # endif
 #endif
+        m_nworkers = i + 1;
       }
 
-      libxstream_lock_release(lock);
+      libxstream_lock_release(m_lock);
     }
   }
 
-  entry_type* front() {
-    entry_type* result = m_global_queue.front();
-
-    if (0 == result || 0 == result->item()) { // no item in global queue
-      libxstream_stream *const stream = libxstream_stream::schedule(m_stream);
-      result = stream ? stream->work() : 0;
-      m_stream = stream;
+  /** Appends a stream (NULL: global queue) to the ready list; the queue of the stream must be enlisted. */
+  void enlist(libxstream_stream* stream) {
+#if defined(LIBXSTREAM_STDFEATURES)
+    {
+      std::lock_guard<std::mutex> guard(m_ready_mutex);
+      push_ready(stream);
     }
+    m_ready_condition.notify_one();
+#else
+    libxstream_lock_acquire(m_ready_lock);
+    push_ready(stream);
+    libxstream_lock_release(m_ready_lock);
+#endif
+  }
 
+  /** Takes the next stream (NULL: global queue) from the ready list, and blocks if the list is empty. */
+  libxstream_stream* take() {
+    libxstream_stream* result = 0;
+#if defined(LIBXSTREAM_STDFEATURES)
+    // short period of polling before blocking avoids the wake-up latency in case of a burst of work
+    for (size_t i = 0; i < (LIBXSTREAM_WORKER_SPIN) && 0 == m_ready_size; ++i) this_thread_yield();
+    std::unique_lock<std::mutex> guard(m_ready_mutex);
+    while (0 == m_ready_size) m_ready_condition.wait(guard);
+    result = pop_ready();
+#else
+    size_t cycle = 0;
+    libxstream_lock_acquire(m_ready_lock);
+    while (0 == m_ready_size) {
+      libxstream_lock_release(m_ready_lock);
+      this_thread_wait(cycle);
+      libxstream_lock_acquire(m_ready_lock);
+    }
+    result = pop_ready();
+    libxstream_lock_release(m_ready_lock);
+#endif
     return result;
   }
 
+  /**
+   * Lists the stream (NULL: global queue) whose queue was just enlisted by pushing the given entry.
+   * A synchronous item which is in front of the queue is executed by the calling thread instead
+   * (LIBXSTREAM_SYNC_INLINE); the caller owns the queue similar to a worker, hence the order of
+   * the stream is preserved. The queue is listed afterwards if further work arrived meanwhile.
+   */
+  void dispatch(libxstream_stream* stream, entry_type& entry) {
+#if defined(LIBXSTREAM_SYNC_INLINE)
+    libxstream_workqueue& queue = stream ? stream->queue() : m_global_queue;
+    if (&entry == queue.front() && entry.valid() && 0 != (LIBXSTREAM_CALL_WAIT & entry.item()->flags())) {
+      entry.execute();
+#if defined(LIBXSTREAM_ASYNCHOST) && (201307 <= _OPENMP)
+#     pragma omp taskwait
+#endif
+      entry.pop();
+      if (queue.ready() || queue.delist()) {
+        enlist(stream);
+      }
+    }
+    else
+#else
+    libxstream_use_sink(&entry);
+#endif
+    {
+      enlist(stream);
+    }
+  }
+
+  entry_type* front() {
+    return m_global_queue.front();
+  }
+
   entry_type& push(libxstream_workitem& workitem) {
     entry_type& entry = m_global_queue.allocate_entry_mt();
     entry.push(workitem);
+    if (m_global_queue.enlist()) {
+      dispatch(0, entry);
+    }
     return entry;
   }
 
 private:
+  static size_t default_size() {
+    static size_t nworkers = 0;
+    if (0 == nworkers) {
+      const char *const env = getenv("LIBXSTREAM_NWORKERS");
+      const int value = (env && *env) ? atoi(env) : 0;
+      nworkers = 0 < value ? std::min<size_t>(value, LIBXSTREAM_MAX_NWORKERS) : (LIBXSTREAM_NWORKERS);
+    }
+    return nworkers;
+  }
+
+  /**
+   * The ready list is a heap ordered by the listing order (ticket), which is delayed by the priority
+   * level of the stream. A stream of a lower priority is hence preferred after a bounded number of
+   * dispatches (LIBXSTREAM_PRIORITY_AGING per level), and streams of the same priority are round-robin.
+   */
+  void push_ready(libxstream_stream* stream) {
+    const size_t level = 0 != stream ? (stream->priority() - libxstream_stream::priority_range_greatest()) : 0;
+    const ready_type ready = { m_ready_ticket++ + level * (LIBXSTREAM_PRIORITY_AGING), stream };
+    m_ready.push_back(ready); // grows with the number of streams
+    std::push_heap(m_ready.begin(), m_ready.end());
+    m_ready_size = m_ready.size();
+  }
+
+  libxstream_stream* pop_ready() {
+    LIBXSTREAM_ASSERT(0 < m_ready_size);
+    std::pop_heap(m_ready.begin(), m_ready.end());
+    libxstream_stream *const result = m_ready.back().stream;
+    m_ready.pop_back();
+    m_ready_size = m_ready.size();
+    return result;
+  }
+
 #if defined(LIBXSTREAM_STDFEATURES) || defined(__GNUC__)
   static void* run(void* scheduler)
 #else
@@ -151,25 +284,38 @@ private:
 #   pragma omp master
 #endif
     for (; continue_run;) {
-      scheduler_type::entry_type* entry = s.front();
-      size_t cycle = 0;
+      // a listed stream is owned by this worker until it is listed again
+      libxstream_stream *const stream = s.take();
+      libxstream_workqueue& queue = stream ? stream->queue() : s.m_global_queue;
+      if (stream) stream->claim();
+
+      // the queue can be listed by an item which is published ahead of the front item
+      scheduler_type::entry_type *const entry = queue.front();
+      if (0 != entry && 0 != entry->item()) {
+        if (entry->valid()) {
+          entry->execute();
+#if defined(LIBXSTREAM_ASYNCHOST) && (201307 <= _OPENMP)
+#         pragma omp taskwait
+#endif
+        }
+        else {
+          continue_run = false;
+        }
 
-      while (0 == entry || 0 == entry->item()) {
-        this_thread_wait(cycle);
-        entry = s.front();
+        entry->pop();
       }
 
-      if (entry->valid()) {
-        entry->execute();
-#if defined(LIBXSTREAM_ASYNCHOST) && (201307 <= _OPENMP)
-#       pragma omp taskwait
-#endif
+      if (queue.ready()) {
+        if (entry == queue.front()) { // repeated item (loop)
+          this_thread_yield();
+        }
+        s.enlist(stream);
       }
-      else {
-        continue_run = false;
+      else if (queue.delist()) {
+        s.enlist(stream);
       }
 
-      entry->pop();
+      if (stream) stream->release();
     }
 
 #if defined(LIBXSTREAM_STDFEATURES) || defined(__GNUC__)
@@ -179,16 +325,37 @@ private:
 #endif
   }
 
+private:
+  struct ready_type {
+    // heap property: the smallest key is on top
+    bool operator<(const ready_type& other) const { return other.key < key; }
+    size_t key;
+    libxstream_stream* stream;
+  };
+
 private:
   libxstream_workqueue m_global_queue;
-  libxstream_stream* m_stream;
+  // streams with work (NULL designates the global queue); a stream is listed only once
+  std::vector<ready_type> m_ready;
+  size_t m_ready_ticket;
+  volatile size_t m_ready_size;
 #if defined(LIBXSTREAM_STDFEATURES)
-  std::thread m_thread;
+  std::condition_variable m_ready_condition;
+  std::mutex m_ready_mutex;
+#else
+  libxstream_lock* m_ready_lock;
+#endif
+  // guards growing the pool of workers
+  libxstream_lock* m_lock;
+#if defined(LIBXSTREAM_STDFEATURES)
+  std::thread m_threads[LIBXSTREAM_MAX_NWORKERS];
 #elif defined(__GNUC__)
-  pthread_t m_thread;
+  pthread_t m_threads[LIBXSTREAM_MAX_NWORKERS];
 #else
-  HANDLE m_thread;
+  HANDLE m_threads[LIBXSTREAM_MAX_NWORKERS];
 #endif
+  volatile size_t m_nworkers;
+  size_t m_size;
   bool m_terminated;
 };
 static/*IPO*/ scheduler_type scheduler;
@@ -197,8 +364,11 @@ static/*IPO*/ scheduler_type scheduler;
 
 
 libxstream_workitem::libxstream_workitem(libxstream_stream* stream, int flags, size_t argc, const arg_type argv[], const char* name)
-  : m_function(0)
+  : m_signature(0)
+  , m_function(0)
   , m_stream(stream)
+  , m_nargs(0)
+  , m_call(false)
   , m_event(0)
   , m_pending(0)
   , m_flags(flags)
@@ -222,22 +392,17 @@ libxstream_workitem::libxstream_workitem(libxstream_stream* stream, int flags, s
       signature = static_cast<const libxstream_argument*>(libxstream_get_value(argv[0]).const_pointer);
     }
 
-    size_t arity = 0;
+    // the signature of the caller is only referenced; clone makes the private copy
     if (signature) {
-      LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_get_arity(signature, &arity));
-      LIBXSTREAM_PRAGMA_LOOP_COUNT(0, LIBXSTREAM_MAX_NARGS, LIBXSTREAM_MAX_NARGS/2)
-      for (size_t i = 0; i < arity; ++i) m_signature[i] = signature[i];
+      LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_get_arity(signature, &m_nargs));
     }
-    LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_construct(m_signature, arity, libxstream_argument::kind_invalid, 0, LIBXSTREAM_TYPE_INVALID, 0, 0));
+    m_signature = const_cast<libxstream_argument*>(signature);
+    m_call = true;
   }
   else {
-    LIBXSTREAM_ASSERT(argc <= (LIBXSTREAM_MAX_NARGS));
-    for (size_t i = 0; i < argc; ++i) m_signature[i] = argv[i];
-    LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_construct(m_signature, argc, libxstream_argument::kind_invalid, 0, LIBXSTREAM_TYPE_INVALID, 0, 0));
-#if defined(LIBXSTREAM_DEBUG)
-    size_t arity = 0;
-    LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == libxstream_get_arity(m_signature, &arity) && arity == argc);
-#endif
+    LIBXSTREAM_ASSERT(argc <= (LIBXSTREAM_WORKITEM_NARGS));
+    for (size_t i = 0; i < argc; ++i) m_args[i] = argv[i].data;
+    m_nargs = argc;
   }
 
   libxstream_workitem_internal::scheduler.start();
@@ -250,15 +415,40 @@ libxstream_workitem::~libxstream_workitem()
 }
 
 
-libxstream_workitem* libxstream_workitem::clone() const
+libxstream_workitem* libxstream_workitem::clone(void* storage, size_t size) const
 {
-  LIBXSTREAM_ASSERT(0 == (LIBXSTREAM_CALL_WAIT & m_flags));
-  libxstream_workitem *const instance = virtual_clone();
-  LIBXSTREAM_ASSERT(0 != instance);
+  const size_t align = sizeof(libxstream_argument::data_union);
+  const size_t offset = ((virtual_size() + align - 1) / align) * align;
+  const size_t nargs = m_call ? (m_nargs + 1) : 0;
+  const size_t required = offset + nargs * sizeof(libxstream_argument);
+  char *const buffer = required <= size ? static_cast<char*>(storage) : new char[required];
+
+  libxstream_workitem *const instance = virtual_clone(buffer);
+  LIBXSTREAM_ASSERT(static_cast<void*>(buffer) == instance);
+
+  if (m_call) {
+    libxstream_argument *const signature = reinterpret_cast<libxstream_argument*>(buffer + offset);
+    LIBXSTREAM_PRAGMA_LOOP_COUNT(0, LIBXSTREAM_MAX_NARGS, LIBXSTREAM_MAX_NARGS/2)
+    for (size_t i = 0; i < m_nargs; ++i) signature[i] = m_signature[i];
+    LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_construct(signature, m_nargs, libxstream_argument::kind_invalid, 0, LIBXSTREAM_TYPE_INVALID, 0, 0));
+    instance->m_signature = signature;
+  }
+
   return instance;
 }
 
 
+void libxstream_workitem::destroy(libxstream_workitem* item, const void* storage)
+{
+  if (item) {
+    item->~libxstream_workitem();
+    if (storage != item) {
+      delete[] reinterpret_cast<char*>(item);
+    }
+  }
+}
+
+
 void libxstream_workitem::operator()(libxstream_workqueue::entry_type& entry)
 {
   LIBXSTREAM_ASSERT(this == entry.item());
@@ -266,6 +456,28 @@ void libxstream_workitem::operator()(libxstream_workqueue::entry_type& entry)
 }
 
 
+void libxstream_workitem::run(libxstream_workqueue::entry_type& entry, libxstream_stream* stream)
+{
+  m_stream = stream;
+  virtual_run(entry);
+}
+
+
+int libxstream_workitem::arg(size_t i, const void* value)
+{
+  LIBXSTREAM_CHECK_CONDITION(i < m_nargs);
+
+  if (m_call) {
+    LIBXSTREAM_CHECK_CALL(libxstream_set_value(m_signature[i], value));
+  }
+  else {
+    m_args[i].pointer = reinterpret_cast<uintptr_t>(value);
+  }
+
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
 libxstream_workqueue::entry_type& libxstream_enqueue(libxstream_workitem* workitem)
 {
   libxstream_workqueue::entry_type *const result = workitem
@@ -275,4 +487,22 @@ libxstream_workqueue::entry_type& libxstream_enqueue(libxstream_workitem* workit
   return *result;
 }
 
+
+void libxstream_dispatch(libxstream_stream* stream, libxstream_workqueue::entry_type& entry)
+{
+  libxstream_workitem_internal::scheduler.dispatch(stream, entry);
+}
+
+
+size_t libxstream_scheduler_size()
+{
+  return libxstream_workitem_internal::scheduler.size();
+}
+
+
+int libxstream_scheduler_size(size_t nworkers)
+{
+  return libxstream_workitem_internal::scheduler.size(nworkers);
+}
+
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
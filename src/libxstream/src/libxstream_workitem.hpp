@@ -35,6 +35,10 @@
 #include "libxstream_stream.hpp"
 #include "libxstream_workqueue.hpp"
 
+#include <libxstream_begin.h>
+#include <new>
+#include <libxstream_end.h>
+
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 
 #define LIBXSTREAM_OFFLOAD_ALLOC alloc_if(1) free_if(0)
@@ -45,6 +49,9 @@
     length(0!=(IS_SCALAR)?sizeof(libxstream_argument::data_union):0) \
     alloc_if(0!=(IS_SCALAR)?1:0) free_if(0!=(IS_SCALAR)?1:0))
 
+/** Maximum number of arguments of an internal work item (LIBXSTREAM_ASYNC_END). */
+#define LIBXSTREAM_WORKITEM_NARGS 4
+
 #define LIBXSTREAM_ASYNC_PENDING workitem_pending
 #define LIBXSTREAM_ASYNC_READY (0 == (LIBXSTREAM_ASYNC_PENDING))
 #define LIBXSTREAM_ASYNC_STREAM m_stream
@@ -97,8 +104,11 @@
     LIBXSTREAM_UNIQUE(workitem_type)(libxstream_stream* stream, int flags, size_t argc, const arg_type argv[], const char* name) \
       : libxstream_workitem(stream, flags, argc, argv, name) \
     {} \
-    LIBXSTREAM_UNIQUE(workitem_type)* virtual_clone() const { \
-      return new LIBXSTREAM_UNIQUE(workitem_type)(*this); \
+    LIBXSTREAM_UNIQUE(workitem_type)* virtual_clone(void* storage) const { \
+      return new(storage) LIBXSTREAM_UNIQUE(workitem_type)(*this); \
+    } \
+    size_t virtual_size() const { \
+      return sizeof(LIBXSTREAM_UNIQUE(workitem_type)); \
     } \
     void virtual_run(libxstream_workqueue::entry_type& LIBXSTREAM_ASYNC_QENTRY) { \
       const libxstream_signal LIBXSTREAM_ASYNC_PENDING = LIBXSTREAM_ASYNC_STREAM ? LIBXSTREAM_ASYNC_STREAM->pending() : 0; \
@@ -159,27 +169,18 @@ public:
 
 public:
   template<typename T,size_t i> T& val() {
-#if defined(LIBXSTREAM_DEBUG)
-    size_t arity = 0;
-    LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == libxstream_get_arity(m_signature, &arity) && i < arity);
-#endif
-    return *reinterpret_cast<T*>(&m_signature[i]);
+    LIBXSTREAM_ASSERT(!m_call && i < m_nargs);
+    return *reinterpret_cast<T*>(m_args + i);
   }
 
   template<typename T,size_t i> T val() const {
-#if defined(LIBXSTREAM_DEBUG)
-    size_t arity = 0;
-    LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == libxstream_get_arity(m_signature, &arity) && i < arity);
-#endif
-    return *reinterpret_cast<const T*>(&m_signature[i]);
+    LIBXSTREAM_ASSERT(!m_call && i < m_nargs);
+    return *reinterpret_cast<const T*>(m_args + i);
   }
 
   template<typename T,size_t i> T* ptr() {
-#if defined(LIBXSTREAM_DEBUG)
-    size_t arity = 0;
-    LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == libxstream_get_arity(m_signature, &arity) && i < arity);
-#endif
-    return *reinterpret_cast<T**>(&m_signature[i]);
+    LIBXSTREAM_ASSERT(!m_call && i < m_nargs);
+    return *reinterpret_cast<T**>(m_args + i);
   }
 
   const libxstream_stream* stream() const { return m_stream; }
@@ -196,19 +197,37 @@ public:
 
   int thread() const { return m_thread; }
 
-  libxstream_workitem* clone() const;
+  /**
+   * Copies the work item (and the signature of a call) into the given storage, or
+   * onto the heap if the storage is too small. The copy is released using destroy.
+   */
+  libxstream_workitem* clone(void* storage, size_t size) const;
+  static void destroy(libxstream_workitem* item, const void* storage);
   void operator()(libxstream_workqueue::entry_type& entry);
 
+  /** Executes a captured copy of the work item on behalf of the given stream (libxstream_graph). */
+  void run(libxstream_workqueue::entry_type& entry, libxstream_stream* stream);
+
+  /**
+   * Replaces the i-th argument; the value is interpreted according to the signature of a call
+   * (libxstream_set_value), or it is the new pointer value of an argument of an internal item.
+   */
+  int arg(size_t i, const void* value);
+
 private:
-  virtual libxstream_workitem* virtual_clone() const = 0;
+  virtual libxstream_workitem* virtual_clone(void* storage) const = 0;
+  virtual size_t virtual_size() const = 0;
   virtual void virtual_run(libxstream_workqueue::entry_type& entry) = 0;
 
 protected:
-  libxstream_argument m_signature[(LIBXSTREAM_MAX_NARGS)+1];
+  libxstream_argument* m_signature; // call: private copy (clone), or signature of the caller
   libxstream_function m_function;
   libxstream_stream* m_stream;
 
 private:
+  libxstream_argument::data_union m_args[LIBXSTREAM_WORKITEM_NARGS]; // values of an internal item
+  size_t m_nargs; // number of values, or arity of the call
+  bool m_call;
   const libxstream_event* m_event;
   libxstream_signal m_pending;
   int m_flags, m_thread;
@@ -220,5 +239,12 @@ private:
 
 libxstream_workqueue::entry_type& libxstream_enqueue(libxstream_workitem* workitem);
 
+/** Lists the stream (NULL: global queue) as ready to be executed, or executes a synchronous entry on the calling thread; called if enlisting the queue of the stream succeeded. */
+void libxstream_dispatch(libxstream_stream* stream, libxstream_workqueue::entry_type& entry);
+
+/** Number of workers executing the work items (scheduler); the number can only grow once the workers are running. */
+size_t libxstream_scheduler_size();
+int libxstream_scheduler_size(size_t nworkers);
+
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 #endif // LIBXSTREAM_WORKITEM_HPP
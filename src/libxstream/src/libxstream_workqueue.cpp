@@ -31,204 +31,1046 @@
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 #include "libxstream_workqueue.hpp"
 #include "libxstream_workitem.hpp"
+#include "libxstream_alloc.hpp"
 
 #include <libxstream_begin.h>
 #include <algorithm>
+#include <new>
+#include <cstdlib>
 #include <cstdio>
 #if defined(LIBXSTREAM_STDFEATURES)
+# include <condition_variable>
 # include <atomic>
+# include <mutex>
 #endif
 #include <libxstream_end.h>
 
 
-void libxstream_workqueue::entry_type::push(libxstream_workitem& workitem)
+namespace libxstream_workqueue_internal {
+
+#if defined(LIBXSTREAM_STDFEATURES)
+typedef std::atomic<size_t> counter_type;
+#else
+typedef volatile size_t counter_type;
+#endif
+
+struct segment_type {
+  counter_type sequence[LIBXSTREAM_QSEGMENT];
+  libxstream_workqueue::entry_type entries[LIBXSTREAM_QSEGMENT];
+  counter_type first; // position of the first entry
+  segment_type* next; // freelist
+};
+
+#if defined(LIBXSTREAM_STDFEATURES)
+typedef std::atomic<segment_type*> segment_pointer;
+#else
+typedef segment_type*volatile segment_pointer;
+#endif
+
+// segments indexed by position (modulo size); replaced by a directory of twice the size if a queue is full
+struct directory_type {
+  size_t size; // POT
+  directory_type* retired; // previous directory which might still be read (deallocated along with the queue)
+  segment_pointer slots[1];
+};
+
+#if defined(LIBXSTREAM_STDFEATURES)
+typedef std::atomic<directory_type*> directory_pointer;
+#else
+typedef directory_type*volatile directory_pointer;
+#endif
+
+// counts the completed entries of a queue; recycled by the next queue (never deallocated)
+struct timeline_type {
+  counter_type completed;
+#if defined(LIBXSTREAM_STDFEATURES)
+  std::atomic<size_t> nwaiting;
+#endif
+  timeline_type* next; // freelist
+};
+
+struct sync_type {
+  directory_pointer directory;
+  // consumer (head) and producers (tail) are kept apart to avoid false sharing
+  LIBXSTREAM_ALIGNED(counter_type head, LIBXSTREAM_CACHELINE);
+  LIBXSTREAM_ALIGNED(counter_type tail, LIBXSTREAM_CACHELINE);
+  counter_type nproducers;
+  counter_type ready; // listed by the scheduler
+  volatile int policy; // waiting for an entry
+  size_t inflight; // counter of the work in flight (device)
+  timeline_type* timeline;
+  size_t base; // value of the timeline when the queue was created
+  LIBXSTREAM_ALIGNED(libxstream_lock* lock, LIBXSTREAM_CACHELINE); // segment (un-)installation, and growing the directory
+  segment_pointer spare; // released segments which are recycled by this queue until no producer is active
+};
+
+// segments are never deallocated (entries might still be referenced e.g., by a waiting thread)
+static/*IPO*/ struct pool_type {
+  segment_type* head;
+} pool = { 0 };
+
+// timelines are never deallocated (referenced by events)
+static/*IPO*/ struct timeline_pool_type {
+  timeline_type* head;
+} timeline_pool = { 0 };
+
+
+LIBXSTREAM_TARGET(mic) inline size_t load(const counter_type& counter)
 {
-  delete m_dangling;
-  const bool async = 0 == (LIBXSTREAM_CALL_WAIT & workitem.flags());
-  const bool witem = 0 == (LIBXSTREAM_CALL_EVENT & workitem.flags());
-  libxstream_workitem *const item = async ? workitem.clone() : &workitem;
-  m_status = witem ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION;
-  m_dangling = async ? item : 0;
-  m_item = item;
+#if defined(LIBXSTREAM_STDFEATURES)
+  return counter.load(std::memory_order_acquire);
+#else
+  return counter;
+#endif
 }
 
 
-int libxstream_workqueue::entry_type::wait(bool any, bool any_status) const
+LIBXSTREAM_TARGET(mic) inline void store(counter_type& counter, size_t value)
 {
-  int result = LIBXSTREAM_ERROR_CONDITION;
+#if defined(LIBXSTREAM_STDFEATURES)
+  counter.store(value, std::memory_order_release);
+#else
+  counter = value;
+#endif
+}
 
-  if (any_status) {
-    if (any || !valid()) {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-      size_t cycle = 0;
-      while (0 != m_item) this_thread_wait(cycle);
+
+LIBXSTREAM_TARGET(mic) inline segment_type* load(const segment_pointer& pointer)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  return pointer.load(std::memory_order_acquire);
 #else
-      while (0 != m_item) this_thread_yield();
+  return pointer;
 #endif
-    }
-    else if (0 != m_item && m_item->thread() != this_thread_id()) {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-      size_t cycle = 0;
+}
+
+
+LIBXSTREAM_TARGET(mic) inline void store(segment_pointer& pointer, segment_type* value)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  pointer.store(value, std::memory_order_release);
+#else
+  pointer = value;
 #endif
-      do {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-        this_thread_wait(cycle);
+}
+
+
+LIBXSTREAM_TARGET(mic) inline libxstream_workitem* load(const libxstream_workqueue::entry_type::item_type& item)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  return item.load(std::memory_order_acquire);
 #else
-        this_thread_yield();
+  return item;
 #endif
-      }
-      while (0 != m_item);
-    }
+}
+
+
+LIBXSTREAM_TARGET(mic) inline void store(libxstream_workqueue::entry_type::item_type& item, libxstream_workitem* value)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  item.store(value, std::memory_order_release);
+#else
+  item = value;
+#endif
+}
+
+
+LIBXSTREAM_TARGET(mic) inline int load(const libxstream_workqueue::entry_type::status_type& status)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  return status.load(std::memory_order_acquire);
+#else
+  return status;
+#endif
+}
+
+
+LIBXSTREAM_TARGET(mic) inline directory_type* load(const directory_pointer& pointer)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  return pointer.load(std::memory_order_acquire);
+#else
+  return pointer;
+#endif
+}
+
+
+LIBXSTREAM_TARGET(mic) inline void store(directory_pointer& pointer, directory_type* value)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  pointer.store(value, std::memory_order_release);
+#else
+  pointer = value;
+#endif
+}
+
+
+LIBXSTREAM_TARGET(mic) inline sync_type& sync(void* value)
+{
+  LIBXSTREAM_ASSERT(0 != value);
+  return *static_cast<sync_type*>(value);
+}
+
+
+LIBXSTREAM_TARGET(mic) inline const sync_type& sync(const void* value)
+{
+  LIBXSTREAM_ASSERT(0 != value);
+  return *static_cast<const sync_type*>(value);
+}
 
-    result = m_status;
+
+LIBXSTREAM_TARGET(mic) inline segment_pointer& directory_slot(const sync_type& s, size_t position)
+{
+  directory_type *const directory = load(s.directory);
+  return directory->slots[LIBXSTREAM_MOD(position / (LIBXSTREAM_QSEGMENT), directory->size)];
+}
+
+
+directory_type* directory_create(size_t size, directory_type* retired)
+{
+  LIBXSTREAM_ASSERT(0 < size && 0 == (size & (size - 1)));
+  void* memory = 0;
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_real_allocate(&memory, sizeof(directory_type) + (size - 1) * sizeof(segment_pointer), LIBXSTREAM_CACHELINE));
+  directory_type *const result = static_cast<directory_type*>(memory);
+  result->size = size;
+  result->retired = retired;
+  for (size_t i = 0; i < size; ++i) store(result->slots[i], 0);
+  return result;
+}
+
+
+void directory_destroy(directory_type* directory)
+{
+  while (0 != directory) {
+    directory_type *const retired = directory->retired;
+    LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_real_deallocate(directory));
+    directory = retired;
   }
-  else {
-    if (any || !valid()) {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-      size_t cycle = 0;
-      while (0 != m_item || LIBXSTREAM_ERROR_NONE != m_status) this_thread_wait(cycle);
+}
+
+
+#if defined(LIBXSTREAM_STDFEATURES)
+// threads which are blocked until an entry is completed (entries are hashed)
+struct parking_type {
+  parking_type(): nwaiting(0) {}
+  std::atomic<size_t> nwaiting;
+  std::condition_variable condition;
+  std::mutex mutex;
+};
+
+
+LIBXSTREAM_TARGET(mic) inline parking_type& parking_get(const libxstream_workqueue::entry_type* entry)
+{
+  // never destroyed (the scheduler might still complete entries during static destruction)
+  static parking_type *const parking = new parking_type[LIBXSTREAM_MAX_NLOCKS];
+  const uintptr_t id = reinterpret_cast<uintptr_t>(entry) / sizeof(libxstream_workqueue::entry_type);
+  return parking[LIBXSTREAM_MOD(id, LIBXSTREAM_MAX_NLOCKS)];
+}
+
+
+LIBXSTREAM_TARGET(mic) inline parking_type& parking_get(const timeline_type* timeline)
+{
+  // entries and timelines share the parking lots
+  return parking_get(reinterpret_cast<const libxstream_workqueue::entry_type*>(timeline));
+}
+#endif
+
+
+static/*IPO*/ volatile int wait_policy = LIBXSTREAM_WAIT_DEFAULT;
+
+
+/**
+ * Number of work items which are enqueued but not completed yet, counted per device (index 0:
+ * global queue, 1: host, 2...: devices) and in total. Threads waiting for a counter to drain
+ * are woken up by the completion which brings a counter to zero.
+ */
+struct inflight_type {
+  inflight_type() {
+    for (size_t i = 0; i < (LIBXSTREAM_MAX_NDEVICES) + 2; ++i) store(count[i], 0);
+    store(total, 0);
+#if defined(LIBXSTREAM_STDFEATURES)
+    nwaiting = 0;
+#endif
+  }
+  counter_type count[(LIBXSTREAM_MAX_NDEVICES)+2];
+  counter_type total;
+#if defined(LIBXSTREAM_STDFEATURES)
+  std::atomic<size_t> nwaiting;
+  std::condition_variable condition;
+  std::mutex mutex;
+#endif
+};
+
+
+LIBXSTREAM_TARGET(mic) inline inflight_type& inflight()
+{
+  // never destroyed (the scheduler might still complete entries during static destruction)
+  static inflight_type *const instance = new inflight_type;
+  return *instance;
+}
+
+
+LIBXSTREAM_TARGET(mic) inline size_t inflight_index(int device)
+{
+  LIBXSTREAM_ASSERT(-1 > device || device < (LIBXSTREAM_MAX_NDEVICES));
+  return -1 > device ? 0 : static_cast<size_t>(device + 2);
+}
+
+
+void inflight_add(size_t index)
+{
+  inflight_type& i = inflight();
+#if defined(LIBXSTREAM_STDFEATURES)
+  i.count[index].fetch_add(1, std::memory_order_relaxed);
+  i.total.fetch_add(1, std::memory_order_relaxed);
 #else
-      while (0 != m_item || LIBXSTREAM_ERROR_NONE != m_status) this_thread_yield();
+  libxstream_lock *const lock = libxstream_lock_get(&i);
+  libxstream_lock_acquire(lock);
+  ++i.count[index];
+  ++i.total;
+  libxstream_lock_release(lock);
 #endif
+}
+
+
+void inflight_sub(size_t index)
+{
+  inflight_type& i = inflight();
+#if defined(LIBXSTREAM_STDFEATURES)
+  const size_t count = i.count[index].fetch_sub(1, std::memory_order_release);
+  const size_t total = i.total.fetch_sub(1, std::memory_order_release);
+  LIBXSTREAM_ASSERT(0 < count && 0 < total);
+  if (1 == count || 1 == total) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 != i.nwaiting.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(i.mutex);
+      i.condition.notify_all();
     }
-    else if (0 != m_item && m_item->thread() != this_thread_id()) {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-      size_t cycle = 0;
+  }
+#else
+  libxstream_lock *const lock = libxstream_lock_get(&i);
+  libxstream_lock_acquire(lock);
+  LIBXSTREAM_ASSERT(0 < i.count[index] && 0 < i.total);
+  --i.count[index];
+  --i.total;
+  libxstream_lock_release(lock);
+#endif
+}
+
+
+bool inflight_drained(int device)
+{
+  const inflight_type& i = inflight();
+  // the work of a device might be enqueued into the global queue (memory operations)
+  return (-1 > device) ? (0 == load(i.total)) : (0 == load(i.count[inflight_index(device)]) && 0 == load(i.count[0]));
+}
+
+
+segment_type* pool_pop()
+{
+  libxstream_lock *const lock = libxstream_lock_get(&pool);
+  libxstream_lock_acquire(lock);
+  segment_type* result = pool.head;
+  if (0 != result) pool.head = result->next;
+  libxstream_lock_release(lock);
+  return 0 != result ? result : new segment_type;
+}
+
+
+void pool_push(segment_type* segment)
+{
+  libxstream_lock *const lock = libxstream_lock_get(&pool);
+  libxstream_lock_acquire(lock);
+  segment->next = pool.head;
+  pool.head = segment;
+  libxstream_lock_release(lock);
+}
+
+
+// gives the released segments of a queue back to the freelist; the lock of the queue is held
+void spare_flush(sync_type& s)
+{
+  while (segment_type *const segment = load(s.spare)) {
+    store(s.spare, segment->next);
+    pool_push(segment);
+  }
+}
+
+
+#if defined(LIBXSTREAM_STDFEATURES)
+void producer_enter(sync_type& s)
+{
+  s.nproducers.fetch_add(1); // segments seen by this producer are not handed to other queues
+}
+
+
+void producer_leave(sync_type& s)
+{
+  if (1 == s.nproducers.fetch_sub(1)) {
+    // pairs with the fence in release i.e., a segment released meanwhile is observed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 != load(s.spare)) {
+      libxstream_lock_acquire(s.lock);
+      if (0 == load(s.nproducers)) spare_flush(s);
+      libxstream_lock_release(s.lock);
+    }
+  }
+}
+#endif
+
+
+
+timeline_type* timeline_pop()
+{
+  libxstream_lock *const lock = libxstream_lock_get(&timeline_pool);
+  libxstream_lock_acquire(lock);
+  timeline_type* result = timeline_pool.head;
+  if (0 != result) timeline_pool.head = result->next;
+  libxstream_lock_release(lock);
+  if (0 == result) {
+    result = new timeline_type;
+    store(result->completed, 0);
+#if defined(LIBXSTREAM_STDFEATURES)
+    result->nwaiting = 0;
 #endif
-      do {
-#if defined(LIBXSTREAM_SLEEP_CLIENT)
-        this_thread_wait(cycle);
+  }
+  return result;
+}
+
+
+void timeline_push(timeline_type* timeline)
+{
+  libxstream_lock *const lock = libxstream_lock_get(&timeline_pool);
+  libxstream_lock_acquire(lock);
+  timeline->next = timeline_pool.head;
+  timeline_pool.head = timeline;
+  libxstream_lock_release(lock);
+}
+
+
+// wakes up threads waiting for the timeline; the caller issues a fence after advancing the timeline
+// which pairs with the fence of the waiter (see wait) i.e., a wakeup cannot be missed
+void timeline_notify(timeline_type& timeline)
+{
+#if defined(LIBXSTREAM_STDFEATURES)
+  if (0 != timeline.nwaiting.load(std::memory_order_relaxed)) {
+    parking_type& parking = parking_get(&timeline);
+    std::lock_guard<std::mutex> lock(parking.mutex);
+    parking.condition.notify_all();
+  }
 #else
-        this_thread_yield();
+  libxstream_use_sink(&timeline);
 #endif
-      }
-      while (0 != m_item || LIBXSTREAM_ERROR_NONE != m_status);
+}
+
+} // namespace libxstream_workqueue_internal
+
+
+void libxstream_workqueue::entry_type::push(libxstream_workitem& workitem)
+{
+  discard();
+  const bool witem = 0 == (LIBXSTREAM_CALL_EVENT & workitem.flags());
+  libxstream_workitem *const item = workitem.clone(m_storage.data, sizeof(m_storage));
+  m_status = witem ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION;
+  m_dangling = item;
+  libxstream_workqueue_internal::store(m_item, item);
+  LIBXSTREAM_ASSERT(0 != m_queue);
+  libxstream_workqueue_internal::inflight_add(libxstream_workqueue_internal::sync(m_queue->m_sync).inflight);
+  m_queue->publish(*this);
+}
+
+
+void libxstream_workqueue::entry_type::terminate()
+{
+  discard();
+  m_status = LIBXSTREAM_ERROR_CONDITION;
+  libxstream_workqueue_internal::store(m_item, reinterpret_cast<libxstream_workitem*>(-1));
+  LIBXSTREAM_ASSERT(0 != m_queue);
+  m_queue->publish(*this);
+}
+
+
+const libxstream_workitem* libxstream_workqueue::entry_type::item() const
+{
+  return libxstream_workqueue_internal::load(m_item);
+}
+
+
+libxstream_workitem* libxstream_workqueue::entry_type::item()
+{
+  return libxstream_workqueue_internal::load(m_item);
+}
+
+
+int libxstream_workqueue::entry_type::status() const
+{
+  return libxstream_workqueue_internal::load(m_status);
+}
+
+
+void libxstream_workqueue::entry_type::discard()
+{
+  libxstream_workitem::destroy(m_dangling, m_storage.data);
+  m_dangling = 0;
+}
+
+
+int libxstream_workqueue::entry_type::wait(bool any, bool any_status) const
+{
+  const libxstream_workitem *const item = this->item();
+
+  // omit waiting if the current thread is still the same since enqueuing the item (unless any)
+  if (any || !valid() || (0 != item && item->thread() != this_thread_id())) {
+    using namespace libxstream_workqueue_internal;
+    const int queue_policy = 0 != m_queue ? m_queue->wait_policy() : LIBXSTREAM_WAIT_DEFAULT;
+    const int policy = LIBXSTREAM_WAIT_DEFAULT != queue_policy ? queue_policy : libxstream_default_wait_policy();
+    const size_t nspin = LIBXSTREAM_WAIT_SPIN == policy ? static_cast<size_t>(-1) : (LIBXSTREAM_WAIT_ADAPTIVE == policy ? (LIBXSTREAM_WAIT_NSPIN) : 0);
+
+    for (size_t i = 0; i < nspin && !completed(any_status); ++i) {
+      this_thread_yield();
     }
 
-    result = m_status;
+    if (!completed(any_status)) {
+#if defined(LIBXSTREAM_STDFEATURES)
+      // the completion wakes up the thread (see pop)
+      parking_type& parking = parking_get(this);
+      std::unique_lock<std::mutex> lock(parking.mutex);
+      parking.nwaiting.fetch_add(1);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      while (!completed(any_status)) parking.condition.wait(lock);
+      parking.nwaiting.fetch_sub(1);
+#else
+      size_t cycle = 0;
+      while (!completed(any_status)) this_thread_wait(cycle);
+#endif
+    }
   }
 
-  //LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == result);
-  return result;
+  //LIBXSTREAM_ASSERT(LIBXSTREAM_ERROR_NONE == status());
+  return status();
+}
+
+
+bool libxstream_workqueue::entry_type::completed(bool any_status) const
+{
+  // the acquire pairs with the release in pop i.e., the effects of the item (and its status) are visible
+  return 0 == item() && (any_status || LIBXSTREAM_ERROR_NONE == status());
 }
 
 
 void libxstream_workqueue::entry_type::execute()
 {
-  LIBXSTREAM_ASSERT(0 != m_item && (m_item == m_dangling || 0 == m_dangling));
-  (*m_item)(*this);
+  libxstream_workitem *const item = this->item();
+  LIBXSTREAM_ASSERT(0 != item && item == m_dangling);
+  (*item)(*this);
 }
 
 
 void libxstream_workqueue::entry_type::pop()
 {
-  if (!valid() || 0 == (LIBXSTREAM_CALL_LOOP & m_item->flags())) {
-    m_item = 0;
+  if (!valid() || 0 == (LIBXSTREAM_CALL_LOOP & item()->flags())) {
+    using namespace libxstream_workqueue_internal;
     LIBXSTREAM_ASSERT(0 != m_queue);
+    const bool counted = valid(); // terminating items are not counted
+    const sync_type& s = sync(m_queue->m_sync);
+    // the queue might be destroyed after pop
+    timeline_type& timeline = *s.timeline;
+    const size_t inflight = s.inflight;
+    store(m_item, 0);
     m_queue->pop();
+#if defined(LIBXSTREAM_STDFEATURES)
+    // wake up threads waiting for the completion (see wait) after the queue moved on i.e.,
+    // a woken up thread never observes the completed entry as the front of the queue.
+    // The fence (not the completion itself, which is released above) pairs with the fence of the waiter (registered under the mutex, then checking
+    // the condition): either the waiter observes the completion, or the waiter is observed here.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    parking_type& parking = parking_get(this);
+    if (0 != parking.nwaiting.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(parking.mutex);
+      parking.condition.notify_all();
+    }
+#endif
+    timeline_notify(timeline);
+    if (counted) {
+      inflight_sub(inflight);
+    }
   }
 }
 
 
-libxstream_workqueue::libxstream_workqueue()
-  : m_index(0)
-#if defined(LIBXSTREAM_STDFEATURES)
-  , m_size(new std::atomic<size_t>(0))
-#else
-  , m_size(new size_t(0))
-#endif
+libxstream_workqueue::libxstream_workqueue(int device)
+  : m_sync(0)
 {
-  std::fill_n(m_buffer, LIBXSTREAM_MAX_QSIZE, entry_type(this, 0));
+  using namespace libxstream_workqueue_internal;
+  void* memory = 0;
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_real_allocate(&memory, sizeof(sync_type), LIBXSTREAM_CACHELINE));
+  sync_type *const s = new(memory) sync_type;
+  store(s->directory, directory_create(LIBXSTREAM_QDIRECTORY, 0));
+  store(s->head, 0);
+  store(s->tail, 0);
+  store(s->nproducers, 0);
+  store(s->ready, 0);
+  s->policy = LIBXSTREAM_WAIT_DEFAULT;
+  s->inflight = inflight_index(device);
+  s->timeline = timeline_pop();
+  s->base = load(s->timeline->completed);
+  s->lock = libxstream_lock_create();
+  store(s->spare, 0);
+  m_sync = s;
 }
 
 
 libxstream_workqueue::~libxstream_workqueue()
 {
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
 #if defined(LIBXSTREAM_DEBUG)
   size_t pending = 0;
-  for (size_t i = 0; i < LIBXSTREAM_MAX_QSIZE; ++i) {
-    pending += (0 == m_buffer[i].item()) ? 0 : 1;
-    delete m_buffer[i].dangling();
+#endif
+  directory_type *const directory = load(s.directory);
+  for (size_t i = 0; i < directory->size; ++i) {
+    if (segment_type *const segment = load(directory->slots[i])) {
+      for (size_t j = 0; j < (LIBXSTREAM_QSEGMENT); ++j) {
+        const entry_type& entry = segment->entries[j];
+        if (0 != entry.item() && entry.valid() && entry.queue() == this) { // never completed
+#if defined(LIBXSTREAM_DEBUG)
+          ++pending;
+#endif
+          inflight_sub(s.inflight);
+        }
+        entry_type& recycled = segment->entries[j];
+        recycled.discard();
+        recycled.m_status = LIBXSTREAM_ERROR_CONDITION;
+        recycled.m_queue = 0;
+        recycled.m_position = 0;
+        store(recycled.m_item, 0);
+      }
+      pool_push(segment);
+    }
   }
+  spare_flush(s);
+  directory_destroy(directory);
+#if defined(LIBXSTREAM_DEBUG)
   if (0 < pending) {
     LIBXSTREAM_PRINT(1, "%lu work item%s pending!", static_cast<unsigned long>(pending), 1 < pending ? "s are" : " is");
   }
 #endif
+  // entries which never completed are accounted as completed (waiters are released)
+  store(s.timeline->completed, s.base + load(s.tail));
 #if defined(LIBXSTREAM_STDFEATURES)
-  delete static_cast<std::atomic<size_t>*>(m_size);
-#else
-  delete static_cast<size_t*>(m_size);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 #endif
+  timeline_notify(*s.timeline);
+  timeline_push(s.timeline);
+  libxstream_lock_destroy(s.lock);
+  s.~sync_type();
+  LIBXSTREAM_CHECK_CALL_ASSERT(libxstream_real_deallocate(m_sync));
 }
 
 
 size_t libxstream_workqueue::size() const
 {
+  using namespace libxstream_workqueue_internal;
+  const sync_type& s = sync(m_sync);
+  const size_t head = load(s.head);
+  return load(s.tail) - head;
+}
+
+
+bool libxstream_workqueue::ready() const
+{
+  const entry_type *const entry = front();
+  return 0 != entry && 0 != entry->item();
+}
+
+
+bool libxstream_workqueue::enlist()
+{
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+#if defined(LIBXSTREAM_STDFEATURES)
+  // the published item must be visible before the flag is read (see delist)
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  size_t expected = 0;
+  return s.ready.compare_exchange_strong(expected, 1);
+#else
+  libxstream_lock_acquire(s.lock);
+  const bool result = 0 == s.ready;
+  s.ready = 1;
+  libxstream_lock_release(s.lock);
+  return result;
+#endif
+}
+
+
+bool libxstream_workqueue::delist()
+{
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
 #if defined(LIBXSTREAM_STDFEATURES)
-  const size_t atomic_size = *static_cast<const std::atomic<size_t>*>(m_size);
+  s.ready.store(0, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 #else
-  const size_t atomic_size = *static_cast<const size_t*>(m_size);
+  libxstream_lock_acquire(s.lock);
+  s.ready = 0;
+  libxstream_lock_release(s.lock);
 #endif
-  return atomic_size - m_index;
+  // an item published meanwhile did not list the queue again
+  return ready() && enlist();
+}
+
+
+bool libxstream_workqueue::listed() const
+{
+  using namespace libxstream_workqueue_internal;
+  const sync_type& s = sync(m_sync);
+#if defined(LIBXSTREAM_STDFEATURES)
+  return 0 != s.ready.load();
+#else
+  return 0 != s.ready;
+#endif
+}
+
+
+const void* libxstream_workqueue::timeline() const
+{
+  using namespace libxstream_workqueue_internal;
+  return sync(m_sync).timeline;
+}
+
+
+size_t libxstream_workqueue::ticket() const
+{
+  using namespace libxstream_workqueue_internal;
+  const sync_type& s = sync(m_sync);
+  return s.base + load(s.tail);
+}
+
+
+/*static*/bool libxstream_workqueue::reached(const void* timeline, size_t ticket)
+{
+  using namespace libxstream_workqueue_internal;
+  LIBXSTREAM_ASSERT(0 != timeline);
+  // the distance tolerates a wrap-around of the counter
+  return 0 <= static_cast<ptrdiff_t>(load(static_cast<const timeline_type*>(timeline)->completed) - ticket);
+}
+
+
+/*static*/int libxstream_workqueue::wait(const void* timeline, size_t ticket)
+{
+  using namespace libxstream_workqueue_internal;
+  const int policy = libxstream_default_wait_policy();
+  const size_t nspin = LIBXSTREAM_WAIT_SPIN == policy ? static_cast<size_t>(-1) : (LIBXSTREAM_WAIT_ADAPTIVE == policy ? (LIBXSTREAM_WAIT_NSPIN) : 0);
+
+  for (size_t i = 0; i < nspin && !reached(timeline, ticket); ++i) {
+    this_thread_yield();
+  }
+
+  if (!reached(timeline, ticket)) {
+#if defined(LIBXSTREAM_STDFEATURES)
+    timeline_type& t = *const_cast<timeline_type*>(static_cast<const timeline_type*>(timeline));
+    parking_type& parking = parking_get(&t);
+    std::unique_lock<std::mutex> lock(parking.mutex);
+    t.nwaiting.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // see timeline_notify
+    while (!reached(timeline, ticket)) parking.condition.wait(lock);
+    t.nwaiting.fetch_sub(1);
+#else
+    size_t cycle = 0;
+    while (!reached(timeline, ticket)) this_thread_wait(cycle);
+#endif
+  }
+
+  return LIBXSTREAM_ERROR_NONE;
+}
+
+
+int libxstream_workqueue::wait_policy() const
+{
+  using namespace libxstream_workqueue_internal;
+  return sync(m_sync).policy;
+}
+
+
+void libxstream_workqueue::wait_policy(int policy)
+{
+  using namespace libxstream_workqueue_internal;
+  LIBXSTREAM_ASSERT(LIBXSTREAM_WAIT_DEFAULT <= policy && LIBXSTREAM_WAIT_BLOCK >= policy);
+  sync(m_sync).policy = policy;
 }
 
 
 libxstream_workqueue::entry_type& libxstream_workqueue::allocate_entry_mt()
 {
-  entry_type* result = 0;
-#if defined(LIBXSTREAM_STDFEATURES)
-  result = m_buffer + LIBXSTREAM_MOD((*static_cast<std::atomic<size_t>*>(m_size))++, LIBXSTREAM_MAX_QSIZE);
-#elif defined(_OPENMP)
-  size_t size1 = 0;
-  size_t& size = *static_cast<size_t*>(m_size);
-# if (201107 <= _OPENMP)
-# pragma omp atomic capture
-# else
-# pragma omp critical
-# endif
-  size1 = ++size;
-  result = m_buffer + LIBXSTREAM_MOD(size1 - 1, LIBXSTREAM_MAX_QSIZE);
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+  size_t position = 0;
+#if defined(LIBXSTREAM_STDFEATURES)
+  producer_enter(s);
+  position = s.tail.load(std::memory_order_relaxed);
+  for (;;) {
+    const segment_type *const segment = load(directory_slot(s, position));
+    const ptrdiff_t diff = 0 != segment ? static_cast<ptrdiff_t>(load(segment->sequence[LIBXSTREAM_MOD(position, LIBXSTREAM_QSEGMENT)]) - position) : -1;
+    if (0 == diff) { // slot is free; try to claim the position
+      if (s.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+    }
+    else if (0 < diff) { // position was claimed by another producer
+      position = s.tail.load(std::memory_order_relaxed);
+    }
+    else { // no segment yet, or the segment is still in use (previous lap)
+      install(position);
+      position = s.tail.load(std::memory_order_relaxed);
+    }
+  }
+  producer_leave(s);
 #else // generic
-  size_t& size = *static_cast<size_t*>(m_size);
   libxstream_lock *const lock = libxstream_lock_get(this);
   libxstream_lock_acquire(lock);
-  result = m_buffer + LIBXSTREAM_MOD(size++, LIBXSTREAM_MAX_QSIZE);
+  position = s.tail;
+  install(position);
+  s.tail = position + 1;
   libxstream_lock_release(lock);
 #endif
-  LIBXSTREAM_ASSERT(0 != result && result->queue() == this);
+  return claim(position);
+}
 
-  if (0 != result->item()) {
-    LIBXSTREAM_PRINT0(1, "queuing work is stalled!");
-    do { // stall if capacity is exceeded
-      this_thread_sleep();
-    }
-    while (0 != result->item());
+
+libxstream_workqueue::entry_type& libxstream_workqueue::allocate_entry()
+{
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+#if defined(LIBXSTREAM_STDFEATURES)
+  producer_enter(s);
+  const size_t position = s.tail.load(std::memory_order_relaxed);
+  install(position);
+  s.tail.store(position + 1, std::memory_order_relaxed);
+  producer_leave(s);
+#else
+  const size_t position = s.tail;
+  install(position);
+  s.tail = position + 1;
+#endif
+  return claim(position);
+}
+
+
+const libxstream_workqueue::entry_type* libxstream_workqueue::front() const
+{
+  using namespace libxstream_workqueue_internal;
+  const sync_type& s = sync(m_sync);
+  const size_t head = load(s.head), index = LIBXSTREAM_MOD(head, LIBXSTREAM_QSEGMENT);
+  const segment_type *const segment = load(directory_slot(s, head));
+  return (0 != segment && (head + 1) == load(segment->sequence[index])) ? (segment->entries + index) : 0;
+}
+
+
+libxstream_workqueue::entry_type* libxstream_workqueue::front()
+{
+  return const_cast<entry_type*>(static_cast<const libxstream_workqueue*>(this)->front());
+}
+
+
+const libxstream_workqueue::entry_type* libxstream_workqueue::back() const
+{
+  using namespace libxstream_workqueue_internal;
+  const sync_type& s = sync(m_sync);
+  const size_t head = load(s.head), tail = load(s.tail);
+  const segment_type *const segment = head != tail ? load(directory_slot(s, tail - 1)) : 0;
+  return 0 != segment ? (segment->entries + LIBXSTREAM_MOD(tail - 1, LIBXSTREAM_QSEGMENT)) : 0;
+}
+
+
+libxstream_workqueue::entry_type* libxstream_workqueue::back()
+{
+  return const_cast<entry_type*>(static_cast<const libxstream_workqueue*>(this)->back());
+}
+
+
+void libxstream_workqueue::pop()
+{
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+  const size_t head = load(s.head);
+#if defined(LIBXSTREAM_DEBUG)
+  const segment_type *const segment = load(directory_slot(s, head));
+  LIBXSTREAM_ASSERT(0 != segment && (head + 1) == load(segment->sequence[LIBXSTREAM_MOD(head, LIBXSTREAM_QSEGMENT)]));
+#endif
+  store(s.head, head + 1);
+  store(s.timeline->completed, s.base + head + 1);
+
+  if ((LIBXSTREAM_QSEGMENT) == (LIBXSTREAM_MOD(head, LIBXSTREAM_QSEGMENT) + 1)) { // segment is consumed
+    release(head);
   }
+}
+
+
+void libxstream_workqueue::install(size_t position)
+{
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+  const size_t first = position - LIBXSTREAM_MOD(position, LIBXSTREAM_QSEGMENT);
+  bool installed = false;
+#if defined(LIBXSTREAM_STDFEATURES) // a segment seen by a producer is not recycled by another queue (see release)
+  const segment_type *const current = load(directory_slot(s, position));
+  installed = 0 != current && first == load(current->first);
+#endif
 
-  return *result;
+  if (!installed) {
+    libxstream_lock_acquire(s.lock);
+    // a segment is installed when the tail reaches its first position
+    if (position == load(s.tail) && first == position) {
+      segment_type* segment = load(directory_slot(s, position));
+      if (0 != segment && first != load(segment->first)) {
+        // the slot is still occupied by the previous lap: the queue is full, and the directory is replaced
+        // by a directory of twice the size; a segment keeps its slot modulo the previous size
+        directory_type *const directory = load(s.directory);
+        directory_type *const larger = directory_create(2 * directory->size, directory);
+        for (size_t i = 0; i < directory->size; ++i) {
+          if (segment_type *const used = load(directory->slots[i])) {
+            store(larger->slots[LIBXSTREAM_MOD(load(used->first) / (LIBXSTREAM_QSEGMENT), larger->size)], used);
+          }
+        }
+        store(s.directory, larger);
+        segment = load(directory_slot(s, position));
+        LIBXSTREAM_ASSERT(0 == segment);
+      }
+      if (0 == segment) {
+        segment = load(s.spare);
+        if (0 != segment) {
+          store(s.spare, segment->next);
+        }
+        else {
+          segment = pool_pop();
+        }
+        for (size_t i = 0; i < (LIBXSTREAM_QSEGMENT); ++i) {
+          entry_type& entry = segment->entries[i];
+          // the status is kept since a waiting thread may still read the status of the previous use
+          entry.discard();
+          entry.m_queue = this;
+          store(entry.m_item, 0);
+          store(segment->sequence[i], first + i);
+        }
+        store(segment->first, first);
+        store(directory_slot(s, position), segment);
+      }
+    }
+    libxstream_lock_release(s.lock);
+  }
 }
 
 
-libxstream_workqueue::entry_type& libxstream_workqueue::allocate_entry()
+void libxstream_workqueue::release(size_t position)
 {
-  entry_type* result = 0;
+  using namespace libxstream_workqueue_internal;
+  sync_type& s = sync(m_sync);
+
+  libxstream_lock_acquire(s.lock);
+  segment_pointer& slot = directory_slot(s, position);
+  segment_type *const segment = load(slot);
+  LIBXSTREAM_ASSERT(0 != segment);
+  store(slot, 0);
+  segment->next = load(s.spare);
+  store(s.spare, segment);
 #if defined(LIBXSTREAM_STDFEATURES)
-  result = m_buffer + LIBXSTREAM_MOD(static_cast<std::atomic<size_t>*>(m_size)->fetch_add(1, std::memory_order_relaxed), LIBXSTREAM_MAX_QSIZE);
-#else
-  size_t& size = *static_cast<size_t*>(m_size);
-  result = m_buffer + LIBXSTREAM_MOD(size++, LIBXSTREAM_MAX_QSIZE);
+  // pairs with the fence in producer_leave i.e., the last producer gives the segment back otherwise
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (0 == load(s.nproducers)) { // no producer can still look at a released segment
+    spare_flush(s);
+  }
+#else // producers look at a segment only under the lock of the queue
+  spare_flush(s);
 #endif
-  LIBXSTREAM_ASSERT(0 != result && result->queue() == this);
+  libxstream_lock_release(s.lock);
+}
+
+
+libxstream_workqueue::entry_type& libxstream_workqueue::claim(size_t position)
+{
+  using namespace libxstream_workqueue_internal;
+  segment_type *const segment = load(directory_slot(sync(m_sync), position));
+  LIBXSTREAM_ASSERT(0 != segment);
+  entry_type& result = segment->entries[LIBXSTREAM_MOD(position, LIBXSTREAM_QSEGMENT)];
+  LIBXSTREAM_ASSERT(result.queue() == this && 0 == result.item());
+  result.m_position = position;
+  return result;
+}
+
+
+void libxstream_workqueue::publish(const entry_type& entry)
+{
+  using namespace libxstream_workqueue_internal;
+  LIBXSTREAM_ASSERT(entry.queue() == this);
+  segment_type *const segment = load(directory_slot(sync(m_sync), entry.m_position));
+  LIBXSTREAM_ASSERT(0 != segment);
+  store(segment->sequence[LIBXSTREAM_MOD(entry.m_position, LIBXSTREAM_QSEGMENT)], entry.m_position + 1);
+}
 
-  if (0 != result->item()) {
-    LIBXSTREAM_PRINT0(1, "queuing work is stalled!");
-    do { // stall if capacity is exceeded
-      this_thread_sleep();
+
+int libxstream_default_wait_policy()
+{
+  using namespace libxstream_workqueue_internal;
+  int result = wait_policy;
+  if (LIBXSTREAM_WAIT_DEFAULT == result) {
+    const char *const env = getenv("LIBXSTREAM_WAIT");
+    if (env && *env) {
+      switch (*env) {
+        case 's': case 'S': result = LIBXSTREAM_WAIT_SPIN; break;
+        case 'a': case 'A': result = LIBXSTREAM_WAIT_ADAPTIVE; break;
+        case 'b': case 'B': result = LIBXSTREAM_WAIT_BLOCK; break;
+        default: result = atoi(env);
+      }
+    }
+    if (LIBXSTREAM_WAIT_DEFAULT >= result || LIBXSTREAM_WAIT_BLOCK < result) {
+      result = LIBXSTREAM_WAIT_POLICY;
     }
-    while (0 != result->item());
+    wait_policy = result;
+  }
+  return result;
+}
+
+
+void libxstream_default_wait_policy(int policy)
+{
+  using namespace libxstream_workqueue_internal;
+  LIBXSTREAM_ASSERT(LIBXSTREAM_WAIT_DEFAULT <= policy && LIBXSTREAM_WAIT_BLOCK >= policy);
+  wait_policy = policy;
+}
+
+
+
+size_t libxstream_inflight(int device)
+{
+  using namespace libxstream_workqueue_internal;
+  const inflight_type& i = inflight();
+  return -1 > device ? load(i.total) : load(i.count[inflight_index(device)]);
+}
+
+
+int libxstream_inflight_wait(int device)
+{
+  using namespace libxstream_workqueue_internal;
+  const int policy = libxstream_default_wait_policy();
+  const size_t nspin = LIBXSTREAM_WAIT_SPIN == policy ? static_cast<size_t>(-1) : (LIBXSTREAM_WAIT_ADAPTIVE == policy ? (LIBXSTREAM_WAIT_NSPIN) : 0);
+
+  for (size_t i = 0; i < nspin && !inflight_drained(device); ++i) {
+    this_thread_yield();
+  }
+
+  if (!inflight_drained(device)) {
+#if defined(LIBXSTREAM_STDFEATURES)
+    inflight_type& i = inflight();
+    std::unique_lock<std::mutex> lock(i.mutex);
+    i.nwaiting.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst); // see inflight_sub
+    while (!inflight_drained(device)) i.condition.wait(lock);
+    i.nwaiting.fetch_sub(1);
+#else
+    size_t cycle = 0;
+    while (!inflight_drained(device)) this_thread_wait(cycle);
+#endif
   }
 
-  return *result;
+  return LIBXSTREAM_ERROR_NONE;
 }
 
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
@@ -33,28 +33,49 @@
 
 #include "libxstream.hpp"
 
+#include <libxstream_begin.h>
+#if defined(LIBXSTREAM_STDFEATURES)
+# include <atomic>
+#endif
+#include <libxstream_end.h>
+
 #if defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 
 
 class libxstream_workitem;
 
 
+/**
+ * Queue of work items (sequence-numbered ring with multiple producers). The sequence number of a slot
+ * tells whether the slot can be claimed, is ready to be executed, or is still in use. Slots are organized
+ * in segments of LIBXSTREAM_QSEGMENT entries which are installed on demand and recycled once consumed.
+ * The directory of segments doubles whenever the queue is full i.e., the size of a queue is not limited.
+ * An entry stores a copy of its work item in place; a work item is allocated only if it does not fit.
+ */
 class libxstream_workqueue {
 public:
   class entry_type {
   public:
+#if defined(LIBXSTREAM_STDFEATURES)
+    typedef std::atomic<libxstream_workitem*> item_type;
+    typedef std::atomic<int> status_type;
+#else
+    typedef libxstream_workitem *volatile item_type;
+    typedef volatile int status_type;
+#endif
     entry_type(libxstream_workqueue* queue = 0, libxstream_workitem* item = reinterpret_cast<libxstream_workitem*>(-1))
-      : m_status((0 != queue && 0 != item) ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION), m_queue(queue), m_dangling(0), m_item(item)
+      : m_status((0 != queue && 0 != item) ? LIBXSTREAM_ERROR_NONE : LIBXSTREAM_ERROR_CONDITION), m_queue(queue), m_dangling(0), m_position(0), m_item(item)
     {}
   public:
-    bool valid() const { return reinterpret_cast<libxstream_workitem*>(-1) != m_item; }
+    bool valid() const { return reinterpret_cast<libxstream_workitem*>(-1) != item(); }
     const libxstream_workqueue* queue() const { return m_queue; }
-    const libxstream_workitem* dangling() const { return m_dangling; }
-    const libxstream_workitem* item() const { return m_item; }
-    libxstream_workitem* item() { return m_item; }
-    int status() const { return m_status; }
-    int& status() { return m_status; }
+    const libxstream_workitem* item() const;
+    libxstream_workitem* item();
+    int status() const;
+    status_type& status() { return m_status; }
     void push(libxstream_workitem& workitem);
+    /** Publishes an invalid item which terminates the consumer of the queue. */
+    void terminate();
     /**
      * Wait until the workitem has been executed i.e., regardless of the thread owning the stream (any thread).
      * Otherwise the wait period is omitted if the current thread is still the same since enqueuing the item.
@@ -63,14 +84,22 @@ public:
     void execute();
     void pop();
   private:
-    mutable int m_status;
+    /** Destroys the item which remained from the previous use of the entry (if any). */
+    void discard();
+    bool completed(bool any_status) const;
+  private:
+    friend class libxstream_workqueue;
+    union { char data[LIBXSTREAM_WORKITEM_STORAGE]; double value; void* pointer; } m_storage;
+    mutable status_type m_status;
     libxstream_workqueue* m_queue;
-    const libxstream_workitem* m_dangling;
-    libxstream_workitem* m_item; // last
+    libxstream_workitem* m_dangling;
+    size_t m_position;
+    item_type m_item; // last
   };
 
 public:
-  libxstream_workqueue();
+  /** The work of the queue is counted for the given device (less than -1: global queue). */
+  explicit libxstream_workqueue(int device = -2);
   ~libxstream_workqueue();
 
 public:
@@ -79,47 +108,66 @@ public:
   entry_type& allocate_entry_mt();
   entry_type& allocate_entry();
 
-  const entry_type* front() const {
-#if defined(LIBXSTREAM_DEBUG)
-    return 0 < size() ? (m_buffer + LIBXSTREAM_MOD(m_index, LIBXSTREAM_MAX_QSIZE)) : 0;
-#else
-    return m_buffer + LIBXSTREAM_MOD(m_index, LIBXSTREAM_MAX_QSIZE);
-#endif
-  }
-
-  entry_type* front() {
-#if defined(LIBXSTREAM_DEBUG)
-    return 0 < size() ? (m_buffer + LIBXSTREAM_MOD(m_index, LIBXSTREAM_MAX_QSIZE)) : 0;
-#else
-    return m_buffer + LIBXSTREAM_MOD(m_index, LIBXSTREAM_MAX_QSIZE);
-#endif
-  }
+  /** Returns the entry to be executed next, or NULL if the item is not published yet. */
+  const entry_type* front() const;
+  entry_type* front();
+
+  /** Returns the most recently claimed entry (if any). */
+  const entry_type* back() const;
+  entry_type* back();
+
+  void pop();
+
+  /** Checks whether the next entry is published and ready to be executed. */
+  bool ready() const;
+
+  /**
+   * The queue is listed by the scheduler as long as it carries work. Enlisting returns true
+   * if the queue was not listed before (the caller lists the queue). Delisting returns true
+   * if work arrived meanwhile i.e., the caller lists the queue again.
+   */
+  bool enlist();
+  bool delist();
+  /** Checks whether the queue is listed by the scheduler or still owned by a worker. */
+  bool listed() const;
+
+  /**
+   * The timeline of the queue counts the completed entries. A ticket designates the completion of all entries
+   * which are enqueued so far. Timelines are never deallocated but recycled by subsequent queues, and they
+   * continue counting i.e., a ticket which is reached remains reached even after the queue is destroyed.
+   */
+  const void* timeline() const;
+  size_t ticket() const;
+  static bool reached(const void* timeline, size_t ticket);
+  static int wait(const void* timeline, size_t ticket);
+
+  /** Policy of waiting for an entry of this queue (libxstream_wait_policy); LIBXSTREAM_WAIT_DEFAULT designates the process-wide policy. */
+  int wait_policy() const;
+  void wait_policy(int policy);
 
-  const entry_type* back() const {
-    const size_t s = size();
-#if defined(LIBXSTREAM_DEBUG)
-    return 0 < s ? (m_buffer + LIBXSTREAM_MOD(s - 1, LIBXSTREAM_MAX_QSIZE)) : 0;
-#else
-    return m_buffer + LIBXSTREAM_MOD(s - 1, LIBXSTREAM_MAX_QSIZE);
-#endif
-  }
-
-  entry_type* back() {
-    const size_t s = size();
-#if defined(LIBXSTREAM_DEBUG)
-    return 0 < s ? (m_buffer + LIBXSTREAM_MOD(s - 1, LIBXSTREAM_MAX_QSIZE)) : 0;
-#else
-    return m_buffer + LIBXSTREAM_MOD(s - 1, LIBXSTREAM_MAX_QSIZE);
-#endif
-  }
+private:
+  libxstream_workqueue(const libxstream_workqueue& other);
+  libxstream_workqueue& operator=(const libxstream_workqueue& other);
 
-  void pop() { ++m_index; }
+  /** Installs the segment of the position if the tail reached its first position; grows the directory if the queue is full. */
+  void install(size_t position);
+  void release(size_t position);
+  entry_type& claim(size_t position);
+  void publish(const entry_type& entry);
 
 private:
-  entry_type m_buffer[LIBXSTREAM_MAX_QSIZE];
-  size_t m_index;
-  void* m_size;
+  void* m_sync; // segment directory, (padded) head and tail
 };
 
+
+/** Process-wide policy of waiting (libxstream_wait_policy); LIBXSTREAM_WAIT_DEFAULT restores the initial policy. */
+int libxstream_default_wait_policy();
+void libxstream_default_wait_policy(int policy);
+
+/** Number of work items which are enqueued but not completed yet (device less than -1: all work). */
+size_t libxstream_inflight(int device);
+/** Waits until the work of the device (and the global queue) is completed (device less than -1: all work). */
+int libxstream_inflight_wait(int device);
+
 #endif // defined(LIBXSTREAM_EXPORTED) || defined(__LIBXSTREAM)
 #endif // LIBXSTREAM_WORKQUEUE_HPP
@@ -40,77 +40,121 @@
 
 #include <string>
 
-extern "C"
-int pymic_internal_invoke_kernel(int device, libxstream_stream *stream, 
-                                 void *funcptr, size_t argc, 
-                                 const int64_t *dims, const int64_t *types, 
-                                 void **ptrs, const size_t *sizes) {
-    debug_enter();
-    
-    // generate the proper function signature for this kernel
-    libxstream_argument * signature = NULL;
-    libxstream_fn_signature(&signature);
+// map a pymic data type to the element type of an argument
+static libxstream_type map_dtype(int64_t type) {
+    switch(type) {
+    case pymic::dtype_int64:
+        return LIBXSTREAM_TYPE_I64;
+    case pymic::dtype_int32:
+        return LIBXSTREAM_TYPE_I32;
+    case pymic::dtype_float:
+        return LIBXSTREAM_TYPE_F64;
+    case pymic::dtype_complex:
+        return LIBXSTREAM_TYPE_C64;
+    case pymic::dtype_uint64:
+        return LIBXSTREAM_TYPE_U64;
+    case pymic::dtype_float32:
+        return LIBXSTREAM_TYPE_F32;
+    default:
+        return LIBXSTREAM_TYPE_INVALID;
+    }
+}
+
+// construct the function signature of a kernel; without ptrs, the arguments are zero;
+// the extents of an array (fastest-varying first) are at shapes[i*PYMIC_MAX_NDIMS]
+static int build_signature(libxstream_argument *signature, size_t argc, 
+                           const int64_t *dims, const int64_t *types, 
+                           void **ptrs, const size_t *sizes, 
+                           const int64_t *shapes) {
     for (int i = 0; i < argc; ++i) {
         int64_t dim = dims[i];
-        int64_t type = types[i];
-        void *ptr = ptrs[i];
+        libxstream_type type = map_dtype(types[i]);
+        void *ptr = ptrs ? ptrs[i] : NULL;
         size_t size = static_cast<size_t>(sizes[i]);
-        libxstream_type scalar_type;
-        size_t scalar_size = 1;
-        switch (dim) {
-        case 0: // argument is a scalar value
+        size_t shape[PYMIC_MAX_NDIMS];
+        if (dim == 0) { // argument is a scalar value
             // in case of a scalar value, the ptr is a host pointer
-            switch(type) {
-            case pymic::dtype_int64:
-                scalar_type = LIBXSTREAM_TYPE_I64;
-                break;
-            case pymic::dtype_int32:
-                scalar_type = LIBXSTREAM_TYPE_I32;
-                break;
-            case pymic::dtype_float:
-                scalar_type = LIBXSTREAM_TYPE_F64;
-                break;
-            case pymic::dtype_complex:
-                scalar_type = LIBXSTREAM_TYPE_C64;
-                break;
-            case pymic::dtype_uint64:
-                scalar_type = LIBXSTREAM_TYPE_U64;
-                break;
-            default:
+            if (type == LIBXSTREAM_TYPE_INVALID || 
+                libxstream_fn_input(signature, i, ptr, type, 0, NULL) != LIBXSTREAM_ERROR_NONE) {
                 printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
-                debug_leave();
                 return 1;
             }
-            if (libxstream_fn_input(signature, i, ptr, scalar_type, dim, NULL) != LIBXSTREAM_ERROR_NONE) {
-                printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
-                debug_leave();
-                return 1;
-            };
-            break;
-        case 1: // argument is an array
-            // in case of an array, the ptr is a fake pointer
-            if (libxstream_fn_inout(signature, i, ptr, LIBXSTREAM_TYPE_BYTE, dim, &size) != LIBXSTREAM_ERROR_NONE) {
+        }
+        else if (0 < dim && dim <= PYMIC_MAX_NDIMS) { // argument is an array
+            // in case of an array, the ptr is a fake pointer; an array without 
+            // a known element type (or shape) is passed as bytes
+            if (type == LIBXSTREAM_TYPE_INVALID || shapes == NULL) {
+                type = LIBXSTREAM_TYPE_BYTE;
+                dim = 1;
+                shape[0] = size;
+            }
+            else {
+                for (int d = 0; d < dim; ++d) {
+                    shape[d] = static_cast<size_t>(shapes[i * PYMIC_MAX_NDIMS + d]);
+                }
+            }
+            if (libxstream_fn_inout(signature, i, ptr, type, dim, shape) != LIBXSTREAM_ERROR_NONE) {
                 printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
-                debug_leave();
                 return 1;
             }
-            break;
-        default:
+        }
+        else {
             printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
-            debug_leave();
             return 1;
         }
     }
+    return 0;
+}
+
+// kernels with more arguments than the positional calling convention supports 
+// receive the argument block (libxstream_argument*) as their only argument
+static int create_signature(libxstream_argument **signature, size_t argc, int *flags) {
+    *flags = LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_NATIVE;
+    if (argc <= LIBXSTREAM_MAX_NARGS) {
+        return libxstream_fn_signature(signature);
+    }
+    *flags |= LIBXSTREAM_CALL_PACKED;
+    return libxstream_fn_create_signature(signature, argc);
+}
+
+static int destroy_signature(libxstream_argument *signature, size_t argc) {
+    return argc <= LIBXSTREAM_MAX_NARGS ? libxstream_fn_clear_signature(signature) 
+                                        : libxstream_fn_destroy_signature(signature);
+}
+
+
+extern "C"
+int pymic_internal_invoke_kernel(int device, libxstream_stream *stream, 
+                                 void *funcptr, size_t argc, 
+                                 const int64_t *dims, const int64_t *types, 
+                                 void **ptrs, const size_t *sizes, 
+                                 const int64_t *shapes) {
+    debug_enter();
     
-    // invoke function and clear function signature
+    // generate the proper function signature for this kernel
+    libxstream_argument * signature = NULL;
+    int flags = 0;
+    if (create_signature(&signature, argc, &flags) != LIBXSTREAM_ERROR_NONE) {
+        printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+        debug_leave();
+        return 1;
+    }
+    if (build_signature(signature, argc, dims, types, ptrs, sizes, shapes) != 0) {
+        destroy_signature(signature, argc);
+        debug_leave();
+        return 1;
+    }
+    
+    // invoke function and clear function signature (the call takes a copy)
     if (libxstream_fn_call(reinterpret_cast<libxstream_function>(funcptr), signature, 
-                           stream, LIBXSTREAM_CALL_DEFAULT | LIBXSTREAM_CALL_NATIVE) != LIBXSTREAM_ERROR_NONE) {
+                           stream, flags) != LIBXSTREAM_ERROR_NONE) {
         printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+        destroy_signature(signature, argc);
         debug_leave();
         return 1;
     }
 
-    if (libxstream_fn_clear_signature(signature) != LIBXSTREAM_ERROR_NONE) {
+    if (destroy_signature(signature, argc) != LIBXSTREAM_ERROR_NONE) {
         printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
         debug_leave();
         return 1;
@@ -121,6 +165,59 @@ int pymic_internal_invoke_kernel(int device, libxstream_stream *stream,
 }                                     
 
 
+extern "C"
+int pymic_internal_prepare_kernel(int device, void *funcptr, size_t argc, 
+                                  const int64_t *dims, const int64_t *types, 
+                                  const size_t *sizes, const int64_t *shapes, 
+                                  libxstream_plan **plan) {
+    debug_enter();
+    
+    // the signature is built once and frozen by the plan
+    libxstream_argument * signature = NULL;
+    int flags = 0;
+    if (create_signature(&signature, argc, &flags) != LIBXSTREAM_ERROR_NONE) {
+        printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+        debug_leave();
+        return 1;
+    }
+    int result = build_signature(signature, argc, dims, types, NULL, sizes, shapes);
+    if (result == 0 && 
+        libxstream_fn_plan(plan, reinterpret_cast<libxstream_function>(funcptr), signature, 
+                           flags) != LIBXSTREAM_ERROR_NONE) {
+        printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+        result = 1;
+    }
+    destroy_signature(signature, argc);
+    
+    debug_leave();
+    return result;
+}
+
+
+extern "C"
+int pymic_internal_invoke_prepared(int device, libxstream_stream *stream, 
+                                   libxstream_plan *plan, size_t argc, void **ptrs) {
+    debug_enter();
+    
+    // patch the pointers (arrays) and values (scalars), and invoke the kernel
+    for (int i = 0; i < argc; ++i) {
+        if (libxstream_plan_set_arg(plan, i, ptrs[i]) != LIBXSTREAM_ERROR_NONE) {
+            printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+            debug_leave();
+            return 1;
+        }
+    }
+    if (libxstream_plan_call(plan, stream) != LIBXSTREAM_ERROR_NONE) {
+        printf("WHOOOOP at %s:%d\n", __FUNCTION__, __LINE__);
+        debug_leave();
+        return 1;
+    }
+    
+    debug_leave();
+    return 0;
+}
+
+
 extern "C"
 int pymic_internal_load_library(int device, const char *filename, int64_t *handle, char **tempfile) {
     debug_enter();
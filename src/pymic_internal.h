@@ -12,7 +12,14 @@ extern "C" {
 int pymic_internal_invoke_kernel(int device, libxstream_stream *stream, 
                                  void *funcptr, size_t argc, 
                                  const int64_t *dims, const int64_t *types, 
-                                 void **ptrs, const size_t *sizes);
+                                 void **ptrs, const size_t *sizes, 
+                                 const int64_t *shapes);
+int pymic_internal_prepare_kernel(int device, void *funcptr, size_t argc, 
+                                  const int64_t *dims, const int64_t *types, 
+                                  const size_t *sizes, const int64_t *shapes, 
+                                  libxstream_plan **plan);
+int pymic_internal_invoke_prepared(int device, libxstream_stream *stream, 
+                                   libxstream_plan *plan, size_t argc, void **ptrs);
 int pymic_internal_load_library(int device, const char *filename, 
                                 int64_t *handle, char **tempfile);
 int pymic_internal_unload_library(int device, int64_t handle, const char *tempfile);
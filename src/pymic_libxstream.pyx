@@ -32,23 +32,70 @@ from cpython.version cimport PY_MAJOR_VERSION
 from pymic.offload_error import OffloadError
 
 from libc.stdint cimport int64_t
+from libc.stdlib cimport malloc, free
+from libc.stdio cimport fprintf, stderr
+from libc.errno cimport errno, EINTR
+from posix.unistd cimport write
 
 
 cdef extern from "libxstream/include/libxstream.h":
+    enum: LIBXSTREAM_MEM_NBINS
+    ctypedef struct libxstream_mem_statistics:
+        size_t live
+        size_t peak
+        size_t nlive
+        size_t nallocs
+        size_t acquired
+        size_t cached
+        size_t nsegments
+        size_t ntags
+        size_t histogram[LIBXSTREAM_MEM_NBINS]
     ctypedef void libxstream_stream 
+    ctypedef void libxstream_graph
+    ctypedef void libxstream_plan
+    ctypedef void libxstream_event
+    ctypedef void (*libxstream_callback)(libxstream_stream *stream, void *userdata)
     int libxstream_get_ndevices(size_t *ndevices)
+    int libxstream_stream_priority_range(int *least, int *greatest)
+    int libxstream_stream_priority_default(int *priority)
     int libxstream_stream_create(libxstream_stream **stream, int device, int priority, const char* name)
     int libxstream_stream_destroy(const libxstream_stream* stream)
     int libxstream_stream_wait(libxstream_stream *stream)
+    int libxstream_stream_wait_event(libxstream_stream *stream, const libxstream_event *event)
+    int libxstream_stream_begin_capture(libxstream_stream *stream)
+    int libxstream_stream_end_capture(libxstream_stream *stream, libxstream_graph **graph)
+    int libxstream_stream_add_callback(libxstream_stream *stream, libxstream_callback callback, void *userdata)
+    int libxstream_graph_destroy(const libxstream_graph *graph)
+    int libxstream_graph_set_arg(libxstream_graph *graph, size_t node, size_t arg, const void *value)
+    int libxstream_graph_launch(libxstream_graph *graph, libxstream_stream *stream)
+    int libxstream_plan_destroy(const libxstream_plan *plan)
+    int libxstream_event_create(libxstream_event **event)
+    int libxstream_event_create_timed(libxstream_event **event)
+    int libxstream_event_destroy(const libxstream_event *event)
+    int libxstream_event_record(libxstream_event *event, libxstream_stream *stream)
+    int libxstream_event_query(const libxstream_event *event, int *occurred)
+    int libxstream_event_wait(libxstream_event *event)
+    int libxstream_event_elapsed(const libxstream_event *start, const libxstream_event *end, double *ms)
     int libxstream_mem_allocate(int device, void **memory, size_t size, size_t alignment)
     int libxstream_mem_deallocate(int device, const void *memory)
+    int libxstream_mem_deallocate_async(int device, const void *memory, libxstream_stream *stream)
+    int libxstream_mem_trim(int device, size_t *size)
+    int libxstream_mem_cache_info(int device, size_t *hits, size_t *misses, size_t *cached)
+    int libxstream_mem_stats(int device, libxstream_mem_statistics *stats)
+    int libxstream_mem_set_tag(int device, const void *memory, const char *tag)
+    int libxstream_mem_tag_stats(int device, size_t i, const char **tag, size_t *live, size_t *nlive)
     int libxstream_memcpy_h2d(const void *host_mem, void *dev_mem, size_t size, libxstream_stream* stream)
     int libxstream_memcpy_d2h(const void *dev_mem, void *host_mem, size_t size, libxstream_stream* stream)
     int libxstream_memcpy_d2d(const void *src, void *dst, size_t size, libxstream_stream* stream)
+    int libxstream_memcpy_h2d_striped(const void *host_mem, void *dev_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream)
+    int libxstream_memcpy_d2h_striped(const void *dev_mem, void *host_mem, size_t size, size_t chunk, size_t nstreams, libxstream_stream* stream)
 
 cdef extern from "pymic_internal.h":
     ctypedef void libxstream_stream
-    int pymic_internal_invoke_kernel(int device, libxstream_stream *stream, void *funcptr, size_t argc, const int64_t *dims, const int64_t *types, void **ptrs, const size_t *sizes)
+    ctypedef void libxstream_plan
+    int pymic_internal_invoke_kernel(int device, libxstream_stream *stream, void *funcptr, size_t argc, const int64_t *dims, const int64_t *types, void **ptrs, const size_t *sizes, const int64_t *shapes)
+    int pymic_internal_prepare_kernel(int device, void *funcptr, size_t argc, const int64_t *dims, const int64_t *types, const size_t *sizes, const int64_t *shapes, libxstream_plan **plan)
+    int pymic_internal_invoke_prepared(int device, libxstream_stream *stream, libxstream_plan *plan, size_t argc, void **ptrs)
     int pymic_internal_load_library(int device, const char *filename, int64_t *handle, char **tempfile)
     int pymic_internal_unload_library(int device, int64_t handle, const char *tempfile)
     int pymic_internal_find_kernel(int device, int64_t handle, const char *kernel_name, int64_t *kernel_ptr)
@@ -65,19 +112,46 @@ def pymic_get_ndevices():
     return _c_pymic_get_ndevices()
 
 ################################################################################
-cdef _c_pymic_stream_create(int device_id, const char *stream_name):
+cdef _c_pymic_stream_priority_range():
+    cdef int least
+    cdef int greatest
+    cdef int err
+    err = libxstream_stream_priority_range(&least, &greatest)
+    if err != 0:
+        raise OffloadError('Could not query the range of stream priorities')
+    return (least, greatest)
+
+def pymic_stream_priority_range():
+    return _c_pymic_stream_priority_range()
+
+################################################################################
+cdef _c_pymic_stream_priority_default():
+    cdef int priority
+    cdef int err
+    err = libxstream_stream_priority_default(&priority)
+    if err != 0:
+        raise OffloadError('Could not query the default stream priority')
+    return priority
+
+def pymic_stream_priority_default():
+    return _c_pymic_stream_priority_default()
+
+################################################################################
+cdef _c_pymic_stream_create(int device_id, const char *stream_name, int priority):
     cdef libxstream_stream *stream
     cdef int err
-    err = libxstream_stream_create(&stream, device_id, 0, stream_name)
+    err = libxstream_stream_create(&stream, device_id, priority, stream_name)
     if err != 0:
         raise OffloadError('Could not create stream for device {0}'.format(device_id))
     return <int64_t>stream
     
-def pymic_stream_create(device_id, stream_name = 'stream'):
+def pymic_stream_create(device_id, stream_name = 'stream', priority = None):
     if PY_MAJOR_VERSION > 2:
         if isinstance(stream_name, str):
             stream_name = bytes(stream_name, 'ascii')
-    return _c_pymic_stream_create(device_id, stream_name)
+    if priority is None:
+        priority = _c_pymic_stream_priority_default()
+    return _c_pymic_stream_create(device_id, stream_name, priority)
 
 ################################################################################
 cdef _c_pymic_stream_destroy(int device_id, int64_t stream_id):
@@ -106,6 +180,239 @@ def pymic_stream_sync(device_id, stream_id):
     _c_pymic_stream_sync(device_id, stream_id)
     return None
     
+################################################################################
+cdef _c_pymic_stream_wait_event(int device_id, int64_t stream_id, int64_t event_id):
+    cdef libxstream_stream *stream
+    cdef const libxstream_event *event
+    cdef int err
+    stream = <libxstream_stream *>stream_id
+    event = <const libxstream_event *>event_id
+    err = libxstream_stream_wait_event(stream, event)
+    if err != 0:
+        raise OffloadError('Could not make stream 0x{0:x} wait for event 0x{1:x} on device {2}'.format(stream_id, event_id, device_id))
+    return None
+
+def pymic_stream_wait_event(device_id, stream_id, event_id):
+    _c_pymic_stream_wait_event(device_id, stream_id, event_id)
+    return None
+    
+################################################################################
+cdef _c_pymic_stream_begin_capture(int device_id, int64_t stream_id):
+    cdef libxstream_stream *stream
+    cdef int err
+    stream = <libxstream_stream *>stream_id
+    err = libxstream_stream_begin_capture(stream)
+    if err != 0:
+        raise OffloadError('Could not begin capturing stream 0x{0:x} on device {1}'.format(stream_id, device_id))
+    return None
+
+def pymic_stream_begin_capture(device_id, stream_id):
+    _c_pymic_stream_begin_capture(device_id, stream_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_stream_end_capture(int device_id, int64_t stream_id):
+    cdef libxstream_stream *stream
+    cdef libxstream_graph *graph
+    cdef int err
+    stream = <libxstream_stream *>stream_id
+    err = libxstream_stream_end_capture(stream, &graph)
+    if err != 0:
+        raise OffloadError('Could not end capturing stream 0x{0:x} on device {1}'.format(stream_id, device_id))
+    return <int64_t>graph
+
+def pymic_stream_end_capture(device_id, stream_id):
+    return _c_pymic_stream_end_capture(device_id, stream_id)
+
+    
+################################################################################
+ctypedef struct _pymic_callback_data:
+    int fd
+    int64_t token
+
+cdef void _c_pymic_callback(libxstream_stream *stream, void *userdata) nogil:
+    # runs on a runtime thread without taking the GIL; the token is passed
+    # to the callback thread (fd) which calls the Python function
+    cdef _pymic_callback_data *data = <_pymic_callback_data *>userdata
+    cdef const char *buffer = <const char *>&data.token
+    cdef size_t remaining = sizeof(data.token)
+    cdef ssize_t n
+    while remaining > 0:
+        n = write(data.fd, buffer, remaining)
+        if n < 0:
+            if errno == EINTR:
+                continue
+            fprintf(stderr, "pymic: could not pass callback %lli (errno %i)\n",
+                    <long long>data.token, errno)
+            break
+        buffer += n
+        remaining -= n
+    free(data)
+
+cdef _c_pymic_stream_add_callback(int device_id, int64_t stream_id, int fd, int64_t token):
+    cdef libxstream_stream *stream
+    cdef _pymic_callback_data *data
+    cdef int err
+    stream = <libxstream_stream *>stream_id
+    data = <_pymic_callback_data *>malloc(sizeof(_pymic_callback_data))
+    if data == NULL:
+        raise MemoryError()
+    data.fd = fd
+    data.token = token
+    err = libxstream_stream_add_callback(stream, _c_pymic_callback, <void *>data)
+    if err != 0:
+        free(data)
+        raise OffloadError('Could not add callback to stream 0x{0:x} on device {1}'.format(stream_id, device_id))
+    return None
+
+def pymic_stream_add_callback(device_id, stream_id, fd, token):
+    _c_pymic_stream_add_callback(device_id, stream_id, fd, token)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_graph_destroy(int device_id, int64_t graph_id):
+    cdef const libxstream_graph *graph
+    cdef int err
+    graph = <const libxstream_graph *>graph_id
+    err = libxstream_graph_destroy(graph)
+    if err != 0:
+        raise OffloadError('Could not destroy graph 0x{0:x} on device {1}'.format(graph_id, device_id))
+    return None
+
+def pymic_graph_destroy(device_id, graph_id):
+    _c_pymic_graph_destroy(device_id, graph_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_graph_set_arg(int device_id, int64_t graph_id, size_t node, size_t arg, int64_t value):
+    cdef libxstream_graph *graph
+    cdef int err
+    graph = <libxstream_graph *>graph_id
+    err = libxstream_graph_set_arg(graph, node, arg, <const void *>value)
+    if err != 0:
+        raise OffloadError('Could not patch argument {0} of node {1} of graph 0x{2:x} on device {3}'.format(arg, node, graph_id, device_id))
+    return None
+
+def pymic_graph_set_arg(device_id, graph_id, node, arg, value):
+    _c_pymic_graph_set_arg(device_id, graph_id, node, arg, value)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_graph_launch(int device_id, int64_t graph_id, int64_t stream_id):
+    cdef libxstream_graph *graph
+    cdef libxstream_stream *stream
+    cdef int err
+    graph = <libxstream_graph *>graph_id
+    stream = <libxstream_stream *>stream_id
+    err = libxstream_graph_launch(graph, stream)
+    if err != 0:
+        raise OffloadError('Could not launch graph 0x{0:x} through stream 0x{1:x} on device {2}'.format(graph_id, stream_id, device_id))
+    return None
+
+def pymic_graph_launch(device_id, graph_id, stream_id):
+    _c_pymic_graph_launch(device_id, graph_id, stream_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_event_create(int device_id, int timed):
+    cdef libxstream_event *event
+    cdef int err
+    if timed:
+        err = libxstream_event_create_timed(&event)
+    else:
+        err = libxstream_event_create(&event)
+    if err != 0:
+        raise OffloadError('Could not create event for device {0}'.format(device_id))
+    return <int64_t>event
+
+def pymic_event_create(device_id, timed = True):
+    return _c_pymic_event_create(device_id, 1 if timed else 0)
+
+    
+################################################################################
+cdef _c_pymic_event_destroy(int device_id, int64_t event_id):
+    cdef const libxstream_event *event
+    cdef int err
+    event = <const libxstream_event *>event_id
+    err = libxstream_event_destroy(event)
+    if err != 0:
+        raise OffloadError('Could not destroy event 0x{0:x} on device {1}'.format(event_id, device_id))
+    return None
+
+def pymic_event_destroy(device_id, event_id):
+    _c_pymic_event_destroy(device_id, event_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_event_record(int device_id, int64_t event_id, int64_t stream_id):
+    cdef libxstream_event *event
+    cdef libxstream_stream *stream
+    cdef int err
+    event = <libxstream_event *>event_id
+    stream = <libxstream_stream *>stream_id
+    err = libxstream_event_record(event, stream)
+    if err != 0:
+        raise OffloadError('Could not record event 0x{0:x} into stream 0x{1:x} on device {2}'.format(event_id, stream_id, device_id))
+    return None
+
+def pymic_event_record(device_id, event_id, stream_id):
+    _c_pymic_event_record(device_id, event_id, stream_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_event_query(int device_id, int64_t event_id):
+    cdef const libxstream_event *event
+    cdef int occurred
+    cdef int err
+    event = <const libxstream_event *>event_id
+    err = libxstream_event_query(event, &occurred)
+    if err != 0:
+        raise OffloadError('Could not query event 0x{0:x} on device {1}'.format(event_id, device_id))
+    return occurred != 0
+
+def pymic_event_query(device_id, event_id):
+    return _c_pymic_event_query(device_id, event_id)
+
+    
+################################################################################
+cdef _c_pymic_event_sync(int device_id, int64_t event_id):
+    cdef libxstream_event *event
+    cdef int err
+    event = <libxstream_event *>event_id
+    err = libxstream_event_wait(event)
+    if err != 0:
+        raise OffloadError('Could not sync event 0x{0:x} on device {1}'.format(event_id, device_id))
+    return None
+
+def pymic_event_sync(device_id, event_id):
+    _c_pymic_event_sync(device_id, event_id)
+    return None
+
+    
+################################################################################
+cdef _c_pymic_event_elapsed(int device_id, int64_t start_id, int64_t end_id):
+    cdef const libxstream_event *start
+    cdef const libxstream_event *end
+    cdef double ms
+    cdef int err
+    start = <const libxstream_event *>start_id
+    end = <const libxstream_event *>end_id
+    err = libxstream_event_elapsed(start, end, &ms)
+    if err != 0:
+        raise OffloadError('Could not measure the time between event 0x{0:x} and event 0x{1:x} on device {2}'.format(start_id, end_id, device_id))
+    return ms
+
+def pymic_event_elapsed(device_id, start_id, end_id):
+    return _c_pymic_event_elapsed(device_id, start_id, end_id)
+
+    
 ################################################################################
 cdef _c_pymic_stream_allocate(int device_id, size_t nbytes, size_t alignment):
     cdef void *device_ptr
@@ -119,17 +426,92 @@ def pymic_stream_allocate(device_id, stream_id, nbytes, alignment):
     return _c_pymic_stream_allocate(device_id, nbytes, alignment)
 
 ################################################################################
-cdef _c_pymic_stream_deallocate(int device_id, int64_t device_ptr):
+cdef _c_pymic_stream_deallocate(int device_id, int64_t stream_id, int64_t device_ptr, int sync):
+    cdef libxstream_stream *stream
     cdef void *ptr
     cdef err
     ptr = <void *>device_ptr
-    err = libxstream_mem_deallocate(device_id, ptr)
+    if sync:
+        err = libxstream_mem_deallocate(device_id, ptr)
+    else:
+        stream = <libxstream_stream *>stream_id
+        err = libxstream_mem_deallocate_async(device_id, ptr, stream)
     if err != 0:
         raise OffloadError('Could not deallocate memory on device {0}'.format(device_id))
     return None
 
-def pymic_stream_deallocate(device_id, stream_id, device_ptr):
-    _c_pymic_stream_deallocate(device_id, device_ptr)
+def pymic_stream_deallocate(device_id, stream_id, device_ptr, sync=True):
+    _c_pymic_stream_deallocate(device_id, stream_id, device_ptr, sync)
+    return None
+
+################################################################################
+cdef _c_pymic_memory_trim(int device_id):
+    cdef size_t size
+    cdef int err
+    err = libxstream_mem_trim(device_id, &size)
+    if err != 0:
+        raise OffloadError('Could not trim the memory cache of device {0}'.format(device_id))
+    return size
+
+def pymic_memory_trim(device_id):
+    return _c_pymic_memory_trim(device_id)
+
+################################################################################
+cdef _c_pymic_memory_cache_info(int device_id):
+    cdef size_t hits
+    cdef size_t misses
+    cdef size_t cached
+    cdef int err
+    err = libxstream_mem_cache_info(device_id, &hits, &misses, &cached)
+    if err != 0:
+        raise OffloadError('Could not query the memory cache of device {0}'.format(device_id))
+    return (hits, misses, cached)
+
+def pymic_memory_cache_info(device_id):
+    return _c_pymic_memory_cache_info(device_id)
+
+################################################################################
+cdef _c_pymic_memory_stats(int device_id):
+    cdef libxstream_mem_statistics stats
+    cdef const char *tag
+    cdef size_t live
+    cdef size_t nlive
+    cdef size_t i
+    cdef int err
+    err = libxstream_mem_stats(device_id, &stats)
+    if err != 0:
+        raise OffloadError('Could not query the memory statistics of device {0}'.format(device_id))
+    tags = {}
+    for i in range(stats.ntags):
+        err = libxstream_mem_tag_stats(device_id, i, &tag, &live, &nlive)
+        if err == 0 and nlive > 0:
+            name = tag
+            if PY_MAJOR_VERSION > 2:
+                name = name.decode('utf-8', 'replace')
+            tags[name] = (live, nlive)
+    return {'live': stats.live, 'peak': stats.peak,
+            'nlive': stats.nlive, 'nallocs': stats.nallocs,
+            'acquired': stats.acquired, 'cached': stats.cached,
+            'nsegments': stats.nsegments,
+            'histogram': [stats.histogram[i] for i in range(LIBXSTREAM_MEM_NBINS)],
+            'tags': tags}
+
+def pymic_memory_stats(device_id):
+    return _c_pymic_memory_stats(device_id)
+
+################################################################################
+cdef _c_pymic_memory_set_tag(int device_id, int64_t device_ptr, const char *tag):
+    cdef int err
+    err = libxstream_mem_set_tag(device_id, <void *>device_ptr, tag)
+    if err != 0:
+        raise OffloadError('Could not tag memory on device {0}'.format(device_id))
+    return None
+
+def pymic_memory_set_tag(device_id, device_ptr, tag):
+    if PY_MAJOR_VERSION > 2:
+        if isinstance(tag, str):
+            tag = bytes(tag, 'utf-8')
+    _c_pymic_memory_set_tag(device_id, device_ptr, tag)
     return None
     
 ################################################################################
@@ -147,34 +529,40 @@ def pymic_stream_translate_device_pointer(device_id, stream_id, device_ptr):
     return _c_pymic_stream_translate_device_pointer(device_id, stream_id, device_ptr)
 
 ################################################################################
-cdef _c_pymic_stream_memcpy_h2d(int device_id, int64_t stream_id, int64_t host_ptr, int64_t device_ptr, size_t nbytes):
+cdef _c_pymic_stream_memcpy_h2d(int device_id, int64_t stream_id, int64_t host_ptr, int64_t device_ptr, size_t nbytes, int parallel):
     cdef libxstream_stream *stream
     cdef int err
     stream = <libxstream_stream *>stream_id
-    err = libxstream_memcpy_h2d(<void *>host_ptr, <void *>device_ptr, nbytes, stream)
+    if parallel:
+        err = libxstream_memcpy_h2d_striped(<void *>host_ptr, <void *>device_ptr, nbytes, 0, 0, stream)
+    else:
+        err = libxstream_memcpy_h2d(<void *>host_ptr, <void *>device_ptr, nbytes, stream)
     if err != 0:
         raise OffloadError('Could not copy memory from host to device through stream 0x{0:x} on device {1}'.format(stream_id, device_id))
     return None
 
 def pymic_stream_memcpy_h2d(device_id, stream_id, host_ptr, device_ptr,
-                            nbytes, offset_host, offset_device):
-    _c_pymic_stream_memcpy_h2d(device_id, stream_id, host_ptr + offset_host, device_ptr + offset_device, nbytes)
+                            nbytes, offset_host, offset_device, parallel=False):
+    _c_pymic_stream_memcpy_h2d(device_id, stream_id, host_ptr + offset_host, device_ptr + offset_device, nbytes, parallel)
     return None
 
     
 ################################################################################
-cdef _c_pymic_stream_memcpy_d2h(int device_id, int64_t stream_id, int64_t device_ptr, int64_t host_ptr, size_t nbytes):
+cdef _c_pymic_stream_memcpy_d2h(int device_id, int64_t stream_id, int64_t device_ptr, int64_t host_ptr, size_t nbytes, int parallel):
     cdef libxstream_stream *stream
     cdef int err
     stream = <libxstream_stream *>stream_id
-    err = libxstream_memcpy_d2h(<void *>device_ptr, <void *>host_ptr, nbytes, stream)
+    if parallel:
+        err = libxstream_memcpy_d2h_striped(<void *>device_ptr, <void *>host_ptr, nbytes, 0, 0, stream)
+    else:
+        err = libxstream_memcpy_d2h(<void *>device_ptr, <void *>host_ptr, nbytes, stream)
     if err != 0:
         raise OffloadError('Could not copy memory from device to host through stream 0x{0:x} on device {1}'.format(stream_id, device_id))
     return None
 
 def pymic_stream_memcpy_d2h(device_id, stream_id, device_ptr, host_ptr,
-                            nbytes, offset_device, offset_host):
-    _c_pymic_stream_memcpy_d2h(device_id, stream_id, device_ptr + offset_device, host_ptr + offset_host, nbytes)
+                            nbytes, offset_device, offset_host, parallel=False):
+    _c_pymic_stream_memcpy_d2h(device_id, stream_id, device_ptr + offset_device, host_ptr + offset_host, nbytes, parallel)
     return None
                             
     
@@ -196,28 +584,83 @@ def pymic_stream_memcpy_d2d(device_id, stream_id, device_ptr_src,
     
 ################################################################################
 cdef _c_pymic_stream_invoke_kernel(int device_id, int64_t stream_id, int64_t kernel, 
-                                   size_t argc, const int64_t *dims, const int64_t *types, void **ptrs, const size_t *sizes):
+                                   size_t argc, const int64_t *dims, const int64_t *types, void **ptrs, const size_t *sizes, const int64_t *shapes):
     cdef int err
     cdef libxstream_stream *stream
     stream = <libxstream_stream *>stream_id
-    err = pymic_internal_invoke_kernel(device_id, stream, <void *>kernel, argc, dims, types, ptrs, sizes)
+    err = pymic_internal_invoke_kernel(device_id, stream, <void *>kernel, argc, dims, types, ptrs, sizes, shapes)
     if err != 0:
         raise OffloadError('Could not invoke kernel through stream 0x{0:x} on device {1}'.format(stream_id, device_id))
     return None
 
 def pymic_stream_invoke_kernel(device_id, stream_id, kernel, argc, 
-                               arg_dims, arg_types, arg_ptrs, arg_sizes):
+                               arg_dims, arg_types, arg_ptrs, arg_sizes, arg_shapes):
     cdef int64_t arg_dims_ptr 
     cdef int64_t arg_types_ptr
     cdef int64_t arg_ptrs_ptr
     cdef int64_t arg_sizes_ptr
+    cdef int64_t arg_shapes_ptr
     
     arg_dims_ptr = arg_dims.ctypes.data
     arg_types_ptr = arg_types.ctypes.data
     arg_ptrs_ptr = arg_ptrs.ctypes.data
     arg_sizes_ptr = arg_sizes.ctypes.data
+    arg_shapes_ptr = arg_shapes.ctypes.data
     
-    _c_pymic_stream_invoke_kernel(device_id, stream_id, kernel, argc, <int64_t*>arg_dims_ptr, <int64_t*>arg_types_ptr, <void**>arg_ptrs_ptr, <size_t*>arg_sizes_ptr)
+    _c_pymic_stream_invoke_kernel(device_id, stream_id, kernel, argc, <int64_t*>arg_dims_ptr, <int64_t*>arg_types_ptr, <void**>arg_ptrs_ptr, <size_t*>arg_sizes_ptr, <int64_t*>arg_shapes_ptr)
+    return None
+    
+################################################################################
+cdef _c_pymic_kernel_prepare(int device_id, int64_t kernel, size_t argc, const int64_t *dims, const int64_t *types, const size_t *sizes, const int64_t *shapes):
+    cdef libxstream_plan *plan
+    cdef int err
+    err = pymic_internal_prepare_kernel(device_id, <void *>kernel, argc, dims, types, sizes, shapes, &plan)
+    if err != 0:
+        raise OffloadError('Could not prepare kernel 0x{0:x} on device {1}'.format(kernel, device_id))
+    return <int64_t>plan
+
+def pymic_kernel_prepare(device_id, kernel, argc, arg_dims, arg_types, arg_sizes, arg_shapes):
+    cdef int64_t arg_dims_ptr 
+    cdef int64_t arg_types_ptr
+    cdef int64_t arg_sizes_ptr
+    cdef int64_t arg_shapes_ptr
+    
+    arg_dims_ptr = arg_dims.ctypes.data
+    arg_types_ptr = arg_types.ctypes.data
+    arg_sizes_ptr = arg_sizes.ctypes.data
+    arg_shapes_ptr = arg_shapes.ctypes.data
+    
+    return _c_pymic_kernel_prepare(device_id, kernel, argc, <int64_t*>arg_dims_ptr, <int64_t*>arg_types_ptr, <size_t*>arg_sizes_ptr, <int64_t*>arg_shapes_ptr)
+    
+################################################################################
+cdef _c_pymic_kernel_destroy_prepared(int device_id, int64_t plan_id):
+    cdef const libxstream_plan *plan
+    cdef int err
+    plan = <const libxstream_plan *>plan_id
+    err = libxstream_plan_destroy(plan)
+    if err != 0:
+        raise OffloadError('Could not destroy prepared kernel 0x{0:x} on device {1}'.format(plan_id, device_id))
+    return None
+
+def pymic_kernel_destroy_prepared(device_id, plan_id):
+    _c_pymic_kernel_destroy_prepared(device_id, plan_id)
+    return None
+    
+################################################################################
+cdef _c_pymic_stream_invoke_prepared(int device_id, int64_t stream_id, int64_t plan_id, size_t argc, int64_t arg_ptrs):
+    cdef libxstream_stream *stream
+    cdef libxstream_plan *plan
+    cdef int err
+    stream = <libxstream_stream *>stream_id
+    plan = <libxstream_plan *>plan_id
+    err = pymic_internal_invoke_prepared(device_id, stream, plan, argc, <void **>arg_ptrs)
+    if err != 0:
+        raise OffloadError('Could not invoke prepared kernel through stream 0x{0:x} on device {1}'.format(stream_id, device_id))
+    return None
+
+def pymic_stream_invoke_prepared(device_id, stream_id, plan_id, argc, arg_ptrs):
+    # arg_ptrs is the address of the (persistent) array of pointers
+    _c_pymic_stream_invoke_prepared(device_id, stream_id, plan_id, argc, arg_ptrs)
     return None
     
 ################################################################################
@@ -38,6 +38,9 @@
 
 #include <libxstream.h>
 
+// maximum number of dimensions of an array argument (see pymic_kernel.h)
+#define PYMIC_MAX_NDIMS LIBXSTREAM_MAX_NDIMS
+
 namespace pymic {
 
 enum dtype {
@@ -46,6 +49,7 @@ enum dtype {
     dtype_float   = 2,
     dtype_complex = 3,
     dtype_uint64  = 4,
+    dtype_float32 = 5,
 };
 
 #if ! PYMIC_USE_XSTREAM
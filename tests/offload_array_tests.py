@@ -117,6 +117,28 @@ class OffloadArrayTest(unittest.TestCase):
 
         self.assertEqual(r[0], a.shape[0])
 
+    @skipNoDevice
+    def test_update_parallel(self):
+        """Test if a large array is correctly transferred in chunks across
+           multiple streams, and if the transfers are ordered in the
+           stream."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        a = numpy.arange(0, 4 * 4711 * 1024, dtype=int)
+        b = numpy.zeros_like(a)
+        offl_a = stream.bind(a, update_device=False)
+        offl_b = stream.bind(b, update_device=False)
+        offl_a.update_device(parallel=True)
+        stream.transfer_device2device(offl_a._device_ptr, offl_b._device_ptr,
+                                      offl_a._nbytes)
+        offl_b.update_host(parallel=True)
+        stream.sync()
+
+        self.assertTrue((a == b).all(),
+                        "Array contains unexpected values: "
+                        "{0} should be {1}".format(b, a))
+
     @skipNoDevice
     def test_op_add_scalar_int(self):
         """Test __add__ operation of OffloadArray with scalar operand."""
@@ -2620,3 +2642,33 @@ class OffloadArrayTest(unittest.TestCase):
         self.assertTrue((a == expect).all(),
                         "Array contains unexpected values: "
                         "{0} should be {1}".format(a, expect))
+
+    @skipNoDevice
+    def test_residency(self):
+        """Test if OffloadArrays are evicted to host memory beyond the
+           residency limit, and if they are uploaded again when used."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        n = 1024 * 1024
+        nbytes = n * numpy.dtype(float).itemsize
+        device.enable_residency(limit=3 * nbytes)
+        try:
+            offl = [stream.bind(numpy.empty((n,), dtype=float),
+                                update_device=False) for i in range(5)]
+            for i, offl_a in enumerate(offl):
+                offl_a.fill(float(i))
+            info = device.residency_info()
+            self.assertTrue(info['resident'] <= 3 * nbytes)
+            self.assertTrue(info['evictions'] >= 2)
+            offl[0].pin()
+            for i, offl_a in enumerate(offl):
+                offl_a.update_host()
+                stream.sync()
+                self.assertTrue((offl_a.array == float(i)).all(),
+                                "Array {0} contains unexpected values: "
+                                "{1}".format(i, offl_a.array))
+            self.assertTrue(device.residency_info()['uploads'] >= 2)
+            self.assertTrue(offl[0]._device_ptr._ptr is not None)
+        finally:
+            device.disable_residency()
@@ -35,6 +35,7 @@ import numpy
 import pymic
 
 from helper import skipNoDevice
+from helper import get_library
 
 
 class OffloadDeviceTest(unittest.TestCase):
@@ -48,3 +49,97 @@ class OffloadDeviceTest(unittest.TestCase):
         device = pymic.devices[0]
         self.assertRaises(pymic.OffloadError, device.load_library,
                           "this_library_does_not_exist_anywhere")
+
+    @skipNoDevice
+    def test_create_stream_priority(self):
+        """Test if streams of different priority execute their requests."""
+
+        pattern = int(0xdeadbeefabbaabba)
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        streams = [device.create_stream(priority=p) for p in (7, 0, 100)]
+        for stream in streams:
+            a = numpy.empty((4711,), dtype=int)
+            r = numpy.empty((1,), dtype=int)
+            a[:] = pattern
+            offl_a = stream.bind(a)
+            offl_r = stream.bind(r)
+            stream.invoke(library.test_check_pattern,
+                          offl_a, offl_a.size, offl_r, pattern)
+            offl_r.update_host()
+            stream.sync()
+            self.assertEqual(r[0], a.shape[0])
+
+    @skipNoDevice
+    def test_create_stream_default_priority(self):
+        """Test if a stream is created with the middle of the priority range
+           by default i.e., other streams can be preferred and deferred."""
+
+        device = pymic.devices[0]
+        least, greatest = device.stream_priority_range()
+        self.assertTrue(greatest < least)
+        stream = device.create_stream()
+        self.assertTrue(greatest < stream._priority)
+        self.assertTrue(stream._priority < least)
+        self.assertEqual(device.get_default_stream()._priority,
+                         stream._priority)
+
+    @skipNoDevice
+    def test_memory_cache(self):
+        """Test if deallocated device memory serves a subsequent allocation,
+           and if the cached memory is released by trim_memory."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        nbytes = 1024 * 1024
+        device.trim_memory()
+        stats = device.memory_cache_info()
+        for i in range(11):
+            ptr = stream.allocate_device_memory(nbytes, sticky=True)
+            stream.deallocate_device_memory(ptr)
+        stats_end = device.memory_cache_info()
+        self.assertEqual(stats_end['hits'] - stats['hits'], 10)
+        self.assertEqual(stats_end['misses'] - stats['misses'], 1)
+        self.assertTrue(stats_end['cached'] >= nbytes)
+        self.assertTrue(device.trim_memory() >= nbytes)
+        self.assertEqual(device.memory_cache_info()['cached'], 0)
+
+    @skipNoDevice
+    def test_memory_stats(self):
+        """Test if the live memory is accounted (also per tag) until it
+           is deallocated, and if the high-water mark covers it."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        nbytes = 12345
+        tag = 'test_memory_stats'
+        stats = device.memory_stats()
+        ptr = stream.allocate_device_memory(nbytes, sticky=True, tag=tag)
+        stats_live = device.memory_stats()
+        self.assertEqual(stats_live['live'] - stats['live'], nbytes)
+        self.assertEqual(stats_live['nlive'] - stats['nlive'], 1)
+        self.assertEqual(stats_live['nallocs'] - stats['nallocs'], 1)
+        self.assertTrue(stats_live['peak'] >= stats_live['live'])
+        self.assertEqual(stats_live['tags'][tag], (nbytes, 1))
+        self.assertEqual(sum(stats_live['histogram']), stats_live['nlive'])
+        stream.deallocate_device_memory(ptr)
+        stats_end = device.memory_stats()
+        self.assertEqual(stats_end['live'], stats['live'])
+        self.assertTrue(tag not in stats_end['tags'])
+
+    @skipNoDevice
+    def test_small_allocations(self):
+        """Test if small allocations share a region of device memory,
+           and if each of them is aligned to 64 bytes."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        device.trim_memory()
+        stats = device.memory_stats()
+        ptrs = [stream.allocate_device_memory(8, sticky=True)
+                for i in range(100)]
+        stats_end = device.memory_stats()
+        self.assertTrue(stats_end['nsegments'] - stats['nsegments'] <= 1)
+        for ptr in ptrs:
+            self.assertEqual(ptr._device_ptr % 64, 0)
+            stream.deallocate_device_memory(ptr)
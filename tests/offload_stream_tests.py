@@ -31,6 +31,7 @@ from __future__ import print_function
 from __future__ import division
 
 import unittest
+import threading
 import numpy
 
 import pymic
@@ -314,6 +315,29 @@ class OffloadStreamTests(unittest.TestCase):
                         "Wrong contents of array: "
                         "{0} should be {1}".format(b, b_expect))
 
+    @skipNoDevice
+    def test_deallocate_async(self):
+        """Test if a buffer deallocated in stream order is released
+           once the transfers enqueued before are completed."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+
+        a = numpy.arange(0.0, 4096.0)
+        b = numpy.empty_like(a)
+        nbytes = a.dtype.itemsize * a.size
+
+        device_ptr = stream.allocate_device_memory(nbytes, sticky=True)
+        stream.transfer_host2device(a.ctypes.data, device_ptr, nbytes)
+        stream.transfer_device2host(device_ptr, b.ctypes.data, nbytes)
+        stream.deallocate_device_memory(device_ptr, sync=False)
+        stream.sync()
+
+        self.assertTrue((a == b).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(b, a))
+        self.assertTrue(device.memory_cache_info()['cached'] >= nbytes)
+
     @skipNoDevice
     def test_lowlevel_transfers_offsets(self):
         device = pymic.devices[0]
@@ -359,27 +383,401 @@ class OffloadStreamTests(unittest.TestCase):
                         "{0} should be {1}".format(b, b_expect))
 
     @skipNoDevice
-    def test_too_many_arguments(self):
+    def test_packed_arguments(self):
+        """Test if a kernel with more than 16 arguments receives all
+           arguments (packed argument block), both for a plain and for a
+           prepared invocation."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        library = get_library(device, "libtests.so")
+
+        scalars = list(range(1, 25))
+        r = numpy.zeros(1, dtype=int)
+        offl_r = stream.bind(r)
+        stream.invoke(library.test_packed_arguments, offl_r, *scalars)
+        kernel = library.test_packed_arguments.prepare(
+            pymic.OffloadArray, *([int] * len(scalars)))
+        stream.invoke(kernel, offl_r, *scalars)
+        offl_r.update_host()
+        stream.sync()
+
+        r_expect = 2 * sum(scalars)
+        self.assertEqual(offl_r.array[0], r_expect,
+                         "Wrong result: {0} should be "
+                         "{1}".format(offl_r.array[0], r_expect))
+
+    @skipNoDevice
+    def test_invoke_layout(self):
+        """Test if the shape and data type of an array argument are passed
+           to the kernel (extents listed from the fastest-varying one)."""
+
+        device = pymic.devices[0]
+        stream = device.get_default_stream()
+        library = get_library(device, "libtests.so")
+
+        cases = [(numpy.zeros((3, 5, 7), dtype=float), 3, 2, [7, 5, 3]),
+                 (numpy.zeros((3, 5), dtype=numpy.int32, order='F'),
+                  2, 1, [3, 5]),
+                 (numpy.zeros((2, 3), dtype=numpy.uint8), 1, -1, [6])]
+        for a, ndim, dtype, shape in cases:
+            for arg in (a, stream.bind(a)):
+                info = numpy.zeros(10, dtype=numpy.int64)
+                stream.invoke(library.test_kernel_layout, arg, info)
+                stream.sync()
+                strides = list(numpy.cumprod([1] + shape[:-1]))
+                self.assertEqual(info[0], ndim)
+                self.assertEqual(info[1], dtype)
+                self.assertEqual(list(info[2:2 + ndim]), shape)
+                self.assertEqual(list(info[6:6 + ndim]), strides)
+
+        # a non-contiguous array has no dense layout, and the invoke is
+        # rejected before any buffer is allocated
+        info = numpy.zeros(10, dtype=numpy.int64)
+        a = numpy.zeros((6, 8), dtype=float)[::2, 1::3]
+        stats = device.memory_stats()
+        for args in ((a, info), (info, a)):
+            try:
+                stream.invoke(library.test_kernel_layout, *args)
+            except ValueError:
+                self.assertTrue(True)
+            else:
+                self.assertTrue(False)
+        self.assertEqual(device.memory_stats()['nallocs'], stats['nallocs'])
+
+    @skipNoDevice
+    def test_capture_launch(self):
+        """Test if a captured sequence of operations is replayed by each
+           launch of the graph, and if an argument can be patched."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream = device.get_default_stream()
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        c = numpy.zeros_like(a)
+        p = 1.5
+        s = 0.5
+        nlaunches = 3
+
+        a_expect = a + nlaunches * p
+        b_expect = b - (nlaunches + 1) * s
+        c_expect = c + p
+
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        offl_c = stream.bind(c)
+        with stream.capture() as graph:
+            stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                          offl_a, offl_b, a.size, b.size, p, s)
+        for i in range(nlaunches):
+            graph.launch()
+        stream.sync()
+        graph.patch(0, 0, offl_c)
+        graph.launch()
+        offl_a.update_host()
+        offl_b.update_host()
+        offl_c.update_host()
+        stream.sync()
+
+        self.assertTrue((a == a_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(a, a_expect))
+        self.assertTrue((b == b_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(b, b_expect))
+        self.assertTrue((c == c_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(c, c_expect))
+
+    @skipNoDevice
+    def test_capture_lifetime(self):
+        """Test if a graph keeps the arrays it refers to alive, and if
+           destroying a graph waits for the launch in flight."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream = device.create_stream()
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        p = 1.5
+        s = 0.5
+        a_expect = a + p
+
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        with stream.capture() as graph:
+            stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                          offl_a, offl_b, a.size, b.size, p, s)
+            offl_a.update_host()
+        del offl_a
+        del offl_b
+        graph.launch()
+        del graph
+
+        self.assertTrue((a == a_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(a, a_expect))
+
+    @skipNoDevice
+    def test_capture_patch_in_flight(self):
+        """Test if patching a graph does not affect the launch in flight,
+           and if launches into different streams may overlap."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream = device.create_stream()
+        other = device.create_stream()
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        c = numpy.arange(0.0, 4096.0, dtype=float)
+        d = numpy.arange(0.0, 1024.0, dtype=float)
+        e = numpy.arange(0.0, 4096.0, dtype=float)
+        p = 1.5
+        s = 0.5
+        a_expect = a + p
+        c_expect = c + p
+        e_expect = e + p
+
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        offl_c = stream.bind(c)
+        offl_d = other.bind(d)
+        offl_e = other.bind(e)
+        stream.sync()
+        other.sync()
+        with stream.capture() as graph:
+            stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                          offl_a, offl_b, a.size, b.size, p, s)
+        graph.launch()
+        graph.patch(0, 0, offl_c)
+        graph.launch()
+        graph.patch(0, 0, offl_e)
+        graph.patch(0, 1, offl_d)
+        graph.launch(other)
+        del graph
+        offl_a.update_host()
+        offl_c.update_host()
+        offl_e.update_host()
+        stream.sync()
+        other.sync()
+
+        self.assertTrue((a == a_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(a, a_expect))
+        self.assertTrue((c == c_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(c, c_expect))
+        self.assertTrue((e == e_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(e, e_expect))
+
+    @skipNoDevice
+    def test_free_cross_stream(self):
+        """Test if the memory of an array is not reused while another
+           stream still operates on it."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream_a = device.create_stream()
+        stream_b = device.create_stream()
+        a = numpy.arange(0.0, 4711.0 * 1024, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        p = 1.5
+        s = 0.5
+        nrepeat = 8
+        a_expect = a + nrepeat * p
+
+        offl_a = stream_a.bind(a)
+        offl_b = stream_b.bind(b)
+        stream_a.sync()
+        for i in range(nrepeat):
+            stream_b.invoke(library.test_offload_stream_kernel_arrays_float,
+                            offl_a, offl_b, a.size, b.size, p, s)
+        offl_a.assign_stream(stream_b)
+        offl_a.update_host()
+        del offl_a
+        # the memory of offl_a may be handed out again only now
+        offl_c = stream_a.zeros(a.shape, dtype=float)
+        stream_b.sync()
+        stream_a.sync()
+
+        self.assertTrue((a == a_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(a, a_expect))
+        self.assertTrue((offl_c.array == 0.0).all(),
+                        "Array was not zeroed")
+
+    @skipNoDevice
+    def test_free_while_capturing(self):
+        """Test if the memory of an array dropped while its stream is
+           capturing is deallocated rather than leaked."""
+
+        device = pymic.devices[0]
+        stream = device.create_stream()
+        nbytes = 4711 * 8
+        stats = device.memory_stats()
+        offl_a = stream.zeros((4711,), dtype=float)
+        stream.sync()
+        stats_live = device.memory_stats()
+        self.assertTrue(stats_live['live'] - stats['live'] >= nbytes)
+        with stream.capture():
+            del offl_a
+            stats_end = device.memory_stats()
+        stream.sync()
+
+        self.assertEqual(stats_end['live'], stats['live'])
+        self.assertEqual(stats_end['nlive'], stats['nlive'])
+
+    @skipNoDevice
+    def test_event_elapsed(self):
+        """Test if timed events complete with the work of the stream, and if
+           the time between two events can be measured."""
+
         device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
         stream = device.get_default_stream()
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        start = stream.record()
+        stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                      offl_a, offl_b, a.size, b.size, 1.0, 1.0)
+        end = stream.record()
+        end.sync()
+
+        self.assertTrue(start.query() and end.query(),
+                        "Events did not complete after syncing")
+        elapsed = start.elapsed_ms(end)
+        self.assertTrue(elapsed >= 0.0,
+                        "Negative time between events: {0}".format(elapsed))
+
+        untimed = stream.record(timed=False)
+        untimed.sync()
+        try:
+            start.elapsed_ms(untimed)
+        except pymic.OffloadError:
+            self.assertTrue(True)
+        else:
+            self.assertTrue(False)
+
+    @skipNoDevice
+    def test_add_callback(self):
+        """Test if callbacks are called in stream order once the preceding
+           operations have completed."""
+
+        device = pymic.devices[0]
         library = get_library(device, "libtests.so")
+        stream = device.get_default_stream()
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        ncallbacks = 4
+        calls = []
+        completed = threading.Event()
+
+        # the stream may proceed while the callback thread runs a callback
+        def callback(i, expect):
+            calls.append((i, a[0] >= expect))
+            if i == ncallbacks - 1:
+                completed.set()
 
-        a0, a1 = numpy.array([0]), numpy.array([1])
-        a2, a3 = numpy.array([2]), numpy.array([3])
-        a4, a5 = numpy.array([4]), numpy.array([5])
-        a6, a7 = numpy.array([6]), numpy.array([7])
-        a8, a9 = numpy.array([8]), numpy.array([9])
-        aA, aB = numpy.array([10]), numpy.array([11])
-        aC, aD = numpy.array([12]), numpy.array([13])
-        aE, aF = numpy.array([14]), numpy.array([15])
-        aG = numpy.array([16])
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        for i in range(ncallbacks):
+            stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                          offl_a, offl_b, a.size, b.size, 1.0, 1.0)
+            offl_a.update_host()
+            stream.add_callback(callback, i, i + 1.0)
+        stream.sync()
 
+        self.assertTrue(completed.wait(10.0),
+                        "Callbacks were not called: {0}".format(calls))
+        self.assertEqual([i for i, _ in calls], list(range(ncallbacks)),
+                         "Callbacks were called out of order")
+        self.assertTrue(all(ok for _, ok in calls),
+                        "Callback was called before the preceding "
+                        "operations completed")
+
+    @skipNoDevice
+    def test_invoke_prepared(self):
+        """Test if a prepared kernel is correctly invoked with different
+           arrays and scalars, and if a prepared kernel rejects arguments
+           that do not match its argument kinds."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream = device.get_default_stream()
+        kernel = library.test_offload_stream_kernel_arrays_float.prepare(
+            pymic.OffloadArray, pymic.OffloadArray, int, int, float, float)
+
+        a = numpy.arange(0.0, 4096.0, dtype=float)
+        b = numpy.arange(0.0, 1024.0, dtype=float)
+        offl_a = stream.bind(a)
+        offl_b = stream.bind(b)
+        for i in range(4):
+            stream.invoke(kernel, offl_a, offl_b, a.size, b.size,
+                          1.0 + i, 0.5 * i)
+        stream.invoke(kernel, offl_b, offl_a, b.size, 0, 1.0, 0.0)
+        offl_a.update_host()
+        offl_b.update_host()
+        stream.sync()
+
+        a_expect = numpy.arange(0.0, 4096.0, dtype=float) + 10.0
+        b_expect = numpy.arange(0.0, 1024.0, dtype=float) - 3.0 + 1.0
+        self.assertTrue((offl_a.array == a_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(offl_a.array, a_expect))
+        self.assertTrue((offl_b.array == b_expect).all(),
+                        "Wrong contents of array: "
+                        "{0} should be {1}".format(offl_b.array, b_expect))
+
+        try:
+            stream.invoke(kernel, a, b, a.size, b.size, 1.0, 1.0)
+        except pymic.OffloadError:
+            self.assertTrue(True)
+        else:
+            self.assertTrue(False)
+
+        frozen = library.test_offload_stream_kernel_arrays_float.prepare(
+            offl_a, offl_b, int, int, float, float)
+        stream.invoke(frozen, offl_a, offl_b, a.size, b.size, 0.0, 0.0)
         try:
-            stream.invoke(library.test_too_many_arguments,
-                          a0, a1, a2, a3, a4, a5, a6, a7,
-                          a8, a9, aA, aB, aC, aD, aE, aF,
-                          aG)
+            stream.invoke(frozen, offl_b, offl_a, b.size, a.size, 0.0, 0.0)
         except ValueError:
             self.assertTrue(True)
         else:
             self.assertTrue(False)
+        stream.sync()
+
+        try:
+            library.test_offload_stream_kernel_arrays_float.prepare(
+                a, b, int, int, float, float)
+        except pymic.OffloadError:
+            self.assertTrue(True)
+        else:
+            self.assertTrue(False)
+
+    @skipNoDevice
+    def test_capture_copy_in_out(self):
+        """Test if capturing a kernel with copy-in/copy-out arguments
+           throws an exception before any buffer is allocated."""
+
+        device = pymic.devices[0]
+        library = get_library(device, "libtests.so")
+        stream = device.get_default_stream()
+        a = numpy.arange(0.0, 16.0, dtype=float)
+        offl_b = stream.bind(a)
+        stream.sync()
+        stats = device.memory_stats()
+
+        try:
+            with stream.capture():
+                stream.invoke(library.test_offload_stream_kernel_arrays_float,
+                              offl_b, a, a.size, a.size, 1.0, 1.0)
+        except pymic.OffloadError:
+            self.assertTrue(True)
+        else:
+            self.assertTrue(False)
+        self.assertEqual(device.memory_stats()['nallocs'], stats['nallocs'])
@@ -156,14 +156,23 @@ void test_kernel_zgemm(const double complex *A, const double complex *B,
 }
 
 PYMIC_KERNEL
-void test_too_many_arguments(const long int *a0, const long int *a1,
-                             const long int *a2, const long int *a3,
-                             const long int *a4, const long int *a5,
-                             const long int *a6, const long int *a7,
-                             const long int *a8, const long int *a9,
-                             const long int *aA, const long int *aB,
-                             const long int *aC, const long int *aD,
-                             const long int *aE, const long int *aF,
-                             const long int *aG) {
-    /* do nothing */
+void test_packed_arguments(const pymic_args *args) {
+    /* args: result, followed by any number of scalars */
+    long int *r = PYMIC_ARG(args, 0, long int);
+    size_t i;
+    for (i = 1; i <= PYMIC_MAX_POSITIONAL_ARGS + 8; ++i) {
+        *r += *PYMIC_ARG(args, i, const long int);
+    }
+}
+
+PYMIC_KERNEL
+void test_kernel_layout(const void *a, int64_t *info) {
+    /* info: ndim, dtype, shape[PYMIC_MAX_NDIMS], stride[PYMIC_MAX_NDIMS] */
+    size_t d;
+    info[0] = PYMIC_NDIM(PYMIC_CONTEXT, 0);
+    info[1] = PYMIC_DTYPE(PYMIC_CONTEXT, 0);
+    for (d = 0; d < PYMIC_MAX_NDIMS; ++d) {
+        info[2 + d] = PYMIC_SHAPE(PYMIC_CONTEXT, 0, d);
+        info[2 + PYMIC_MAX_NDIMS + d] = PYMIC_STRIDE(PYMIC_CONTEXT, 0, d);
+    }
 }